@@ -0,0 +1,283 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#if ! __has_feature(objc_arc)
+#error This file is expected to be compiled with ARC turned ON
+#endif
+
+#import "HTTPStubs+HAR.h"
+#import "HTTPStubsHARArchive.h"
+#import "HTTPStubsResponse.h"
+#import "NSURLRequest+HTTPBodyTesting.h"
+
+#import <CommonCrypto/CommonDigest.h>
+
+NSString* const HARErrorDomain = @"HAR";
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Entries
+
+static NSData *HTTPStubsHARHash(NSData *data)
+{
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256(data.bytes, (CC_LONG)data.length, digest);
+    return [NSData dataWithBytes:digest length:CC_SHA256_DIGEST_LENGTH];
+}
+
+// The key of the index: the method and the URL, normalized the same way for the archive and for the requests
+static NSString *HTTPStubsHARKey(NSString *method, NSURL *url)
+{
+    NSString *absoluteString = url.absoluteString;
+    NSRange fragment = [absoluteString rangeOfString:@"#"];
+    if (fragment.location != NSNotFound)
+    {
+        absoluteString = [absoluteString substringToIndex:fragment.location];
+    }
+    return [NSString stringWithFormat:@"%@ %@", method.uppercaseString, absoluteString];
+}
+
+// A recorded response, whose body is only decoded the first time it is sent
+@interface HTTPStubsHAREntry : NSObject
+@property(nonatomic, strong, nullable) NSData *requestBodyHash;
+@property(nonatomic, assign) int statusCode;
+@property(nonatomic, copy) NSDictionary *headers;
+@property(nonatomic, copy, nullable) NSString *bodyText;
+@property(nonatomic, assign) BOOL bodyIsBase64;
+@property(nonatomic, assign) NSTimeInterval requestTime;
+@property(nonatomic, assign) NSTimeInterval responseTime;
+// Whether the entry has already answered a request, guarded by the array of the entries of its key
+@property(nonatomic, assign) BOOL served;
+-(HTTPStubsResponse *)response;
+@end
+
+@implementation HTTPStubsHAREntry
+{
+    NSData *_body;
+}
+
+-(NSData *)body
+{
+    @synchronized(self)
+    {
+        if (!_body)
+        {
+            NSString *text = self.bodyText ?: @"";
+            _body = (self.bodyIsBase64 ? [[NSData alloc] initWithBase64EncodedString:text options:NSDataBase64DecodingIgnoreUnknownCharacters] : nil)
+                    ?: [text dataUsingEncoding:NSUTF8StringEncoding];
+            // The text is no longer needed once decoded
+            self.bodyText = nil;
+        }
+        return _body;
+    }
+}
+
+-(HTTPStubsResponse *)response
+{
+    NSData *body = [self body];
+    HTTPStubsResponse *response = [[HTTPStubsResponse alloc] initWithInputStream:[NSInputStream inputStreamWithData:body]
+                                                                        dataSize:body.length
+                                                                      statusCode:self.statusCode
+                                                                         headers:self.headers];
+    [response requestTime:self.requestTime responseTime:self.responseTime];
+    return response;
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Stubbing
+
+NSArray * _Nullable HTTPStubsHAREntriesAtURL(NSURL *harURL, NSError **error)
+{
+    NSData *harData = [NSData dataWithContentsOfURL:harURL options:NSDataReadingMappedIfSafe error:NULL];
+    if (!harData)
+    {
+        if (error)
+        {
+            *error = [NSError errorWithDomain:HARErrorDomain code:OHHTTPStubsHARErrorFileFailedToRead userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"File '%@' does not read.", harURL.absoluteString]}];
+        }
+        return nil;
+    }
+
+    id har = [NSJSONSerialization JSONObjectWithData:harData options:0 error:NULL];
+    id log = [har isKindOfClass:NSDictionary.class] ? har[@"log"] : nil;
+    NSArray *harEntries = [log isKindOfClass:NSDictionary.class] ? log[@"entries"] : nil;
+    if (![harEntries isKindOfClass:NSArray.class])
+    {
+        if (error)
+        {
+            *error = [NSError errorWithDomain:HARErrorDomain code:OHHTTPStubsHARErrorInvalidFileFormat userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"File '%@' is not a HAR archive.", harURL.absoluteString]}];
+        }
+        return nil;
+    }
+    return harEntries;
+}
+
+@implementation HTTPStubs (HAR)
+
++(id<HTTPStubsDescriptor>)stubRequestsUsingHARFileAtURL:(NSURL *)harURL options:(HTTPStubsHAROptions)options error:(NSError **)error
+{
+    NSArray *harEntries = HTTPStubsHAREntriesAtURL(harURL, error);
+    if (!harEntries)
+    {
+        return nil;
+    }
+    return [self stubRequestsUsingHAREntries:harEntries name:harURL.lastPathComponent options:options];
+}
+
++(id<HTTPStubsDescriptor>)stubRequestsUsingHAREntries:(NSArray *)harEntries name:(NSString *)name options:(HTTPStubsHAROptions)options
+{
+    BOOL matchRequestBody = (options & HTTPStubsHAROptionMatchRequestBody) != 0;
+    BOOL useRecordedTimings = (options & HTTPStubsHAROptionUseRecordedTimings) != 0;
+    if (matchRequestBody)
+    {
+        [NSURLRequest OHHTTPStubs_setHTTPBodyCaptureEnabled:YES];
+    }
+    NSMutableDictionary<NSString *, NSMutableArray<HTTPStubsHAREntry *> *> *index = [NSMutableDictionary new];
+    for (NSDictionary *harEntry in harEntries)
+    {
+        HTTPStubsHAREntry *entry = [self entryWithHAREntry:harEntry useRecordedTimings:useRecordedTimings];
+        if (!entry)
+        {
+            continue;
+        }
+        NSDictionary *request = harEntry[@"request"];
+        NSURL *url = [NSURL URLWithString:request[@"url"]];
+        if (!url)
+        {
+            continue;
+        }
+        NSString *postText = [request[@"postData"] isKindOfClass:NSDictionary.class] ? request[@"postData"][@"text"] : nil;
+        if (matchRequestBody && [postText isKindOfClass:NSString.class])
+        {
+            entry.requestBodyHash = HTTPStubsHARHash([postText dataUsingEncoding:NSUTF8StringEncoding]);
+        }
+        NSString *key = HTTPStubsHARKey(request[@"method"], url);
+        NSMutableArray *entries = index[key] ?: (index[key] = [NSMutableArray new]);
+        [entries addObject:entry];
+    }
+
+    // Repeated requests are answered by the entries recorded for them in order, the last one answering any further request.
+    // Only building a response consumes an entry: the test block just checks that an entry matches.
+    HTTPStubsHAREntry *(^entryForRequest)(NSURLRequest *, BOOL) = ^HTTPStubsHAREntry *(NSURLRequest *request, BOOL consume) {
+        NSArray<HTTPStubsHAREntry *> *entries = request.URL ? index[HTTPStubsHARKey(request.HTTPMethod ?: @"GET", request.URL)] : nil;
+        if (entries.count == 0)
+        {
+            return nil;
+        }
+        // The digest is kept even for the bodies too large to be captured
+        NSData *bodyHash = matchRequestBody ? (request.OHHTTPStubs_HTTPBodyDigest ?: HTTPStubsHARHash([NSData data])) : nil;
+        @synchronized(entries)
+        {
+            HTTPStubsHAREntry *lastMatch = nil;
+            for (HTTPStubsHAREntry *entry in entries)
+            {
+                // Entries recorded without body match any body
+                if (bodyHash && entry.requestBodyHash && ![entry.requestBodyHash isEqualToData:bodyHash])
+                {
+                    continue;
+                }
+                if (!consume)
+                {
+                    return entry;
+                }
+                if (!entry.served)
+                {
+                    entry.served = YES;
+                    return entry;
+                }
+                lastMatch = entry;
+            }
+            return lastMatch;
+        }
+    };
+
+    id<HTTPStubsDescriptor> descriptor = [HTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return entryForRequest(request, NO) != nil;
+    } withStubResponse:^HTTPStubsResponse*(NSURLRequest *request) {
+        return [entryForRequest(request, YES) response];
+    }];
+    descriptor.name = name;
+
+    return descriptor;
+}
+
+#pragma mark - Private
+
++(nullable HTTPStubsHAREntry *)entryWithHAREntry:(NSDictionary *)harEntry useRecordedTimings:(BOOL)useRecordedTimings
+{
+    NSDictionary *request = [harEntry isKindOfClass:NSDictionary.class] ? harEntry[@"request"] : nil;
+    NSDictionary *response = [harEntry isKindOfClass:NSDictionary.class] ? harEntry[@"response"] : nil;
+    if (![request isKindOfClass:NSDictionary.class] || ![request[@"method"] isKindOfClass:NSString.class] || ![request[@"url"] isKindOfClass:NSString.class]
+        || ![response isKindOfClass:NSDictionary.class] || [response[@"status"] intValue] <= 0)
+    {
+        return nil;
+    }
+
+    HTTPStubsHAREntry *entry = [HTTPStubsHAREntry new];
+    entry.statusCode = [response[@"status"] intValue];
+
+    // Bodies are recorded decoded, so the headers describing their encoding no longer apply
+    static NSSet<NSString *> *droppedHeaders;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        droppedHeaders = [NSSet setWithArray:@[@"content-encoding", @"content-length", @"transfer-encoding"]];
+    });
+    NSMutableDictionary<NSString *, NSString *> *headers = [NSMutableDictionary new];
+    for (NSDictionary *header in [response[@"headers"] isKindOfClass:NSArray.class] ? response[@"headers"] : @[])
+    {
+        NSString *name = [header isKindOfClass:NSDictionary.class] ? header[@"name"] : nil;
+        NSString *value = [header isKindOfClass:NSDictionary.class] ? header[@"value"] : nil;
+        if (![name isKindOfClass:NSString.class] || ![value isKindOfClass:NSString.class] || [droppedHeaders containsObject:name.lowercaseString])
+        {
+            continue;
+        }
+        // Repeated headers, like Set-Cookie, are combined as NSHTTPURLResponse does
+        headers[name] = headers[name] ? [NSString stringWithFormat:@"%@, %@", headers[name], value] : value;
+    }
+    entry.headers = headers;
+
+    NSDictionary *content = response[@"content"];
+    if ([content isKindOfClass:NSDictionary.class] && [content[@"text"] isKindOfClass:NSString.class])
+    {
+        entry.bodyText = content[@"text"];
+        entry.bodyIsBase64 = [content[@"encoding"] isEqual:@"base64"];
+    }
+
+    if (useRecordedTimings)
+    {
+        // Timings are in milliseconds, -1 when not applicable
+        NSDictionary *timings = harEntry[@"timings"];
+        if ([timings isKindOfClass:NSDictionary.class])
+        {
+            entry.requestTime = MAX([timings[@"wait"] doubleValue], 0) / 1000.0;
+            entry.responseTime = MAX([timings[@"receive"] doubleValue], 0) / 1000.0;
+        }
+    }
+
+    return entry;
+}
+
+@end
@@ -0,0 +1,58 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Imports
+
+#import <Foundation/Foundation.h>
+
+#import "HTTPStubs+HAR.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - HAR Archive Helpers
+
+/**
+ *  Read the entries of a HAR archive.
+ *
+ *  @param harURL The URL of the HAR file.
+ *  @param error  An out value that returns any error encountered while reading the file.
+ *
+ *  @return The `log.entries` array of the archive, or nil if the file could not be read or is not a HAR archive.
+ */
+NSArray * _Nullable HTTPStubsHAREntriesAtURL(NSURL *harURL, NSError **error);
+
+@interface HTTPStubs (HARArchive)
+
+/**
+ *  Add a stub replaying the responses of HAR entries already read with `HTTPStubsHAREntriesAtURL`.
+ *
+ *  @see `+stubRequestsUsingHARFileAtURL:options:error:`
+ */
++(id<HTTPStubsDescriptor>)stubRequestsUsingHAREntries:(NSArray *)harEntries name:(NSString *)name options:(HTTPStubsHAROptions)options;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,310 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+#if ! __has_feature(objc_arc)
+#error This file is expected to be compiled with ARC turned ON
+#endif
+
+#import "HTTPStubsHARReplay.h"
+#import "HTTPStubsHARArchive.h"
+#import "NSURLRequest+HTTPBodyTesting.h"
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Recorded Requests
+
+// Parses the ISO 8601 `startedDateTime` of HAR entries, whose fractional seconds have a variable number of digits
+static NSDate *HTTPStubsHARDate(NSString *dateTime)
+{
+    static NSDateFormatter *formatter;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        formatter = [NSDateFormatter new];
+        formatter.locale = [NSLocale localeWithLocaleIdentifier:@"en_US_POSIX"];
+        formatter.dateFormat = @"yyyy-MM-dd'T'HH:mm:ssZZZZZ";
+    });
+    if (![dateTime isKindOfClass:NSString.class])
+    {
+        return nil;
+    }
+
+    NSTimeInterval fraction = 0;
+    NSRange dot = [dateTime rangeOfString:@"."];
+    if (dot.location != NSNotFound)
+    {
+        NSUInteger end = NSMaxRange(dot);
+        while (end < dateTime.length && [NSCharacterSet.decimalDigitCharacterSet characterIsMember:[dateTime characterAtIndex:end]])
+        {
+            ++end;
+        }
+        fraction = [[dateTime substringWithRange:NSMakeRange(dot.location, end - dot.location)] doubleValue];
+        dateTime = [dateTime stringByReplacingCharactersInRange:NSMakeRange(dot.location, end - dot.location) withString:@""];
+    }
+    NSDate *date;
+    @synchronized(formatter)
+    {
+        date = [formatter dateFromString:dateTime];
+    }
+    return [date dateByAddingTimeInterval:fraction];
+}
+
+@interface HTTPStubsHARReplayItem : NSObject
+@property(nonatomic, strong) NSURLRequest *request;
+@property(nonatomic, assign) NSTimeInterval offset;
+@end
+
+@implementation HTTPStubsHARReplayItem
+@end
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Report
+
+@interface HTTPStubsHARReplayReport ()
+@property(nonatomic, copy) NSArray<NSNumber *> *sortedLatencies;
+@property(nonatomic, assign, readwrite) NSUInteger failureCount;
+@property(nonatomic, assign, readwrite) NSTimeInterval duration;
+@property(nonatomic, assign, readwrite) NSTimeInterval maximumLag;
+@end
+
+@implementation HTTPStubsHARReplayReport
+
+-(NSUInteger)requestCount
+{
+    return self.sortedLatencies.count;
+}
+
+-(double)throughput
+{
+    return self.duration > 0 ? self.requestCount / self.duration : 0;
+}
+
+-(NSTimeInterval)latencyAtPercentile:(double)percentile
+{
+    NSUInteger count = self.sortedLatencies.count;
+    if (count == 0)
+    {
+        return 0;
+    }
+    // Nearest-rank percentile
+    double rank = ceil(MIN(MAX(percentile, 0), 100) / 100.0 * count);
+    NSUInteger index = (NSUInteger)MAX(rank, 1) - 1;
+    return self.sortedLatencies[index].doubleValue;
+}
+
+-(NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@ %lu requests (%lu failed) in %.3fs, %.1f req/s, p50 %.1fms, p90 %.1fms, p99 %.1fms, max lag %.1fms>",
+            self.class, (unsigned long)self.requestCount, (unsigned long)self.failureCount, self.duration, self.throughput,
+            [self latencyAtPercentile:50] * 1000, [self latencyAtPercentile:90] * 1000, [self latencyAtPercentile:99] * 1000,
+            self.maximumLag * 1000];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Replay
+
+@implementation HTTPStubsHARReplay
+{
+    NSArray *_harEntries;
+    NSString *_name;
+    HTTPStubsHAROptions _options;
+    NSArray<HTTPStubsHARReplayItem *> *_items;
+}
+
+-(nullable instancetype)initWithHARFileAtURL:(NSURL *)harURL options:(HTTPStubsHAROptions)options error:(NSError **)error
+{
+    NSArray *harEntries = HTTPStubsHAREntriesAtURL(harURL, error);
+    if (!harEntries)
+    {
+        return nil;
+    }
+
+    self = [super init];
+    if (self)
+    {
+        _harEntries = harEntries;
+        _name = harURL.lastPathComponent;
+        _options = options;
+        // Only the bodies set while the capture is enabled can be matched, so enable it before building the requests
+        if (options & HTTPStubsHAROptionMatchRequestBody)
+        {
+            [NSURLRequest OHHTTPStubs_setHTTPBodyCaptureEnabled:YES];
+        }
+        _items = [self.class itemsWithHAREntries:harEntries];
+        _speedFactor = 1;
+    }
+    return self;
+}
+
+-(NSUInteger)requestCount
+{
+    return _items.count;
+}
+
+-(NSTimeInterval)recordedDuration
+{
+    return _items.lastObject.offset;
+}
+
+-(void)replayWithSession:(NSURLSession *)session completion:(void(^)(HTTPStubsHARReplayReport *report))completion
+{
+    id<HTTPStubsDescriptor> stub = [HTTPStubs stubRequestsUsingHAREntries:_harEntries name:_name options:_options];
+    NSArray<HTTPStubsHARReplayItem *> *items = _items;
+    NSUInteger count = items.count;
+    double speedFactor = self.speedFactor;
+    NSTimeInterval (^dueTime)(HTTPStubsHARReplayItem *) = ^NSTimeInterval(HTTPStubsHARReplayItem *item) {
+        return speedFactor > 0 ? item.offset / speedFactor : 0;
+    };
+
+    // All the state below is only accessed on this queue
+    dispatch_queue_t queue = dispatch_queue_create("OHHTTPStubs.har.replay", DISPATCH_QUEUE_SERIAL);
+    NSMutableArray<NSNumber *> *latencies = [NSMutableArray arrayWithCapacity:count];
+    HTTPStubsHARReplayReport *report = [HTTPStubsHARReplayReport new];
+    __block NSUInteger nextItem = 0;
+    NSTimeInterval start = NSProcessInfo.processInfo.systemUptime;
+
+    void (^finish)(void) = ^{
+        [HTTPStubs removeStub:stub];
+        report.duration = NSProcessInfo.processInfo.systemUptime - start;
+        report.sortedLatencies = [latencies sortedArrayUsingSelector:@selector(compare:)];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion(report);
+        });
+    };
+    if (count == 0)
+    {
+        dispatch_async(queue, finish);
+        return;
+    }
+
+    // A single timer, re-armed for the next due request, rather than one pending block per request
+    dispatch_source_t timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, queue);
+    dispatch_source_set_event_handler(timer, ^{
+        NSTimeInterval now = NSProcessInfo.processInfo.systemUptime;
+        while (nextItem < count && dueTime(items[nextItem]) <= now - start)
+        {
+            HTTPStubsHARReplayItem *item = items[nextItem++];
+            report.maximumLag = MAX(report.maximumLag, now - start - dueTime(item));
+            NSTimeInterval issued = NSProcessInfo.processInfo.systemUptime;
+            [[session dataTaskWithRequest:item.request completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+                NSTimeInterval latency = NSProcessInfo.processInfo.systemUptime - issued;
+                dispatch_async(queue, ^{
+                    [latencies addObject:@(latency)];
+                    if (error)
+                    {
+                        report.failureCount++;
+                    }
+                    if (latencies.count == count)
+                    {
+                        finish();
+                    }
+                });
+            }] resume];
+            now = NSProcessInfo.processInfo.systemUptime;
+        }
+
+        if (nextItem < count)
+        {
+            NSTimeInterval delay = MAX(dueTime(items[nextItem]) - (now - start), 0);
+            dispatch_source_set_timer(timer, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), DISPATCH_TIME_FOREVER, NSEC_PER_MSEC);
+        }
+        else
+        {
+            dispatch_source_cancel(timer);
+        }
+    });
+    dispatch_source_set_timer(timer, DISPATCH_TIME_NOW, DISPATCH_TIME_FOREVER, 0);
+    dispatch_resume(timer);
+}
+
+#pragma mark - Private
+
++(NSArray<HTTPStubsHARReplayItem *> *)itemsWithHAREntries:(NSArray *)harEntries
+{
+    // Those are set by the loader itself
+    static NSSet<NSString *> *droppedHeaders;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        droppedHeaders = [NSSet setWithArray:@[@"content-length", @"host", @"connection", @"transfer-encoding"]];
+    });
+
+    NSMutableArray<HTTPStubsHARReplayItem *> *items = [NSMutableArray arrayWithCapacity:harEntries.count];
+    NSTimeInterval startTime = DBL_MAX;
+    NSTimeInterval previousTime = NAN;
+    for (NSDictionary *harEntry in harEntries)
+    {
+        NSDictionary *request = [harEntry isKindOfClass:NSDictionary.class] ? harEntry[@"request"] : nil;
+        NSDictionary *response = [harEntry isKindOfClass:NSDictionary.class] ? harEntry[@"response"] : nil;
+        NSURL *url = [request isKindOfClass:NSDictionary.class] && [request[@"url"] isKindOfClass:NSString.class] ? [NSURL URLWithString:request[@"url"]] : nil;
+        // Only replay the requests which have a recorded response, so that none of them reaches the network
+        if (!url || ![request[@"method"] isKindOfClass:NSString.class] || ![response isKindOfClass:NSDictionary.class] || [response[@"status"] intValue] <= 0)
+        {
+            continue;
+        }
+
+        NSMutableURLRequest *urlRequest = [NSMutableURLRequest requestWithURL:url];
+        urlRequest.HTTPMethod = request[@"method"];
+        for (NSDictionary *header in [request[@"headers"] isKindOfClass:NSArray.class] ? request[@"headers"] : @[])
+        {
+            NSString *name = [header isKindOfClass:NSDictionary.class] ? header[@"name"] : nil;
+            NSString *value = [header isKindOfClass:NSDictionary.class] ? header[@"value"] : nil;
+            // HTTP/2 pseudo-headers (":authority", ...) are not real headers
+            if ([name isKindOfClass:NSString.class] && [value isKindOfClass:NSString.class]
+                && ![name hasPrefix:@":"] && ![droppedHeaders containsObject:name.lowercaseString])
+            {
+                [urlRequest addValue:value forHTTPHeaderField:name];
+            }
+        }
+        NSString *postText = [request[@"postData"] isKindOfClass:NSDictionary.class] ? request[@"postData"][@"text"] : nil;
+        if ([postText isKindOfClass:NSString.class])
+        {
+            urlRequest.HTTPBody = [postText dataUsingEncoding:NSUTF8StringEncoding];
+        }
+
+        // Entries without a readable date keep the time of the previous one
+        NSDate *date = HTTPStubsHARDate(harEntry[@"startedDateTime"]);
+        HTTPStubsHARReplayItem *item = [HTTPStubsHARReplayItem new];
+        item.request = urlRequest;
+        item.offset = date ? date.timeIntervalSinceReferenceDate : previousTime;
+        previousTime = item.offset;
+        if (date)
+        {
+            startTime = MIN(startTime, item.offset);
+        }
+        [items addObject:item];
+    }
+    for (HTTPStubsHARReplayItem *item in items)
+    {
+        // Entries before the first readable date are replayed right away
+        item.offset = isnan(item.offset) ? 0 : item.offset - startTime;
+    }
+
+    // Archives are usually already sorted by date, but nothing requires it
+    [items sortWithOptions:NSSortStable usingComparator:^NSComparisonResult(HTTPStubsHARReplayItem *item1, HTTPStubsHARReplayItem *item2) {
+        return [@(item1.offset) compare:@(item2.offset)];
+    }];
+    return items;
+}
+
+@end
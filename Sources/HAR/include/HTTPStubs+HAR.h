@@ -0,0 +1,87 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#import "HTTPStubs.h"
+#import "Compatibility.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Error codes for the OHHTTPStubs HAR category
+ */
+typedef NS_ENUM(NSInteger, OHHTTPStubsHARError) {
+    /** The specified file was not readable */
+    OHHTTPStubsHARErrorFileFailedToRead = 1,
+    /** The specified file is not a valid HAR archive */
+    OHHTTPStubsHARErrorInvalidFileFormat
+};
+
+/**
+ * Error domain for OHHTTPStubs HAR category errors
+ */
+extern NSString* const HARErrorDomain;
+
+/**
+ * Options for stubbing requests with a HAR archive
+ */
+typedef NS_OPTIONS(NSUInteger, HTTPStubsHAROptions) {
+    /**
+     * Match requests on their body too, so that requests only differing by their body get their own response.
+     *
+     * This enables the capture of request bodies (see `+[NSURLRequest OHHTTPStubs_setHTTPBodyCaptureEnabled:]`)
+     * when stubbing, so only the bodies set afterwards are matched. The capture then stays enabled for the rest
+     * of the process, even once the stub is removed, as other stubs may rely on it too.
+     */
+    HTTPStubsHAROptionMatchRequestBody = 1 << 0,
+    /** Use the recorded `wait` and `receive` timings as the `requestTime` and `responseTime` of the responses */
+    HTTPStubsHAROptionUseRecordedTimings = 1 << 1
+};
+
+@interface HTTPStubs (HAR)
+
+/**
+ * Add a stub replaying the responses recorded in a HAR (HTTP Archive) file, as exported by web browsers and proxies.
+ *
+ * The archive is parsed once, and its entries are indexed by HTTP method and URL (and request body, with
+ * `HTTPStubsHAROptionMatchRequestBody`), so that finding the response of a request doesn't depend on the number of entries.
+ * The whole archive, bodies included, is parsed as JSON when stubbing, so its text stays in memory as long as the stub;
+ * only the base64 decoding of the binary bodies is deferred to the first time they are sent.
+ * If several entries match the same request, they answer the successive requests in their recorded order,
+ * and the last one answers any further request.
+ * Entries without response (aborted requests) are ignored.
+ *
+ * Responses are sent decoded, so their `Content-Encoding`, `Content-Length` and `Transfer-Encoding` headers are dropped.
+ *
+ * @param harURL The URL of the HAR file.
+ * @param options The options to use for matching requests and building responses.
+ * @param error An out value that returns any error encountered during stubbing. Returns an NSError object if any error; otherwise returns nil.
+ *
+ * @return a stub descriptor that uniquely identifies the stub and can be later used to remove it with `removeStub:`.
+ */
++(nullable id<HTTPStubsDescriptor>)stubRequestsUsingHARFileAtURL:(NSURL *)harURL options:(HTTPStubsHAROptions)options error:(NSError **)error;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,142 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Imports
+
+#import <Foundation/Foundation.h>
+
+#import "HTTPStubs+HAR.h"
+#import "Compatibility.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Report
+
+/**
+ *  The measures of a `HTTPStubsHARReplay` run
+ */
+@interface HTTPStubsHARReplayReport : NSObject
+
+/**
+ *  The number of requests issued
+ */
+@property(nonatomic, assign, readonly) NSUInteger requestCount;
+
+/**
+ *  The number of requests which completed with an error
+ */
+@property(nonatomic, assign, readonly) NSUInteger failureCount;
+
+/**
+ *  The time between the start of the replay and the completion of its last request, in seconds
+ */
+@property(nonatomic, assign, readonly) NSTimeInterval duration;
+
+/**
+ *  The number of requests completed per second
+ */
+@property(nonatomic, assign, readonly) double throughput;
+
+/**
+ *  The largest delay between the time a request was due, once compressed by the
+ *  speed factor, and the time it was actually issued, in seconds. A growing lag
+ *  means that the thread issuing the requests cannot keep up with the replay.
+ */
+@property(nonatomic, assign, readonly) NSTimeInterval maximumLag;
+
+/**
+ *  The time between issuing a request and its completion, at the given percentile.
+ *
+ *  @param percentile The percentile, between 0 and 100 (e.g. `50` for the median, `99` for the p99)
+ *
+ *  @return The latency in seconds, or 0 if no request was issued.
+ */
+-(NSTimeInterval)latencyAtPercentile:(double)percentile;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Replay
+
+/**
+ *  Replays the traffic recorded in a HAR (HTTP Archive) file, at a chosen speed, to load test
+ *  the networking layer of a client.
+ *
+ *  The recorded responses are stubbed as with `+[HTTPStubs stubRequestsUsingHARFileAtURL:options:error:]`,
+ *  and the recorded requests are issued through the given session at their recorded offsets
+ *  (from the `startedDateTime` of the first entry), divided by the `speedFactor`.
+ *
+ *  @note The session must have HTTPStubs enabled, which is the case for sessions created with the
+ *        default or ephemeral configurations.
+ */
+@interface HTTPStubsHARReplay : NSObject
+
+/**
+ *  The number of recorded requests which will be issued
+ */
+@property(nonatomic, assign, readonly) NSUInteger requestCount;
+
+/**
+ *  The time between the first and the last recorded request, in seconds
+ */
+@property(nonatomic, assign, readonly) NSTimeInterval recordedDuration;
+
+/**
+ *  How much faster than recorded the requests are issued. Use `0` to issue them all at once.
+ *
+ *  Defaults to `1`.
+ */
+@property(nonatomic, assign) double speedFactor;
+
+/**
+ *  Load a HAR file to replay.
+ *
+ *  With `HTTPStubsHAROptionMatchRequestBody`, this enables the capture of request bodies before building the
+ *  recorded requests, so that their bodies can be matched. It then stays enabled for the rest of the process.
+ *
+ *  @param harURL  The URL of the HAR file.
+ *  @param options The options to use for matching requests and building responses.
+ *  @param error   An out value that returns any error encountered while reading the file.
+ *
+ *  @return A new replay, or nil if the file could not be read.
+ */
+-(nullable instancetype)initWithHARFileAtURL:(NSURL *)harURL options:(HTTPStubsHAROptions)options error:(NSError **)error;
+
+-(instancetype)init NS_UNAVAILABLE;
+
+/**
+ *  Stub the recorded responses and issue the recorded requests.
+ *
+ *  The stub is removed once all the requests have completed.
+ *
+ *  @param session    The session to issue the requests with.
+ *  @param completion Called on the main queue once all the requests have completed.
+ */
+-(void)replayWithSession:(NSURLSession *)session completion:(void(^)(HTTPStubsHARReplayReport *report))completion;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -27,35 +27,205 @@
 
 #import "HTTPStubsResponse+HTTPMessage.h"
 
+static NSUInteger const kHeaderReadChunkSize = 4096;
+static NSUInteger const kMaxHeaderLength = 64 * 1024;
+
+// Returns the offset right after the empty line ending the header of an HTTP message, or NSNotFound if it isn't in the data
+static NSUInteger HTTPStubsHTTPMessageBodyOffset(NSData *data, NSUInteger searchStart)
+{
+    NSRange searchRange = NSMakeRange(searchStart, data.length - searchStart);
+    NSRange crlf = [data rangeOfData:[NSData dataWithBytes:"\r\n\r\n" length:4] options:0 range:searchRange];
+    NSRange lf = [data rangeOfData:[NSData dataWithBytes:"\n\n" length:2] options:0 range:searchRange];
+    if (crlf.location == NSNotFound && lf.location == NSNotFound)
+    {
+        return NSNotFound;
+    }
+    return MIN(crlf.location == NSNotFound ? NSUIntegerMax : NSMaxRange(crlf), lf.location == NSNotFound ? NSUIntegerMax : NSMaxRange(lf));
+}
+
+// Parses the header of the final response of an HTTP message, skipping the interim (1xx) responses before it, like
+// "100 Continue". Returns NO if the data doesn't contain a complete final header yet.
+static BOOL HTTPStubsHTTPMessageParseFinalHeader(NSData *data, NSUInteger *bodyOffset, NSInteger *statusCode, NSDictionary **headers)
+{
+    NSUInteger headerStart = 0;
+    while (headerStart < data.length)
+    {
+        NSUInteger headerEnd = HTTPStubsHTTPMessageBodyOffset(data, headerStart);
+        if (headerEnd == NSNotFound)
+        {
+            return NO;
+        }
+
+        CFHTTPMessageRef httpMessage = CFHTTPMessageCreateEmpty(kCFAllocatorDefault, FALSE);
+        if (!httpMessage)
+        {
+            return NO;
+        }
+        CFHTTPMessageAppendBytes(httpMessage, (const UInt8 *)data.bytes + headerStart, (CFIndex)(headerEnd - headerStart));
+        BOOL headerComplete = CFHTTPMessageIsHeaderComplete(httpMessage);
+        NSInteger messageStatusCode = headerComplete ? (NSInteger)CFHTTPMessageGetResponseStatusCode(httpMessage) : 0;
+        if (headerComplete && (messageStatusCode < 100 || messageStatusCode >= 200))
+        {
+            *bodyOffset = headerEnd;
+            *statusCode = messageStatusCode;
+            *headers = (__bridge_transfer NSDictionary *)CFHTTPMessageCopyAllHeaderFields(httpMessage);
+        }
+        CFRelease(httpMessage);
+
+        if (!headerComplete)
+        {
+            return NO;
+        }
+        if (messageStatusCode < 100 || messageStatusCode >= 200)
+        {
+            return YES;
+        }
+        // Interim responses have no body: the next response starts right after their header
+        headerStart = headerEnd;
+    }
+    return NO;
+}
+
+static NSString *HTTPStubsHTTPMessageHeaderKey(NSDictionary *headers, NSString *name)
+{
+    for (NSString *key in headers)
+    {
+        if ([key caseInsensitiveCompare:name] == NSOrderedSame)
+        {
+            return key;
+        }
+    }
+    return nil;
+}
+
+static BOOL HTTPStubsHTTPMessageIsChunked(NSDictionary *headers)
+{
+    NSString *key = HTTPStubsHTTPMessageHeaderKey(headers, @"Transfer-Encoding");
+    return key && [[headers[key] lowercaseString] containsString:@"chunked"];
+}
+
+// The headers of a decoded chunked body, which is sent without Transfer-Encoding nor Content-Length
+static NSDictionary *HTTPStubsDechunkedHeaders(NSDictionary *headers)
+{
+    NSMutableDictionary *dechunkedHeaders = [headers mutableCopy];
+    for (NSString *name in @[@"Transfer-Encoding", @"Content-Length"])
+    {
+        NSString *key = HTTPStubsHTTPMessageHeaderKey(dechunkedHeaders, name);
+        if (key)
+        {
+            [dechunkedHeaders removeObjectForKey:key];
+        }
+    }
+    return dechunkedHeaders;
+}
+
+// Decodes a chunked body one chunk at a time, as the response is sent, each chunk making a frame.
+// The body ends with the last (empty) chunk, whose trailers are ignored, or with the data if truncated.
+static HTTPStubsFrameProvider HTTPStubsChunkedBodyFrameProvider(NSData *data, NSUInteger bodyOffset)
+{
+    __block NSUInteger offset = bodyOffset;
+    return ^NSData *(NSTimeInterval *delay) {
+        const uint8_t *bytes = data.bytes;
+        NSUInteger length = data.length;
+
+        // Chunk size line: hexadecimal size, optional ";extensions", CRLF
+        NSUInteger idx = offset;
+        while (idx < length && (bytes[idx] == ' ' || bytes[idx] == '\t'))
+        {
+            idx++;
+        }
+        unsigned long long size = 0;
+        NSUInteger digits = 0;
+        while (idx < length && isxdigit(bytes[idx]) && size <= length)
+        {
+            uint8_t digit = bytes[idx++];
+            size = size * 16 + (unsigned long long)(isdigit(digit) ? digit - '0' : tolower(digit) - 'a' + 10);
+            digits++;
+        }
+        while (idx < length && bytes[idx] != '\n')
+        {
+            idx++;
+        }
+        if (digits == 0 || size == 0 || idx >= length)
+        {
+            return nil;
+        }
+
+        NSUInteger chunkStart = idx + 1;
+        NSUInteger chunkLength = (NSUInteger)MIN(size, (unsigned long long)(length - chunkStart));
+        NSData *chunk = [data subdataWithRange:NSMakeRange(chunkStart, chunkLength)];
+
+        // Skip the CRLF ending the chunk data
+        offset = chunkStart + chunkLength;
+        if (offset < length && bytes[offset] == '\r') offset++;
+        if (offset < length && bytes[offset] == '\n') offset++;
+        return chunk;
+    };
+}
+
 @implementation HTTPStubsResponse (HTTPMessage)
 
 #pragma mark Building response from HTTP Message Data (dump from "curl -is")
 
 +(instancetype)responseWithHTTPMessageData:(NSData*)responseData;
 {
-    NSData *data = [NSData data];
+    NSUInteger bodyOffset = 0;
     NSInteger statusCode = 200;
     NSDictionary *headers = @{};
 
-    CFHTTPMessageRef httpMessage = CFHTTPMessageCreateEmpty(kCFAllocatorDefault, FALSE);
-    if (httpMessage)
+    if (!HTTPStubsHTTPMessageParseFinalHeader(responseData, &bodyOffset, &statusCode, &headers))
+    {
+        // Not an HTTP message: the whole data is the body
+        return [self responseWithData:responseData statusCode:200 headers:@{}];
+    }
+    if (HTTPStubsHTTPMessageIsChunked(headers))
     {
-        CFHTTPMessageAppendBytes(httpMessage, responseData.bytes, responseData.length);
+        return [self responseWithFrameProvider:HTTPStubsChunkedBodyFrameProvider(responseData, bodyOffset)
+                                    statusCode:(int)statusCode
+                                       headers:HTTPStubsDechunkedHeaders(headers)];
+    }
+    return [self responseWithData:[responseData subdataWithRange:NSMakeRange(bodyOffset, responseData.length - bodyOffset)]
+                       statusCode:(int)statusCode
+                          headers:headers];
+}
 
-        data = responseData; // By default
++(instancetype)responseWithHTTPMessageFileAtURL:(NSURL*)fileURL
+{
+    // Only read the headers, the body being streamed from the file when the response is sent
+    NSFileHandle *fileHandle = [NSFileHandle fileHandleForReadingFromURL:fileURL error:NULL];
+    NSAssert(fileHandle, @"Could not read HTTP response file at '%@'", fileURL);
 
-        if (CFHTTPMessageIsHeaderComplete(httpMessage))
+    NSMutableData *header = [NSMutableData new];
+    NSUInteger bodyOffset = 0;
+    NSInteger statusCode = 200;
+    NSDictionary *headers = @{};
+    BOOL headerComplete = NO;
+    while (!headerComplete && header.length < kMaxHeaderLength)
+    {
+        NSData *chunk = [fileHandle readDataOfLength:kHeaderReadChunkSize];
+        if (chunk.length == 0)
         {
-            statusCode = (NSInteger)CFHTTPMessageGetResponseStatusCode(httpMessage);
-            headers = (__bridge_transfer NSDictionary *)CFHTTPMessageCopyAllHeaderFields(httpMessage);
-            data = (__bridge_transfer NSData *)CFHTTPMessageCopyBody(httpMessage);
+            break;
         }
-        CFRelease(httpMessage);
+        [header appendData:chunk];
+        headerComplete = HTTPStubsHTTPMessageParseFinalHeader(header, &bodyOffset, &statusCode, &headers);
     }
+    [fileHandle closeFile];
 
-    return [self responseWithData:data
-                       statusCode:(int)statusCode
-                          headers:headers];
+    if (headerComplete && HTTPStubsHTTPMessageIsChunked(headers))
+    {
+        // Mapped, so that chunks are only read from the file as they are sent
+        NSData *message = [NSData dataWithContentsOfURL:fileURL options:NSDataReadingMappedIfSafe error:NULL];
+        return [self responseWithFrameProvider:HTTPStubsChunkedBodyFrameProvider(message ?: header, bodyOffset)
+                                    statusCode:(int)statusCode
+                                       headers:HTTPStubsDechunkedHeaders(headers)];
+    }
+
+    // Like responseWithHTTPMessageData:, the whole file is the body if it doesn't start with a valid header
+    return [self responseWithFileURL:fileURL
+                              offset:headerComplete ? bodyOffset : 0
+                          statusCode:headerComplete ? (int)statusCode : 200
+                             headers:headerComplete ? headers : @{}];
 }
 
 +(instancetype)responseNamed:(NSString*)responseName
@@ -63,11 +233,9 @@
 {
     NSURL *responseURL = [responsesBundle?:[NSBundle bundleForClass:self.class] URLForResource:responseName
                                                                                    withExtension:@"response"];
+    NSAssert(responseURL, @"Could not find HTTP response named '%@' in bundle '%@'", responseName, responsesBundle);
 
-    NSData *responseData = [NSData dataWithContentsOfURL:responseURL];
-    NSAssert(responseData, @"Could not find HTTP response named '%@' in bundle '%@'", responseName, responsesBundle);
-
-    return [self responseWithHTTPMessageData:responseData];
+    return [self responseWithHTTPMessageFileAtURL:responseURL];
 }
 
 @end
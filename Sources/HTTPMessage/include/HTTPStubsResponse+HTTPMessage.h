@@ -41,12 +41,12 @@ NS_ASSUME_NONNULL_BEGIN
 
 /*! @name Building a response from HTTP Message data */
 
-// TODO: Try to implement it using NSInputStream someday?
-
 /**
  * Builds a response given a message data as returned by `curl -is [url]`, that is containing both the headers and the body.
  *
- * This method will split the headers and the body and build a HTTPStubsResponse accordingly
+ * This method will split the headers and the body and build a HTTPStubsResponse accordingly.
+ * Interim responses (like `100 Continue`) preceding the final response are skipped, and a body using
+ * `Transfer-Encoding: chunked` is decoded as it is sent, each chunk being delivered as a separate frame.
  *
  * @param responseData The NSData containing the whole HTTP response, including the headers and the body
  *
@@ -54,11 +54,24 @@ NS_ASSUME_NONNULL_BEGIN
  */
 +(instancetype)responseWithHTTPMessageData:(NSData*)responseData;
 
+/**
+ * Builds a response given the URL of a file containing both the headers and the body, as output by `curl -is [url]`.
+ *
+ * Only the headers are read when building the response: the body is sent straight from the file, starting right after
+ * the empty line ending the headers, and its size is taken from the size of the file.
+ * As with `responseWithHTTPMessageData:`, interim responses are skipped and chunked bodies are decoded chunk by chunk.
+ *
+ * @param fileURL The URL of the file containing the whole HTTP response, including the headers and the body
+ *
+ * @return An `HTTPStubsResponse` describing the corresponding response to return by the stub
+ */
++(instancetype)responseWithHTTPMessageFileAtURL:(NSURL*)fileURL;
+
 /**
  * Builds a response given the name of a `"*.response"` file containing both the headers and the body.
  *
  * The response file is expected to be in the specified bundle (or the application bundle if nil).
- * This method will split the headers and the body and build a HTTPStubsResponse accordingly
+ * Like `responseWithHTTPMessageFileAtURL:`, this method only reads the headers, the body being sent from the file
  *
  * @param responseName The name of the `"*.response"` file (without extension) containing the whole
  *                     HTTP response (including the headers and the body)
@@ -26,8 +26,1006 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #import "HTTPStubs+Mocktail.h"
+#import "HTTPStubsMocktail.h"
+#import "HTTPStubsBase64.h"
+#import "HTTPStubsFixtureCache.h"
+
+#import <fcntl.h>
+#import <unistd.h>
+
+#ifndef O_EVTONLY
+#define O_EVTONLY O_RDONLY
+#endif
 
 NSString* const MocktailErrorDomain = @"Mocktail";
+NSString* const MocktailManifestFileName = @"mocktails.json";
+
+static NSString* const kBase64ContentTypeSuffix = @";base64";
+
+static NSUInteger const kHeaderReadChunkSize = 1024;
+static NSUInteger const kMaxHeaderLength = 64 * 1024;
+
+// Reads the code unit of `unitLength` bytes (1 for UTF-8, 2 for UTF-16, 4 for UTF-32) at `offset`
+static uint32_t HTTPStubsMocktailCodeUnit(const uint8_t *bytes, NSUInteger offset, NSUInteger unitLength, BOOL bigEndian)
+{
+    uint32_t unit = 0;
+    for (NSUInteger i = 0; i < unitLength; i++)
+    {
+        NSUInteger byteIndex = bigEndian ? i : unitLength - 1 - i;
+        unit = (unit << 8) | bytes[offset + byteIndex];
+    }
+    return unit;
+}
+
+// Reads the header of a Mocktail file, up to the empty line separating it from the body, without reading the body.
+// The header is decoded as UTF-8, unless the file starts with a UTF-16 or UTF-32 byte order mark, in which case
+// the separator is searched and the header decoded in that encoding; the body is kept as is.
+// Returns nil if the file can't be read or if its header isn't valid in its encoding.
+static NSString *HTTPStubsMocktailReadHeader(NSURL *fileURL, NSUInteger *bodyOffset)
+{
+    NSFileHandle *fileHandle = [NSFileHandle fileHandleForReadingFromURL:fileURL error:NULL];
+    if (!fileHandle)
+    {
+        return nil;
+    }
+
+    NSStringEncoding encoding = NSUTF8StringEncoding;
+    NSUInteger unitLength = 1;
+    BOOL bigEndian = NO;
+    NSData *separatorData = nil;
+    NSMutableData *buffer = [NSMutableData new];
+    NSRange separator = NSMakeRange(NSNotFound, 0);
+    // Where the header starts, after a byte order mark and leading blank characters, which still count in the body offset
+    NSUInteger headerStart = 0;
+    BOOL headerStarted = NO;
+    while (buffer.length < kMaxHeaderLength)
+    {
+        NSData *chunk = [fileHandle readDataOfLength:kHeaderReadChunkSize];
+        if (chunk.length == 0)
+        {
+            break;
+        }
+        NSUInteger previousLength = buffer.length;
+        [buffer appendData:chunk];
+        const uint8_t *bytes = buffer.bytes;
+
+        if (!separatorData)
+        {
+            // The first chunk tells the encoding, from the byte order mark if any
+            NSUInteger length = buffer.length;
+            if (length >= 4 && bytes[0] == 0xFF && bytes[1] == 0xFE && bytes[2] == 0x00 && bytes[3] == 0x00)
+            {
+                encoding = NSUTF32LittleEndianStringEncoding;
+                unitLength = 4;
+                headerStart = 4;
+            }
+            else if (length >= 4 && bytes[0] == 0x00 && bytes[1] == 0x00 && bytes[2] == 0xFE && bytes[3] == 0xFF)
+            {
+                encoding = NSUTF32BigEndianStringEncoding;
+                unitLength = 4;
+                bigEndian = YES;
+                headerStart = 4;
+            }
+            else if (length >= 2 && bytes[0] == 0xFF && bytes[1] == 0xFE)
+            {
+                encoding = NSUTF16LittleEndianStringEncoding;
+                unitLength = 2;
+                headerStart = 2;
+            }
+            else if (length >= 2 && bytes[0] == 0xFE && bytes[1] == 0xFF)
+            {
+                encoding = NSUTF16BigEndianStringEncoding;
+                unitLength = 2;
+                bigEndian = YES;
+                headerStart = 2;
+            }
+            else if (length >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF)
+            {
+                headerStart = 3;
+            }
+            // The explicit endianness encodings don't prepend a byte order mark
+            separatorData = [@"\n\n" dataUsingEncoding:encoding];
+        }
+
+        // Leading blank lines are not the separator, so only search for it once the header has started
+        if (!headerStarted)
+        {
+            while (headerStart + unitLength <= buffer.length)
+            {
+                uint32_t unit = HTTPStubsMocktailCodeUnit(bytes, headerStart, unitLength, bigEndian);
+                if (unit >= 0x80 || !isspace((int)unit))
+                {
+                    break;
+                }
+                headerStart += unitLength;
+            }
+            headerStarted = (headerStart + unitLength <= buffer.length);
+            if (!headerStarted)
+            {
+                continue;
+            }
+        }
+
+        // The separator may straddle the previous chunk and this one
+        NSUInteger searchStart = previousLength >= separatorData.length ? previousLength - separatorData.length + 1 : 0;
+        searchStart = MAX(searchStart, headerStart);
+        while (searchStart < buffer.length)
+        {
+            separator = [buffer rangeOfData:separatorData options:0 range:NSMakeRange(searchStart, buffer.length - searchStart)];
+            // In UTF-16 and UTF-32, only a match on a code unit boundary is the separator
+            if (separator.location == NSNotFound || (separator.location - headerStart) % unitLength == 0)
+            {
+                break;
+            }
+            searchStart = separator.location + 1;
+            separator = NSMakeRange(NSNotFound, 0);
+        }
+        if (separator.location != NSNotFound)
+        {
+            break;
+        }
+    }
+    [fileHandle closeFile];
+
+    // Without separator, the whole file is the header (and the body is empty)
+    NSUInteger headerEnd = buffer.length;
+    if (separator.location != NSNotFound)
+    {
+        headerEnd = separator.location;
+    }
+    else if (headerStart < buffer.length)
+    {
+        // Ignore a trailing incomplete code unit
+        headerEnd = headerStart + (buffer.length - headerStart) / unitLength * unitLength;
+    }
+    headerStart = MIN(headerStart, headerEnd);
+    const uint8_t *bytes = buffer.bytes;
+
+    *bodyOffset = headerEnd + 2 * unitLength;
+    return [[NSString alloc] initWithBytes:bytes + headerStart length:headerEnd - headerStart encoding:encoding];
+}
+
+// The body of a base64-encoded tail, decoded on first use then shared by all the responses of the stub.
+// When the shared fixture cache is enabled, the decoded body lives in the cache instead, and is fetched
+// again for each response, so that the cache can evict it.
+@interface HTTPStubsMocktailBase64Body : NSObject
+-(instancetype)initWithFileURL:(NSURL*)fileURL bodyOffset:(NSUInteger)bodyOffset;
+@property(nonatomic, strong, readonly) NSData* data;
+@end
+
+@implementation HTTPStubsMocktailBase64Body
+{
+    NSURL* _fileURL;
+    NSUInteger _bodyOffset;
+    NSData* _data;
+}
+
+-(instancetype)initWithFileURL:(NSURL*)fileURL bodyOffset:(NSUInteger)bodyOffset
+{
+    self = [super init];
+    if (self)
+    {
+        _fileURL = fileURL;
+        _bodyOffset = bodyOffset;
+    }
+    return self;
+}
+
+-(NSData*)data
+{
+    HTTPStubsFixtureCache *fixtureCache = HTTPStubsFixtureCache.sharedCache;
+    if (fixtureCache.enabled)
+    {
+        NSData *decodedBody = [fixtureCache dataWithContentsOfFileURL:_fileURL offset:_bodyOffset decoder:^NSData *(NSData *encodedBody) {
+            return HTTPStubsBase64DecodedData(encodedBody);
+        } error:NULL];
+        return decodedBody ?: [NSData data];
+    }
+
+    @synchronized(self)
+    {
+        if (!_data)
+        {
+            NSFileHandle *fileHandle = [NSFileHandle fileHandleForReadingFromURL:_fileURL error:NULL];
+            [fileHandle seekToFileOffset:_bodyOffset];
+            NSData *encodedBody = [fileHandle readDataToEndOfFile];
+            [fileHandle closeFile];
+            NSData *decodedBody = encodedBody ? HTTPStubsBase64DecodedData(encodedBody) : nil;
+            _data = decodedBody ?: [NSData data];
+        }
+        return _data;
+    }
+}
+
+@end
+
+@implementation HTTPStubsMocktail
+{
+    HTTPStubsMocktail *_parsedMocktail;
+    NSError *_parseError;
+}
+
+-(NSRegularExpression *)methodRegex
+{
+    @synchronized(self)
+    {
+        if (!_methodRegex)
+        {
+            _methodRegex = [NSRegularExpression regularExpressionWithPattern:self.methodPattern options:NSRegularExpressionCaseInsensitive error:NULL];
+        }
+        return _methodRegex;
+    }
+}
+
+-(NSRegularExpression *)absoluteURLRegex
+{
+    @synchronized(self)
+    {
+        if (!_absoluteURLRegex)
+        {
+            _absoluteURLRegex = [NSRegularExpression regularExpressionWithPattern:self.absoluteURLPattern options:NSRegularExpressionCaseInsensitive error:NULL];
+        }
+        return _absoluteURLRegex;
+    }
+}
+
+-(BOOL)matchesRequest:(NSURLRequest *)request
+{
+    NSString *absoluteURL = (request.URL).absoluteString;
+    NSString *method = request.HTTPMethod;
+
+    if ([self.absoluteURLRegex numberOfMatchesInString:absoluteURL options:0 range:NSMakeRange(0, absoluteURL.length)] > 0)
+    {
+        if ([self.methodRegex numberOfMatchesInString:method options:0 range:NSMakeRange(0, method.length)] > 0)
+        {
+            return YES;
+        }
+    }
+
+    return NO;
+}
+
+-(HTTPStubsResponse *)response
+{
+    if (self.deferred)
+    {
+        HTTPStubsMocktail *parsedMocktail;
+        NSError *parseError;
+        @synchronized(self)
+        {
+            if (!_parsedMocktail && !_parseError)
+            {
+                NSError *error = nil;
+                _parsedMocktail = [HTTPStubs mocktailWithContentsOfURL:(NSURL *)self.fileURL error:&error];
+                _parseError = _parsedMocktail ? nil : error;
+            }
+            parsedMocktail = _parsedMocktail;
+            parseError = _parseError;
+        }
+        return parsedMocktail ? [parsedMocktail response] : [HTTPStubsResponse responseWithError:(NSError *)parseError];
+    }
+    else if (self.base64Body || self.body)
+    {
+        // Not using responseWithData:, as the body is already shared and doesn't need to go through the fixture cache again
+        NSData *body = self.body ?: self.base64Body.data;
+        HTTPStubsResponse *response = [[HTTPStubsResponse alloc] initWithInputStream:[NSInputStream inputStreamWithData:body]
+                                                                            dataSize:body.length
+                                                                          statusCode:self.statusCode
+                                                                             headers:self.headers];
+        return response;
+    }
+    else
+    {
+        return [HTTPStubsResponse responseWithFileURL:(NSURL *)self.fileURL
+                                               offset:self.bodyOffset
+                                           statusCode:self.statusCode
+                                              headers:self.headers];
+    }
+}
+
+@end
+
+// Returns the uppercased HTTP methods of a method pattern made of literal alternatives only (like "GET|POST"), nil otherwise
+static NSArray<NSString *> *HTTPStubsMocktailMethodLiterals(NSString *pattern)
+{
+    static NSCharacterSet *nonLiteralCharacters;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        nonLiteralCharacters = [NSCharacterSet characterSetWithCharactersInString:@"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz|"].invertedSet;
+    });
+
+    // Anchors only make the pattern stricter, so they can be ignored for candidate selection
+    if ([pattern hasPrefix:@"^"]) pattern = [pattern substringFromIndex:1];
+    if ([pattern hasSuffix:@"$"]) pattern = [pattern substringToIndex:pattern.length - 1];
+    if (pattern.length == 0 || [pattern rangeOfCharacterFromSet:nonLiteralCharacters].location != NSNotFound)
+    {
+        return nil;
+    }
+    NSArray<NSString *> *methods = [pattern.uppercaseString componentsSeparatedByString:@"|"];
+    return [methods containsObject:@""] ? nil : methods;
+}
+
+// Returns the lowercased literal runs any string matching the pattern must contain (anchored or not),
+// or an empty array if the pattern has no such run (like with a top-level alternation).
+// Anything not obviously literal ends the current run, so the runs may be shorter than possible, never wrong.
+static NSArray<NSString *> *HTTPStubsMocktailRequiredLiterals(NSString *pattern)
+{
+    static NSCharacterSet *metaCharacters;
+    static NSCharacterSet *quantifiers;
+    static NSCharacterSet *escapeSequenceCharacters;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        metaCharacters = [NSCharacterSet characterSetWithCharactersInString:@".[]()*+?{}|^$\\"];
+        quantifiers = [NSCharacterSet characterSetWithCharactersInString:@"*+?{"];
+        escapeSequenceCharacters = [NSCharacterSet characterSetWithCharactersInString:@"0123456789abcdefABCDEF"];
+    });
+
+    // In free-spacing mode, whitespace and comments in the pattern are not literal
+    if ([pattern rangeOfString:@"(?"].location != NSNotFound
+        && [pattern rangeOfString:@"\\(\\?[a-zA-Z-]*x" options:NSRegularExpressionSearch].location != NSNotFound)
+    {
+        return @[];
+    }
+
+    NSMutableArray<NSString *> *runs = [NSMutableArray new];
+    NSMutableString *run = [NSMutableString new];
+    void (^endRun)(void) = ^{
+        if (run.length > 0)
+        {
+            [runs addObject:run.lowercaseString];
+            [run setString:@""];
+        }
+    };
+
+    NSUInteger length = pattern.length;
+    NSUInteger depth = 0;
+    NSUInteger idx = 0;
+    while (idx < length)
+    {
+        unichar character = [pattern characterAtIndex:idx];
+        NSUInteger next = idx + 1;
+        BOOL literal = NO;
+        if (character == '\\')
+        {
+            if (next >= length) break;
+            unichar escaped = [pattern characterAtIndex:next];
+            next++;
+            if (escaped == 'Q')
+            {
+                // Quoted sections could hide anything, including a top-level '|'
+                return @[];
+            }
+            if (escaped > 127 || isalnum(escaped))
+            {
+                // A class (\d, \p{L}…), an assertion (\b…) or a code point (\x41, \cM…): skip its arguments too
+                endRun();
+                if (next < length && [pattern characterAtIndex:next] == '{')
+                {
+                    NSRange closingBrace = [pattern rangeOfString:@"}" options:0 range:NSMakeRange(next, length - next)];
+                    next = (closingBrace.location != NSNotFound) ? NSMaxRange(closingBrace) : length;
+                }
+                else if (escaped == 'c' || escaped == 'p' || escaped == 'P')
+                {
+                    next = MIN(next + 1, length);
+                }
+                else
+                {
+                    while (next < length && [escapeSequenceCharacters characterIsMember:[pattern characterAtIndex:next]]) next++;
+                }
+                idx = next;
+                continue;
+            }
+            character = escaped;
+            literal = YES;
+        }
+        else if (character == '[')
+        {
+            // Skip the character class, including a leading ']' or '^]' and escaped characters
+            endRun();
+            if (next < length && [pattern characterAtIndex:next] == '^') next++;
+            if (next < length && [pattern characterAtIndex:next] == ']') next++;
+            while (next < length && [pattern characterAtIndex:next] != ']')
+            {
+                next += ([pattern characterAtIndex:next] == '\\') ? 2 : 1;
+            }
+            idx = next + 1;
+            continue;
+        }
+        else if (character == '{')
+        {
+            // A bounded quantifier, whose digits are not literal
+            endRun();
+            NSRange closingBrace = [pattern rangeOfString:@"}" options:0 range:NSMakeRange(next, length - next)];
+            idx = (closingBrace.location != NSNotFound) ? NSMaxRange(closingBrace) : length;
+            continue;
+        }
+        else if (character == '(')
+        {
+            // Groups may be optional, repeated or hold alternatives: their content is never required
+            endRun();
+            depth++;
+        }
+        else if (character == ')')
+        {
+            endRun();
+            if (depth > 0) depth--;
+        }
+        else if (character == '|')
+        {
+            if (depth == 0)
+            {
+                return @[];
+            }
+        }
+        else if (character > 127 || [metaCharacters characterIsMember:character])
+        {
+            endRun();
+        }
+        else
+        {
+            literal = YES;
+        }
+
+        if (literal && depth == 0)
+        {
+            // A quantified character is optional or repeated, so the run stops right before it
+            if (next < length && [quantifiers characterIsMember:[pattern characterAtIndex:next]])
+            {
+                endRun();
+            }
+            else
+            {
+                [run appendFormat:@"%C", character];
+            }
+        }
+        idx = next;
+    }
+    endRun();
+    return runs;
+}
+
+// Mocktails are indexed by a three-character substring of their required literals, encoded as an integer
+static NSUInteger const kTrigramLength = 3;
+// The trigram of the Mocktails without required literal text, which can't be the one of three ASCII characters
+static uint32_t const kUnindexedTrigram = UINT32_MAX;
+
+static uint32_t HTTPStubsMocktailTrigram(const uint8_t *bytes)
+{
+    return ((uint32_t)bytes[0] << 16) | ((uint32_t)bytes[1] << 8) | (uint32_t)bytes[2];
+}
+
+// The lowercased ASCII bytes of the URL of a request, to look its trigrams up.
+// Non-ASCII characters can't be part of a trigram, so they may be dropped.
+static NSData *HTTPStubsMocktailTrigramBytes(NSURLRequest *request)
+{
+    return [request.URL.absoluteString.lowercaseString dataUsingEncoding:NSASCIIStringEncoding allowLossyConversion:YES] ?: [NSData data];
+}
+
+// Returns the trigram indexing each URL pattern (kUnindexedTrigram if none): among the trigrams of the literal
+// text the pattern requires, the one shared by the fewest patterns, so that buckets stay small.
+static NSArray<NSNumber *> *HTTPStubsMocktailIndexTrigrams(NSArray<NSString *> *urlPatterns)
+{
+    NSMutableArray<NSSet<NSNumber *> *> *patternTrigrams = [NSMutableArray arrayWithCapacity:urlPatterns.count];
+    NSCountedSet<NSNumber *> *trigramCounts = [NSCountedSet new];
+    for (NSString *urlPattern in urlPatterns)
+    {
+        NSMutableSet<NSNumber *> *trigrams = [NSMutableSet new];
+        for (NSString *run in HTTPStubsMocktailRequiredLiterals(urlPattern))
+        {
+            NSData *bytes = [run dataUsingEncoding:NSASCIIStringEncoding];
+            for (NSUInteger offset = 0; offset + kTrigramLength <= bytes.length; offset++)
+            {
+                [trigrams addObject:@(HTTPStubsMocktailTrigram((const uint8_t *)bytes.bytes + offset))];
+            }
+        }
+        [patternTrigrams addObject:trigrams];
+        for (NSNumber *trigram in trigrams)
+        {
+            [trigramCounts addObject:trigram];
+        }
+    }
+
+    NSMutableArray<NSNumber *> *indexTrigrams = [NSMutableArray arrayWithCapacity:urlPatterns.count];
+    for (NSSet<NSNumber *> *trigrams in patternTrigrams)
+    {
+        NSNumber *trigram = nil;
+        for (NSNumber *candidate in trigrams)
+        {
+            if (!trigram || [trigramCounts countForObject:candidate] < [trigramCounts countForObject:trigram])
+            {
+                trigram = candidate;
+            }
+        }
+        [indexTrigrams addObject:trigram ?: @(kUnindexedTrigram)];
+    }
+    return indexTrigrams;
+}
+
+static NSString *const kAnyMethodKey = @"*";
+
+// Dispatches requests to the Mocktails of a folder, only evaluating the regular expressions of the few
+// Mocktails that can match. Mocktails are grouped by HTTP method, then by one trigram (the rarest in the
+// folder) of the literal text any matching URL must contain, so that a lookup costs one dictionary lookup
+// per trigram of the URL instead of one regular expression per Mocktail. Mocktails without such a literal
+// (like ".*" or "a|b") are always candidates.
+// As for separate stubs, the last Mocktail matching a request wins.
+@protocol HTTPStubsMocktailRouting <NSObject>
+-(nullable HTTPStubsMocktail *)mocktailForRequest:(NSURLRequest *)request;
+@end
+
+@interface HTTPStubsMocktailRouter : NSObject <HTTPStubsMocktailRouting>
+-(instancetype)initWithMocktails:(NSArray<HTTPStubsMocktail *> *)mocktails;
+@end
+
+@implementation HTTPStubsMocktailRouter
+{
+    NSArray<HTTPStubsMocktail *> *_mocktails;
+    // Method key -> trigram -> indexes of the Mocktails
+    NSDictionary<NSString *, NSDictionary<NSNumber *, NSIndexSet *> *> *_buckets;
+    // Method key -> indexes of the Mocktails without a required trigram
+    NSDictionary<NSString *, NSIndexSet *> *_unindexed;
+    NSArray<NSString *> *_methodKeys;
+}
+
+-(instancetype)initWithMocktails:(NSArray<HTTPStubsMocktail *> *)mocktails
+{
+    self = [super init];
+    if (self)
+    {
+        _mocktails = [mocktails copy];
+
+        NSArray<NSNumber *> *indexTrigrams = HTTPStubsMocktailIndexTrigrams([_mocktails valueForKey:@"absoluteURLPattern"]);
+        NSMutableDictionary *buckets = [NSMutableDictionary new];
+        NSMutableDictionary *unindexed = [NSMutableDictionary new];
+        [_mocktails enumerateObjectsUsingBlock:^(HTTPStubsMocktail *mocktail, NSUInteger idx, BOOL *stop) {
+            NSNumber *trigram = indexTrigrams[idx];
+            for (NSString *methodKey in HTTPStubsMocktailMethodLiterals(mocktail.methodPattern) ?: @[kAnyMethodKey])
+            {
+                NSMutableIndexSet *indexes;
+                if (trigram.unsignedIntValue != kUnindexedTrigram)
+                {
+                    NSMutableDictionary *methodBuckets = buckets[methodKey] ?: (buckets[methodKey] = [NSMutableDictionary new]);
+                    indexes = methodBuckets[trigram] ?: (methodBuckets[trigram] = [NSMutableIndexSet new]);
+                }
+                else
+                {
+                    indexes = unindexed[methodKey] ?: (unindexed[methodKey] = [NSMutableIndexSet new]);
+                }
+                [indexes addIndex:idx];
+            }
+        }];
+        _buckets = [buckets copy];
+        _unindexed = [unindexed copy];
+        NSMutableSet<NSString *> *methodKeys = [NSMutableSet setWithArray:_buckets.allKeys];
+        [methodKeys addObjectsFromArray:_unindexed.allKeys];
+        _methodKeys = methodKeys.allObjects;
+    }
+    return self;
+}
+
+-(HTTPStubsMocktail *)mocktailForRequest:(NSURLRequest *)request
+{
+    NSString *method = request.HTTPMethod.uppercaseString ?: @"";
+    NSData *url = HTTPStubsMocktailTrigramBytes(request);
+    const uint8_t *urlBytes = url.bytes;
+
+    NSMutableIndexSet *candidates = [NSMutableIndexSet new];
+    void (^addCandidates)(NSString *) = ^(NSString *methodKey) {
+        NSIndexSet *unindexed = self->_unindexed[methodKey];
+        if (unindexed)
+        {
+            [candidates addIndexes:unindexed];
+        }
+        NSDictionary<NSNumber *, NSIndexSet *> *methodBuckets = self->_buckets[methodKey];
+        for (NSUInteger offset = 0; methodBuckets && offset + kTrigramLength <= url.length; offset++)
+        {
+            NSIndexSet *indexes = methodBuckets[@(HTTPStubsMocktailTrigram(urlBytes + offset))];
+            if (indexes)
+            {
+                [candidates addIndexes:indexes];
+            }
+        }
+    };
+    for (NSString *methodKey in _methodKeys)
+    {
+        // Method patterns are unanchored, so a literal matches any method containing it
+        if ([methodKey isEqualToString:kAnyMethodKey] || [method rangeOfString:methodKey].location != NSNotFound)
+        {
+            addCandidates(methodKey);
+        }
+    }
+
+    __block HTTPStubsMocktail *match = nil;
+    [candidates enumerateIndexesWithOptions:NSEnumerationReverse usingBlock:^(NSUInteger idx, BOOL *stop) {
+        HTTPStubsMocktail *mocktail = self->_mocktails[idx];
+        if ([mocktail matchesRequest:request])
+        {
+            match = mocktail;
+            *stop = YES;
+        }
+    }];
+    return match;
+}
+
+@end
+
+// Mocktail pack layout. All integers are little endian, offsets are relative to the start of their section.
+//   HTTPStubsMocktailPackHeader
+//   HTTPStubsMocktailPackEntry × entryCount, in routing order
+//   HTTPStubsMocktailPackIndexEntry × entryCount, sorted by trigram then entry (unindexed entries last)
+//   Strings section: the patterns and the "Name: Value\n" header lines of the entries, in UTF-8
+//   Bodies section: the decoded bodies of the entries
+static char const kMocktailPackMagic[8] = { 'O', 'H', 'M', 'T', 'P', 'A', 'C', 'K' };
+static uint32_t const kMocktailPackVersion = 2;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t entryCount;
+    uint64_t indexOffset;
+    uint64_t stringsOffset;
+    uint64_t stringsLength;
+    uint64_t bodiesOffset;
+    uint64_t bodiesLength;
+} HTTPStubsMocktailPackHeader;
+
+// The routing index of a pack, as built by HTTPStubsMocktailIndexTrigrams
+typedef struct {
+    uint32_t trigram;
+    uint32_t entryIndex;
+} HTTPStubsMocktailPackIndexEntry;
+
+typedef struct {
+    uint32_t methodPatternOffset;
+    uint32_t methodPatternLength;
+    uint32_t absoluteURLPatternOffset;
+    uint32_t absoluteURLPatternLength;
+    uint32_t headersOffset;
+    uint32_t headersLength;
+    int32_t statusCode;
+    uint32_t reserved;
+    uint64_t bodyOffset;
+    uint64_t bodyLength;
+} HTTPStubsMocktailPackEntry;
+
+static NSError *HTTPStubsMocktailPackError(NSURL *packURL, NSString *reason)
+{
+    return [NSError errorWithDomain:MocktailErrorDomain code:OHHTTPStubsMocktailErrorInvalidPackFile userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Pack '%@' is invalid: %@.", packURL.absoluteString, reason]}];
+}
+
+// Returns a slice of the pack sharing its bytes, which keeps the pack mapped as long as the slice is alive
+static NSData *HTTPStubsMocktailPackSlice(NSData *pack, uint64_t offset, uint64_t length)
+{
+    void *bytes = (uint8_t *)pack.bytes + offset;
+    return [[NSData alloc] initWithBytesNoCopy:bytes length:(NSUInteger)length deallocator:^(void *sliceBytes, NSUInteger sliceLength) {
+        (void)pack;
+    }];
+}
+
+static NSString *HTTPStubsMocktailPackString(NSData *pack, uint64_t stringsOffset, uint32_t offset, uint32_t length)
+{
+    return [[NSString alloc] initWithBytes:(const uint8_t *)pack.bytes + stringsOffset + offset length:length encoding:NSUTF8StringEncoding];
+}
+
+static int HTTPStubsMocktailPackCompareIndexEntries(const void *lhs, const void *rhs)
+{
+    const HTTPStubsMocktailPackIndexEntry *left = lhs;
+    const HTTPStubsMocktailPackIndexEntry *right = rhs;
+    if (left->trigram != right->trigram) return (left->trigram < right->trigram) ? -1 : 1;
+    if (left->entryIndex != right->entryIndex) return (left->entryIndex < right->entryIndex) ? -1 : 1;
+    return 0;
+}
+
+static uint32_t HTTPStubsMocktailPackAppendString(NSMutableData *strings, NSString *string, uint32_t *length)
+{
+    NSData *data = [string dataUsingEncoding:NSUTF8StringEncoding];
+    uint32_t offset = (uint32_t)strings.length;
+    [strings appendData:data];
+    *length = CFSwapInt32HostToLittle((uint32_t)data.length);
+    return CFSwapInt32HostToLittle(offset);
+}
+
+// Routes requests to the entries of a memory-mapped pack, using the routing index stored in the pack.
+// Nothing is built per entry when loading the pack: an entry only becomes an HTTPStubsMocktail when a
+// request is first routed to it, and the patterns and headers are then read from the mapped tables.
+@interface HTTPStubsMocktailPackRouter : NSObject <HTTPStubsMocktailRouting>
+-(instancetype)initWithPack:(NSData *)pack packURL:(NSURL *)packURL header:(const HTTPStubsMocktailPackHeader *)header;
+@end
+
+@implementation HTTPStubsMocktailPackRouter
+{
+    NSData *_pack;
+    NSURL *_packURL;
+    uint32_t _entryCount;
+    const HTTPStubsMocktailPackEntry *_entries;
+    const HTTPStubsMocktailPackIndexEntry *_index;
+    uint64_t _stringsOffset;
+    uint64_t _stringsLength;
+    uint64_t _bodiesOffset;
+    uint64_t _bodiesLength;
+    // Entry index -> HTTPStubsMocktail, or NSNull for an invalid entry. Only accessed while synchronized on self.
+    NSMutableDictionary<NSNumber *, id> *_resolvedMocktails;
+    NSIndexSet *_unindexedEntries; // Only accessed while synchronized on self
+}
+
+-(instancetype)initWithPack:(NSData *)pack packURL:(NSURL *)packURL header:(const HTTPStubsMocktailPackHeader *)header
+{
+    self = [super init];
+    if (self)
+    {
+        _pack = pack;
+        _packURL = packURL;
+        _entryCount = CFSwapInt32LittleToHost(header->entryCount);
+        _entries = (const HTTPStubsMocktailPackEntry *)((const uint8_t *)pack.bytes + sizeof(*header));
+        _index = (const HTTPStubsMocktailPackIndexEntry *)((const uint8_t *)pack.bytes + CFSwapInt64LittleToHost(header->indexOffset));
+        _stringsOffset = CFSwapInt64LittleToHost(header->stringsOffset);
+        _stringsLength = CFSwapInt64LittleToHost(header->stringsLength);
+        _bodiesOffset = CFSwapInt64LittleToHost(header->bodiesOffset);
+        _bodiesLength = CFSwapInt64LittleToHost(header->bodiesLength);
+        _resolvedMocktails = [NSMutableDictionary new];
+    }
+    return self;
+}
+
+-(HTTPStubsMocktailPackIndexEntry)indexEntryAtPosition:(uint32_t)position
+{
+    HTTPStubsMocktailPackIndexEntry indexEntry;
+    memcpy(&indexEntry, _index + position, sizeof(indexEntry));
+    indexEntry.trigram = CFSwapInt32LittleToHost(indexEntry.trigram);
+    indexEntry.entryIndex = CFSwapInt32LittleToHost(indexEntry.entryIndex);
+    return indexEntry;
+}
+
+// Adds the entries indexed by the given trigram, found by binary search in the mapped index
+-(void)addEntriesWithTrigram:(uint32_t)trigram toIndexSet:(NSMutableIndexSet *)entries
+{
+    uint32_t lower = 0;
+    uint32_t upper = _entryCount;
+    while (lower < upper)
+    {
+        uint32_t middle = lower + (upper - lower) / 2;
+        if ([self indexEntryAtPosition:middle].trigram < trigram)
+        {
+            lower = middle + 1;
+        }
+        else
+        {
+            upper = middle;
+        }
+    }
+    for (uint32_t position = lower; position < _entryCount; position++)
+    {
+        HTTPStubsMocktailPackIndexEntry indexEntry = [self indexEntryAtPosition:position];
+        if (indexEntry.trigram != trigram) break;
+        if (indexEntry.entryIndex < _entryCount)
+        {
+            [entries addIndex:indexEntry.entryIndex];
+        }
+    }
+}
+
+-(HTTPStubsMocktail *)mocktailForRequest:(NSURLRequest *)request
+{
+    NSMutableIndexSet *candidates = [NSMutableIndexSet new];
+    @synchronized(self)
+    {
+        if (!_unindexedEntries)
+        {
+            NSMutableIndexSet *unindexedEntries = [NSMutableIndexSet new];
+            [self addEntriesWithTrigram:kUnindexedTrigram toIndexSet:unindexedEntries];
+            _unindexedEntries = [unindexedEntries copy];
+        }
+        [candidates addIndexes:_unindexedEntries];
+    }
+    NSData *url = HTTPStubsMocktailTrigramBytes(request);
+    const uint8_t *urlBytes = url.bytes;
+    for (NSUInteger offset = 0; offset + kTrigramLength <= url.length; offset++)
+    {
+        [self addEntriesWithTrigram:HTTPStubsMocktailTrigram(urlBytes + offset) toIndexSet:candidates];
+    }
+
+    __block HTTPStubsMocktail *match = nil;
+    [candidates enumerateIndexesWithOptions:NSEnumerationReverse usingBlock:^(NSUInteger idx, BOOL *stop) {
+        HTTPStubsMocktail *mocktail = [self mocktailAtIndex:(uint32_t)idx];
+        if ([mocktail matchesRequest:request])
+        {
+            match = mocktail;
+            *stop = YES;
+        }
+    }];
+    return match;
+}
+
+-(nullable HTTPStubsMocktail *)mocktailAtIndex:(uint32_t)idx
+{
+    @synchronized(self)
+    {
+        id resolvedMocktail = _resolvedMocktails[@(idx)];
+        if (!resolvedMocktail)
+        {
+            resolvedMocktail = [self parseMocktailAtIndex:idx] ?: [NSNull null];
+            _resolvedMocktails[@(idx)] = resolvedMocktail;
+        }
+        return [resolvedMocktail isKindOfClass:HTTPStubsMocktail.class] ? resolvedMocktail : nil;
+    }
+}
+
+-(nullable HTTPStubsMocktail *)parseMocktailAtIndex:(uint32_t)idx
+{
+    HTTPStubsMocktailPackEntry entry;
+    memcpy(&entry, _entries + idx, sizeof(entry));
+    uint32_t methodPatternOffset = CFSwapInt32LittleToHost(entry.methodPatternOffset);
+    uint32_t methodPatternLength = CFSwapInt32LittleToHost(entry.methodPatternLength);
+    uint32_t absoluteURLPatternOffset = CFSwapInt32LittleToHost(entry.absoluteURLPatternOffset);
+    uint32_t absoluteURLPatternLength = CFSwapInt32LittleToHost(entry.absoluteURLPatternLength);
+    uint32_t headersOffset = CFSwapInt32LittleToHost(entry.headersOffset);
+    uint32_t headersLength = CFSwapInt32LittleToHost(entry.headersLength);
+    uint64_t bodyOffset = CFSwapInt64LittleToHost(entry.bodyOffset);
+    uint64_t bodyLength = CFSwapInt64LittleToHost(entry.bodyLength);
+    if ((uint64_t)methodPatternOffset + methodPatternLength > _stringsLength
+        || (uint64_t)absoluteURLPatternOffset + absoluteURLPatternLength > _stringsLength
+        || (uint64_t)headersOffset + headersLength > _stringsLength
+        || bodyOffset + bodyLength > _bodiesLength)
+    {
+        NSLog(@"OHHTTPStubs: entry %u of Mocktail pack '%@' is out of bounds, skipping it", idx, _packURL.absoluteString);
+        return nil;
+    }
+
+    HTTPStubsMocktail *mocktail = [HTTPStubsMocktail new];
+    // The regular expressions are only compiled when a request first gets tested against the entry
+    mocktail.methodPattern = HTTPStubsMocktailPackString(_pack, _stringsOffset, methodPatternOffset, methodPatternLength);
+    mocktail.absoluteURLPattern = HTTPStubsMocktailPackString(_pack, _stringsOffset, absoluteURLPatternOffset, absoluteURLPatternLength);
+    if (!mocktail.methodPattern || !mocktail.absoluteURLPattern)
+    {
+        NSLog(@"OHHTTPStubs: entry %u of Mocktail pack '%@' has invalid patterns, skipping it", idx, _packURL.absoluteString);
+        return nil;
+    }
+    mocktail.statusCode = (int32_t)CFSwapInt32LittleToHost((uint32_t)entry.statusCode);
+    NSMutableDictionary *headers = [NSMutableDictionary new];
+    for (NSString *line in [HTTPStubsMocktailPackString(_pack, _stringsOffset, headersOffset, headersLength) componentsSeparatedByString:@"\n"])
+    {
+        NSRange separator = [line rangeOfString:@": "];
+        if (separator.location != NSNotFound)
+        {
+            headers[[line substringToIndex:separator.location]] = [line substringFromIndex:NSMaxRange(separator)];
+        }
+    }
+    mocktail.headers = headers;
+    mocktail.body = HTTPStubsMocktailPackSlice(_pack, _bodiesOffset + bodyOffset, bodyLength);
+    return mocktail;
+}
+
+@end
+
+static NSTimeInterval const kWatchedFolderPollingInterval = 1.0;
+
+// The state of a file of a watched folder when it was last parsed
+@interface HTTPStubsMocktailWatchedFile : NSObject
+@property(nonatomic, strong) NSDate *modificationDate;
+@property(nonatomic, strong) NSNumber *fileSize;
+@property(nonatomic, strong, nullable) HTTPStubsMocktail *mocktail; // nil if the file is invalid
+@end
+
+@implementation HTTPStubsMocktailWatchedFile
+@end
+
+// Keeps the router of a folder up to date with its Mocktail files.
+// Changes are detected by watching the folder itself (files added, removed or replaced) and by polling
+// the modification date and size of the files (files edited in place). Only the changed files are parsed
+// again, then the router is replaced as a whole, so that requests always see a complete set of stubs.
+@interface HTTPStubsMocktailFolderWatcher : NSObject
+@property(atomic, strong, readonly) HTTPStubsMocktailRouter *router;
+-(instancetype)initWithFolderURL:(NSURL *)folderURL;
+@end
+
+@interface HTTPStubsMocktailFolderWatcher ()
+// Replaced on the watcher queue while the stub reads it from the loading threads, hence atomic
+@property(atomic, strong, readwrite) HTTPStubsMocktailRouter *router;
+@end
+
+@implementation HTTPStubsMocktailFolderWatcher
+{
+    NSURL *_folderURL;
+    dispatch_queue_t _queue;
+    dispatch_source_t _folderSource;
+    dispatch_source_t _pollingTimer;
+    NSDictionary<NSString *, HTTPStubsMocktailWatchedFile *> *_files;
+}
+
+-(instancetype)initWithFolderURL:(NSURL *)folderURL
+{
+    self = [super init];
+    if (self)
+    {
+        _folderURL = folderURL;
+        _queue = dispatch_queue_create("com.alisoftware.OHHTTPStubs.mocktail-watcher", DISPATCH_QUEUE_SERIAL);
+        _files = @{};
+        dispatch_sync(_queue, ^{
+            [self reload];
+        });
+
+        __weak __typeof__(self) weakSelf = self;
+        int fd = open(folderURL.path.fileSystemRepresentation, O_EVTONLY);
+        if (fd >= 0)
+        {
+            _folderSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_VNODE, (uintptr_t)fd, DISPATCH_VNODE_WRITE | DISPATCH_VNODE_LINK, _queue);
+            dispatch_source_set_event_handler(_folderSource, ^{
+                [weakSelf reload];
+            });
+            dispatch_source_set_cancel_handler(_folderSource, ^{
+                close(fd);
+            });
+            dispatch_resume(_folderSource);
+        }
+
+        _pollingTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _queue);
+        uint64_t interval = (uint64_t)(kWatchedFolderPollingInterval * NSEC_PER_SEC);
+        dispatch_source_set_timer(_pollingTimer, dispatch_time(DISPATCH_TIME_NOW, (int64_t)interval), interval, interval / 4);
+        dispatch_source_set_event_handler(_pollingTimer, ^{
+            [weakSelf reload];
+        });
+        dispatch_resume(_pollingTimer);
+    }
+    return self;
+}
+
+-(void)dealloc
+{
+    if (_folderSource)
+    {
+        dispatch_source_cancel(_folderSource);
+    }
+    dispatch_source_cancel(_pollingTimer);
+}
+
+// Must be called on _queue
+-(void)reload
+{
+    NSArray<NSURLResourceKey> *keys = @[NSURLContentModificationDateKey, NSURLFileSizeKey];
+    NSArray<NSURL *> *fileURLs = [NSFileManager.defaultManager contentsOfDirectoryAtURL:_folderURL includingPropertiesForKeys:keys options:0 error:NULL];
+    // Sorted, so that the Mocktail winning when several match a request doesn't change from one reload to the other
+    fileURLs = [fileURLs sortedArrayUsingComparator:^NSComparisonResult(NSURL *lhs, NSURL *rhs) {
+        return [lhs.lastPathComponent compare:rhs.lastPathComponent];
+    }];
+
+    BOOL changed = NO;
+    NSMutableDictionary<NSString *, HTTPStubsMocktailWatchedFile *> *files = [NSMutableDictionary new];
+    NSMutableArray<HTTPStubsMocktail *> *mocktails = [NSMutableArray new];
+    for (NSURL *fileURL in fileURLs)
+    {
+        if (![fileURL.absoluteString hasSuffix:@".tail"])
+        {
+            continue;
+        }
+        // Cached resource values would hide the changes since the last reload
+        [fileURL removeAllCachedResourceValues];
+        NSDictionary *values = [fileURL resourceValuesForKeys:keys error:NULL];
+        HTTPStubsMocktailWatchedFile *file = _files[fileURL.path];
+        if (!file || ![file.modificationDate isEqual:values[NSURLContentModificationDateKey]] || ![file.fileSize isEqual:values[NSURLFileSizeKey]])
+        {
+            file = [HTTPStubsMocktailWatchedFile new];
+            file.modificationDate = values[NSURLContentModificationDateKey];
+            file.fileSize = values[NSURLFileSizeKey];
+            file.mocktail = [HTTPStubs mocktailWithContentsOfURL:fileURL error:NULL];
+            changed = YES;
+        }
+        files[fileURL.path] = file;
+        if (file.mocktail)
+        {
+            [mocktails addObject:(HTTPStubsMocktail *)file.mocktail];
+        }
+    }
+    changed = changed || (files.count != _files.count);
+
+    if (changed || !self.router)
+    {
+        _files = [files copy];
+        // Swapped at once, so that there is no window where some of the stubs are missing
+        self.router = [[HTTPStubsMocktailRouter alloc] initWithMocktails:mocktails];
+    }
+}
+
+@end
 
 @implementation HTTPStubs (Mocktail)
 
@@ -58,6 +1056,269 @@ NSString* const MocktailErrorDomain = @"Mocktail";
         return nil;
     }
 
+    NSArray<HTTPStubsMocktail *> *mocktails = [self mocktailsInFolderAtURL:dirURL error:error];
+    if (!mocktails)
+    {
+        return nil;
+    }
+
+    // An empty folder stubs nothing
+    return mocktails.count > 0 ? @[[self stubRequestsRoutingToMocktails:mocktails name:path]] : @[];
+}
+
++(id<HTTPStubsDescriptor>)stubRequestsUsingMocktailNamed:(NSString *)fileName inBundle:(nullable NSBundle*)bundleOrNil error:(NSError **)error
+{
+    NSURL *responseURL = [bundleOrNil?:[NSBundle bundleForClass:self.class] URLForResource:fileName withExtension:@"tail"];
+
+    if (!responseURL)
+    {
+        if (error)
+        {
+            *error = [NSError errorWithDomain:MocktailErrorDomain code:OHHTTPStubsMocktailErrorPathDoesNotExist userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"File '%@' does not exist.", fileName]}];
+        }
+        return nil;
+    }
+    else
+    {
+        return [[self class] stubRequestsUsingMocktail:responseURL error:error];
+    }
+}
+
++(id<HTTPStubsDescriptor>)stubRequestsUsingMocktail:(NSURL *)fileURL error:(NSError **)error
+{
+    HTTPStubsMocktail *mocktail = [self mocktailWithContentsOfURL:fileURL error:error];
+    if (!mocktail)
+    {
+        return nil;
+    }
+
+    return [HTTPStubs stubRequestsPassingTest:[self testBlockForMocktail:mocktail]
+                             withStubResponse:[self responseBlockForMocktail:mocktail]];
+}
+
++(id<HTTPStubsDescriptor>)stubRequestsUsingMocktailsWatchingFolderAtURL:(NSURL *)folderURL error:(NSError **)error
+{
+    // Make sure the URL points to a directory
+    NSNumber *isDirectory;
+    BOOL success = [folderURL getResourceValue:&isDirectory forKey:NSURLIsDirectoryKey error:nil];
+    BOOL isDir = (success && [isDirectory boolValue]);
+
+    if (!isDir)
+    {
+        if (error)
+        {
+            *error = [NSError errorWithDomain:MocktailErrorDomain code:OHHTTPStubsMocktailErrorPathIsNotFolder userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Path '%@' is not a folder.", folderURL.path]}];
+        }
+        return nil;
+    }
+
+    // The watcher lives as long as the stub, and stops watching the folder once the stub is removed
+    HTTPStubsMocktailFolderWatcher *watcher = [[HTTPStubsMocktailFolderWatcher alloc] initWithFolderURL:folderURL];
+    // The response uses the Mocktail found by the test, so a reload in between can't turn a match into a 404
+    id<HTTPStubsDescriptor> descriptor = [self stubRequestsUsingRouter:^id<HTTPStubsMocktailRouting>{
+        return watcher.router;
+    }];
+    descriptor.name = folderURL.lastPathComponent;
+
+    return descriptor;
+}
+
++(id<HTTPStubsDescriptor>)stubRequestsUsingMocktailsRecursivelyAtURL:(NSURL *)folderURL error:(NSError **)error
+{
+    // Make sure the URL points to a directory
+    NSNumber *isDirectory;
+    BOOL success = [folderURL getResourceValue:&isDirectory forKey:NSURLIsDirectoryKey error:nil];
+    BOOL isDir = (success && [isDirectory boolValue]);
+
+    if (!isDir)
+    {
+        if (error)
+        {
+            *error = [NSError errorWithDomain:MocktailErrorDomain code:OHHTTPStubsMocktailErrorPathIsNotFolder userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Path '%@' is not a folder.", folderURL.path]}];
+        }
+        return nil;
+    }
+
+    NSArray<HTTPStubsMocktail *> *mocktails;
+    NSURL *manifestURL = [folderURL URLByAppendingPathComponent:MocktailManifestFileName];
+    if ([manifestURL checkResourceIsReachableAndReturnError:NULL])
+    {
+        mocktails = [self deferredMocktailsWithManifestAtURL:manifestURL error:error];
+    }
+    else
+    {
+        NSMutableArray<NSURL *> *tailURLs = [NSMutableArray new];
+        NSDirectoryEnumerator<NSURL *> *enumerator = [NSFileManager.defaultManager enumeratorAtURL:folderURL includingPropertiesForKeys:nil options:0 errorHandler:nil];
+        for (NSURL *fileURL in enumerator)
+        {
+            if ([fileURL.absoluteString hasSuffix:@".tail"])
+            {
+                [tailURLs addObject:fileURL];
+            }
+        }
+        // Sorted, as the enumeration order isn't specified and the last matching Mocktail wins
+        [tailURLs sortUsingComparator:^NSComparisonResult(NSURL *lhs, NSURL *rhs) {
+            return [lhs.path compare:rhs.path];
+        }];
+        mocktails = [self mocktailsWithContentsOfURLs:tailURLs];
+    }
+
+    // Always a valid stub, even if there is no Mocktail in the folder (it then never matches)
+    return mocktails ? [self stubRequestsRoutingToMocktails:mocktails name:folderURL.lastPathComponent] : nil;
+}
+
++(id<HTTPStubsDescriptor>)stubRequestsUsingMocktailPackNamed:(NSString *)fileName inBundle:(nullable NSBundle*)bundleOrNil error:(NSError **)error
+{
+    NSURL *packURL = [bundleOrNil?:[NSBundle bundleForClass:self.class] URLForResource:fileName withExtension:@"mocktailpack"];
+
+    if (!packURL)
+    {
+        if (error)
+        {
+            *error = [NSError errorWithDomain:MocktailErrorDomain code:OHHTTPStubsMocktailErrorPathDoesNotExist userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"File '%@' does not exist.", fileName]}];
+        }
+        return nil;
+    }
+    return [self stubRequestsUsingMocktailPack:packURL error:error];
+}
+
++(id<HTTPStubsDescriptor>)stubRequestsUsingMocktailPack:(NSURL *)packURL error:(NSError **)error
+{
+    NSError *bError = nil;
+    // Mapped, so that opening the pack costs the same whatever its size, and bodies are only paged in when sent.
+    // Truncating the file while it is mapped would make the next access to a missing page raise SIGBUS, hence
+    // the pack being documented as replace-only, and always written atomically.
+    NSData *pack = [NSData dataWithContentsOfURL:packURL options:NSDataReadingMappedAlways error:&bError];
+    if (!pack)
+    {
+        if (error)
+        {
+            *error = [NSError errorWithDomain:MocktailErrorDomain code:OHHTTPStubsMocktailErrorPathFailedToRead userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"File '%@' does not read.", packURL.absoluteString]}];
+        }
+        return nil;
+    }
+
+    HTTPStubsMocktailPackHeader header;
+    if (pack.length < sizeof(header))
+    {
+        if (error) *error = HTTPStubsMocktailPackError(packURL, @"file too short");
+        return nil;
+    }
+    memcpy(&header, pack.bytes, sizeof(header));
+    uint32_t entryCount = CFSwapInt32LittleToHost(header.entryCount);
+    uint64_t indexOffset = CFSwapInt64LittleToHost(header.indexOffset);
+    uint64_t stringsOffset = CFSwapInt64LittleToHost(header.stringsOffset);
+    uint64_t stringsLength = CFSwapInt64LittleToHost(header.stringsLength);
+    uint64_t bodiesOffset = CFSwapInt64LittleToHost(header.bodiesOffset);
+    uint64_t bodiesLength = CFSwapInt64LittleToHost(header.bodiesLength);
+    if (memcmp(header.magic, kMocktailPackMagic, sizeof(kMocktailPackMagic)) != 0 || CFSwapInt32LittleToHost(header.version) != kMocktailPackVersion)
+    {
+        if (error) *error = HTTPStubsMocktailPackError(packURL, @"unsupported format or version");
+        return nil;
+    }
+    // Only the sections are checked here, so that loading doesn't depend on the number of entries.
+    // Each entry is checked when a request is first routed to it.
+    if (sizeof(header) + (uint64_t)entryCount * sizeof(HTTPStubsMocktailPackEntry) > indexOffset
+        || indexOffset + (uint64_t)entryCount * sizeof(HTTPStubsMocktailPackIndexEntry) > stringsOffset
+        || stringsOffset + stringsLength > bodiesOffset || bodiesOffset + bodiesLength > pack.length)
+    {
+        if (error) *error = HTTPStubsMocktailPackError(packURL, @"sections out of bounds");
+        return nil;
+    }
+
+    // Always a valid stub, even for a pack without entries (it then never matches)
+    HTTPStubsMocktailPackRouter *router = [[HTTPStubsMocktailPackRouter alloc] initWithPack:pack packURL:packURL header:&header];
+    id<HTTPStubsDescriptor> descriptor = [self stubRequestsUsingRouter:^id<HTTPStubsMocktailRouting>{
+        return router;
+    }];
+    descriptor.name = packURL.lastPathComponent;
+    return descriptor;
+}
+
++(BOOL)writeMocktailPackWithMocktailsAtURL:(NSURL *)folderURL toURL:(NSURL *)packURL error:(NSError **)error
+{
+    NSArray<HTTPStubsMocktail *> *mocktails = [self mocktailsInFolderAtURL:folderURL error:error];
+    if (!mocktails)
+    {
+        return NO;
+    }
+
+    NSMutableData *entries = [NSMutableData dataWithCapacity:mocktails.count * sizeof(HTTPStubsMocktailPackEntry)];
+    NSMutableData *index = [NSMutableData dataWithLength:mocktails.count * sizeof(HTTPStubsMocktailPackIndexEntry)];
+    NSMutableData *strings = [NSMutableData new];
+    NSMutableData *bodies = [NSMutableData new];
+    for (HTTPStubsMocktail *mocktail in mocktails)
+    {
+        HTTPStubsMocktailPackEntry entry = { 0 };
+        entry.methodPatternOffset = HTTPStubsMocktailPackAppendString(strings, mocktail.methodPattern, &entry.methodPatternLength);
+        entry.absoluteURLPatternOffset = HTTPStubsMocktailPackAppendString(strings, mocktail.absoluteURLPattern, &entry.absoluteURLPatternLength);
+        NSMutableString *headerLines = [NSMutableString new];
+        for (NSString *name in [mocktail.headers.allKeys sortedArrayUsingSelector:@selector(compare:)])
+        {
+            [headerLines appendFormat:@"%@: %@\n", name, mocktail.headers[name]];
+        }
+        entry.headersOffset = HTTPStubsMocktailPackAppendString(strings, headerLines, &entry.headersLength);
+        entry.statusCode = (int32_t)CFSwapInt32HostToLittle((uint32_t)mocktail.statusCode);
+
+        // Bodies are stored decoded, ready to be sent
+        NSData *body = mocktail.base64Body.data;
+        if (!body)
+        {
+            NSData *fileData = [NSData dataWithContentsOfURL:mocktail.fileURL options:NSDataReadingMappedIfSafe error:NULL];
+            body = (fileData.length > mocktail.bodyOffset) ? [fileData subdataWithRange:NSMakeRange(mocktail.bodyOffset, fileData.length - mocktail.bodyOffset)] : [NSData data];
+        }
+        entry.bodyOffset = CFSwapInt64HostToLittle(bodies.length);
+        entry.bodyLength = CFSwapInt64HostToLittle(body.length);
+        [bodies appendData:body];
+        [entries appendBytes:&entry length:sizeof(entry)];
+    }
+
+    // The routing index, sorted by trigram then by entry, so that the loader can binary search it in place
+    NSArray<NSNumber *> *indexTrigrams = HTTPStubsMocktailIndexTrigrams([mocktails valueForKey:@"absoluteURLPattern"]);
+    HTTPStubsMocktailPackIndexEntry *indexEntries = index.mutableBytes;
+    for (NSUInteger idx = 0; idx < mocktails.count; ++idx)
+    {
+        indexEntries[idx].trigram = indexTrigrams[idx].unsignedIntValue;
+        indexEntries[idx].entryIndex = (uint32_t)idx;
+    }
+    qsort(indexEntries, mocktails.count, sizeof(HTTPStubsMocktailPackIndexEntry), HTTPStubsMocktailPackCompareIndexEntries);
+    for (NSUInteger idx = 0; idx < mocktails.count; ++idx)
+    {
+        indexEntries[idx].trigram = CFSwapInt32HostToLittle(indexEntries[idx].trigram);
+        indexEntries[idx].entryIndex = CFSwapInt32HostToLittle(indexEntries[idx].entryIndex);
+    }
+
+    HTTPStubsMocktailPackHeader header = { { 0 } };
+    memcpy(header.magic, kMocktailPackMagic, sizeof(kMocktailPackMagic));
+    header.version = CFSwapInt32HostToLittle(kMocktailPackVersion);
+    header.entryCount = CFSwapInt32HostToLittle((uint32_t)mocktails.count);
+    uint64_t indexOffset = sizeof(header) + entries.length;
+    header.indexOffset = CFSwapInt64HostToLittle(indexOffset);
+    uint64_t stringsOffset = indexOffset + index.length;
+    header.stringsOffset = CFSwapInt64HostToLittle(stringsOffset);
+    header.stringsLength = CFSwapInt64HostToLittle(strings.length);
+    header.bodiesOffset = CFSwapInt64HostToLittle(stringsOffset + strings.length);
+    header.bodiesLength = CFSwapInt64HostToLittle(bodies.length);
+
+    NSMutableData *pack = [NSMutableData dataWithBytes:&header length:sizeof(header)];
+    [pack appendData:entries];
+    [pack appendData:index];
+    [pack appendData:strings];
+    [pack appendData:bodies];
+    return [pack writeToURL:packURL options:NSDataWritingAtomic error:error];
+}
+
+#pragma mark - Private
+
+// The response to use if the folder changed between the test and the response of a stub
++(HTTPStubsResponse *)responseForRemovedMocktail
+{
+    return [HTTPStubsResponse responseWithData:[NSData data] statusCode:404 headers:nil];
+}
+
+// Reads and parses the Mocktail files of a folder, in parallel. Invalid files are skipped.
++(nullable NSArray<HTTPStubsMocktail *> *)mocktailsInFolderAtURL:(NSURL *)dirURL error:(NSError **)error
+{
     // Read the content of the directory
     NSError *bError = nil;
     NSFileManager *fileManager = [NSFileManager defaultManager];
@@ -72,49 +1333,170 @@ NSString* const MocktailErrorDomain = @"Mocktail";
         return nil;
     }
 
-    //stub the Mocktail-formatted requests
-    NSMutableArray *descriptorArray = [[NSMutableArray alloc] initWithCapacity:fileURLs.count];
+    NSMutableArray<NSURL *> *tailURLs = [[NSMutableArray alloc] initWithCapacity:fileURLs.count];
     for (NSURL *fileURL in fileURLs)
     {
-        if (![fileURL.absoluteString hasSuffix:@".tail"])
+        if ([fileURL.absoluteString hasSuffix:@".tail"])
         {
-            continue;
+            [tailURLs addObject:fileURL];
         }
-        id<HTTPStubsDescriptor> descriptor = [[self class] stubRequestsUsingMocktail:fileURL error: &bError];
-        if (descriptor && !bError)
+    }
+
+    return [self mocktailsWithContentsOfURLs:tailURLs];
+}
+
+// Reads and parses Mocktail files in parallel, keeping their order. Invalid files are skipped.
++(NSArray<HTTPStubsMocktail *> *)mocktailsWithContentsOfURLs:(NSArray<NSURL *> *)tailURLs
+{
+    NSMutableArray *parsedMocktails = [[NSMutableArray alloc] initWithCapacity:tailURLs.count];
+    for (NSUInteger idx = 0; idx < tailURLs.count; ++idx)
+    {
+        [parsedMocktails addObject:[NSNull null]];
+    }
+    dispatch_apply(tailURLs.count, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t idx) {
+        HTTPStubsMocktail *mocktail = [self mocktailWithContentsOfURL:tailURLs[idx] error:NULL];
+        if (mocktail)
         {
-            [descriptorArray addObject:descriptor];
+            @synchronized(parsedMocktails)
+            {
+                parsedMocktails[idx] = mocktail;
+            }
         }
-    }
+    });
+    [parsedMocktails removeObjectIdenticalTo:[NSNull null]];
 
-    return descriptorArray;
+    return parsedMocktails;
 }
 
-+(id<HTTPStubsDescriptor>)stubRequestsUsingMocktailNamed:(NSString *)fileName inBundle:(nullable NSBundle*)bundleOrNil error:(NSError **)error
+// Reads a folder manifest, returning Mocktails which only know their patterns, in the order of the manifest
++(nullable NSArray<HTTPStubsMocktail *> *)deferredMocktailsWithManifestAtURL:(NSURL *)manifestURL error:(NSError **)error
 {
-    NSURL *responseURL = [bundleOrNil?:[NSBundle bundleForClass:self.class] URLForResource:fileName withExtension:@"tail"];
+    NSData *manifestData = [NSData dataWithContentsOfURL:manifestURL];
+    if (!manifestData)
+    {
+        if (error)
+        {
+            *error = [NSError errorWithDomain:MocktailErrorDomain code:OHHTTPStubsMocktailErrorPathFailedToRead userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"File '%@' does not read.", manifestURL.absoluteString]}];
+        }
+        return nil;
+    }
 
-    if (!responseURL)
+    NSURL *folderURL = manifestURL.URLByDeletingLastPathComponent;
+    id entries = [NSJSONSerialization JSONObjectWithData:manifestData options:0 error:NULL];
+    if (![entries isKindOfClass:NSArray.class])
     {
         if (error)
         {
-            *error = [NSError errorWithDomain:MocktailErrorDomain code:OHHTTPStubsMocktailErrorPathDoesNotExist userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"File '%@' does not exist.", fileName]}];
+            *error = [NSError errorWithDomain:MocktailErrorDomain code:OHHTTPStubsMocktailErrorInvalidManifest userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Manifest '%@' is not a JSON array.", manifestURL.absoluteString]}];
         }
         return nil;
     }
-    else
+
+    NSMutableArray<HTTPStubsMocktail *> *mocktails = [NSMutableArray new];
+    for (id entry in entries)
     {
-        return [[self class] stubRequestsUsingMocktail:responseURL error:error];
+        NSString *method = [entry isKindOfClass:NSDictionary.class] ? entry[@"method"] : nil;
+        NSString *url = [entry isKindOfClass:NSDictionary.class] ? entry[@"url"] : nil;
+        NSString *file = [entry isKindOfClass:NSDictionary.class] ? entry[@"file"] : nil;
+        // Patterns are compiled right away, so that an invalid one is reported now rather than silently never matching
+        NSRegularExpression *methodRegex = [method isKindOfClass:NSString.class] ? [NSRegularExpression regularExpressionWithPattern:method options:NSRegularExpressionCaseInsensitive error:NULL] : nil;
+        NSRegularExpression *absoluteURLRegex = [url isKindOfClass:NSString.class] ? [NSRegularExpression regularExpressionWithPattern:url options:NSRegularExpressionCaseInsensitive error:NULL] : nil;
+        if (!methodRegex || !absoluteURLRegex || ![file isKindOfClass:NSString.class])
+        {
+            if (error)
+            {
+                *error = [NSError errorWithDomain:MocktailErrorDomain code:OHHTTPStubsMocktailErrorInvalidManifest userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Manifest '%@' has invalid entry: %@.", manifestURL.absoluteString, entry]}];
+            }
+            return nil;
+        }
+
+        HTTPStubsMocktail *mocktail = [HTTPStubsMocktail new];
+        mocktail.fileURL = [folderURL URLByAppendingPathComponent:file];
+        mocktail.methodPattern = method;
+        mocktail.absoluteURLPattern = url;
+        mocktail.methodRegex = methodRegex;
+        mocktail.absoluteURLRegex = absoluteURLRegex;
+        mocktail.deferred = YES;
+        [mocktails addObject:mocktail];
     }
+    return mocktails;
 }
 
-+(id<HTTPStubsDescriptor>)stubRequestsUsingMocktail:(NSURL *)fileURL error:(NSError **)error
+// Adds a single stub routing each request to its Mocktail. Without any Mocktail, the stub never matches.
++(id<HTTPStubsDescriptor>)stubRequestsRoutingToMocktails:(NSArray<HTTPStubsMocktail *> *)mocktails name:(NSString *)name
+{
+    HTTPStubsMocktailRouter *router = [[HTTPStubsMocktailRouter alloc] initWithMocktails:mocktails];
+    id<HTTPStubsDescriptor> descriptor = [self stubRequestsUsingRouter:^id<HTTPStubsMocktailRouting>{
+        return router;
+    }];
+    descriptor.name = name;
+
+    return descriptor;
+}
+
+// Adds a stub routing requests with the router returned by the block. The Mocktail found by the test block is
+// remembered for the response block, so that each request is only routed once, by the router it was tested with.
++(id<HTTPStubsDescriptor>)stubRequestsUsingRouter:(id<HTTPStubsMocktailRouting> (^)(void))routerBlock
+{
+    // Routing only depends on the method and URL of the request. Entries are overwritten by each test,
+    // so a response always gets the result of the latest test of the same request.
+    NSCache<NSString *, id> *matches = [NSCache new];
+    matches.countLimit = 256;
+    NSString *(^keyForRequest)(NSURLRequest *) = ^NSString *(NSURLRequest *request) {
+        return [NSString stringWithFormat:@"%@ %@", request.HTTPMethod, request.URL.absoluteString];
+    };
+
+    return [HTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        HTTPStubsMocktail *mocktail = [routerBlock() mocktailForRequest:request];
+        [matches setObject:mocktail ?: [NSNull null] forKey:keyForRequest(request)];
+        return mocktail != nil;
+    } withStubResponse:^HTTPStubsResponse*(NSURLRequest *request) {
+        id match = [matches objectForKey:keyForRequest(request)];
+        HTTPStubsMocktail *mocktail = [match isKindOfClass:HTTPStubsMocktail.class] ? match : [routerBlock() mocktailForRequest:request];
+        return [mocktail response] ?: [self responseForRemovedMocktail];
+    }];
+}
+
++(HTTPStubsTestBlock)testBlockForMocktail:(HTTPStubsMocktail *)mocktail
+{
+    return ^BOOL(NSURLRequest *request) {
+        return [mocktail matchesRequest:request];
+    };
+}
+
++(HTTPStubsResponseBlock)responseBlockForMocktail:(HTTPStubsMocktail *)mocktail
+{
+    return ^HTTPStubsResponse*(NSURLRequest *request) {
+        return [mocktail response];
+    };
+}
+
++(nullable HTTPStubsMocktail *)mocktailWithContentsOfURL:(NSURL *)fileURL error:(NSError **)error
 {
+    // The header regular expressions are the same for every file, so only compile them once
+    static NSRegularExpression *headerPattern;
+    static NSRegularExpression *bareContentTypePattern;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        // From line 4 to '\n\n', expect HTTP response headers.
+        headerPattern = [NSRegularExpression regularExpressionWithPattern:@"^([^:]+):\\s+(.*)" options:0 error:NULL];
+        // Allow bare Content-Type header on line 4 before named HTTP response headers
+        bareContentTypePattern = [NSRegularExpression regularExpressionWithPattern:@"^([^:]+)$" options:0 error:NULL];
+    });
+    if (!headerPattern || !bareContentTypePattern)
+    {
+        if (error)
+        {
+            *error = [NSError errorWithDomain:MocktailErrorDomain code:OHHTTPStubsMocktailErrorInternalError userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Internal error while stubbing file '%@'.", fileURL.absoluteString]}];
+        }
+        return nil;
+    }
+
     NSError *bError = nil;
-    NSStringEncoding originalEncoding;
-    NSString *contentsOfFile = [NSString stringWithContentsOfURL:fileURL usedEncoding:&originalEncoding error:&bError];
+    NSUInteger bodyOffset = 0;
+    NSString *headerMatter = HTTPStubsMocktailReadHeader(fileURL, &bodyOffset);
 
-    if (!contentsOfFile || bError)
+    if (!headerMatter)
     {
         if (error)
         {
@@ -123,9 +1505,6 @@ NSString* const MocktailErrorDomain = @"Mocktail";
         return nil;
     }
 
-    NSScanner *scanner = [NSScanner scannerWithString:contentsOfFile];
-    NSString *headerMatter = nil;
-    [scanner scanUpToString:@"\n\n" intoString:&headerMatter];
     NSArray *lines = [headerMatter componentsSeparatedByString:@"\n"];
     if (lines.count < 4)
     {
@@ -164,29 +1543,6 @@ NSString* const MocktailErrorDomain = @"Mocktail";
 
     NSMutableDictionary *headers = @{@"Content-Type":lines[3]}.mutableCopy;
 
-    // From line 4 to '\n\n', expect HTTP response headers.
-    NSRegularExpression *headerPattern = [NSRegularExpression regularExpressionWithPattern:@"^([^:]+):\\s+(.*)" options:0 error:&bError];
-    if (bError)
-    {
-        if (error)
-        {
-            *error = [NSError errorWithDomain:MocktailErrorDomain code:OHHTTPStubsMocktailErrorInternalError userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Internal error while stubbing file '%@'.", fileURL.absoluteString]}];
-        }
-        return nil;
-    }
-
-
-    // Allow bare Content-Type header on line 4 before named HTTP response headers
-    NSRegularExpression *bareContentTypePattern = [NSRegularExpression regularExpressionWithPattern:@"^([^:]+)+$" options:0 error:&bError];
-    if (bError)
-    {
-        if (error)
-        {
-            *error = [NSError errorWithDomain:MocktailErrorDomain code:OHHTTPStubsMocktailErrorInternalError userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Internal error while stubbing file '%@'.", fileURL.absoluteString]}];
-        }
-        return nil;
-    }
-
     for (NSUInteger line = 3; line < lines.count; line ++) {
         NSString *headerLine = lines[line];
         NSTextCheckingResult *match = [headerPattern firstMatchInString:headerLine options:0 range:NSMakeRange(0, headerLine.length)];
@@ -217,44 +1573,26 @@ NSString* const MocktailErrorDomain = @"Mocktail";
         }
     }
 
-    // Handle binary which is base64 encoded
-    NSUInteger bodyOffset = [headerMatter dataUsingEncoding:NSUTF8StringEncoding].length + 2;
-
-    return [HTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
-        NSString *absoluteURL = (request.URL).absoluteString;
-        NSString *method = request.HTTPMethod;
-
-        if ([absoluteURLRegex numberOfMatchesInString:absoluteURL options:0 range:NSMakeRange(0, absoluteURL.length)] > 0)
-        {
-            if ([methodRegex numberOfMatchesInString:method options:0 range:NSMakeRange(0, method.length)] > 0)
-            {
-                return YES;
-            }
-        }
-
-        return NO;
-    } withStubResponse:^HTTPStubsResponse*(NSURLRequest *request) {
-        if([headers[@"Content-Type"] hasSuffix:@";base64"])
-        {
-            NSString *type = headers[@"Content-Type"];
-            NSString *newType = [type substringWithRange:NSMakeRange(0, type.length - 7)];
-            headers[@"Content-Type"] = newType;
+    HTTPStubsMocktail *mocktail = [HTTPStubsMocktail new];
+    mocktail.fileURL = fileURL;
+    mocktail.methodPattern = lines[0];
+    mocktail.absoluteURLPattern = lines[1];
+    mocktail.methodRegex = methodRegex;
+    mocktail.absoluteURLRegex = absoluteURLRegex;
+    mocktail.statusCode = (int)statusCode;
 
-            NSData *body = [NSData dataWithContentsOfURL:fileURL];
-            body = [body subdataWithRange:NSMakeRange(bodyOffset, body.length - bodyOffset)];
-            body = [[NSData alloc] initWithBase64EncodedData:body options:NSDataBase64DecodingIgnoreUnknownCharacters];
+    // Handle binary which is base64 encoded
+    mocktail.bodyOffset = bodyOffset;
+    NSString *contentType = headers[@"Content-Type"];
+    if ([contentType hasSuffix:kBase64ContentTypeSuffix])
+    {
+        headers[@"Content-Type"] = [contentType substringToIndex:contentType.length - kBase64ContentTypeSuffix.length];
+        mocktail.base64Body = [[HTTPStubsMocktailBase64Body alloc] initWithFileURL:fileURL bodyOffset:mocktail.bodyOffset];
+    }
+    // Headers are frozen here, so that responses never alter what the next requests will get
+    mocktail.headers = headers;
 
-            HTTPStubsResponse *response = [HTTPStubsResponse responseWithData:body statusCode:(int)statusCode headers:headers];
-            return response;
-        }
-        else
-        {
-            HTTPStubsResponse *response = [HTTPStubsResponse responseWithFileAtPath:fileURL.path
-                                                                            statusCode:(int)statusCode headers:headers];
-            [response.inputStream setProperty:@(bodyOffset) forKey:NSStreamFileCurrentOffsetKey];
-            return response;
-        }
-    }];
+    return mocktail;
 }
 
 @end
@@ -0,0 +1,322 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#if ! __has_feature(objc_arc)
+#error This file is expected to be compiled with ARC turned ON
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Imports
+
+#import "HTTPStubsBase64.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HTTPSTUBS_BASE64_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define HTTPSTUBS_BASE64_NEON 1
+#endif
+
+#if HTTPSTUBS_BASE64_X86 && defined(__APPLE__)
+#include <sys/sysctl.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Scalar decoding
+
+static uint8_t const kSkippedCharacter = 0x80;
+static uint8_t const kPaddingCharacter = 0x81;
+
+// The 6-bit value of each base64 character, kSkippedCharacter for characters outside of the alphabet
+static uint8_t const kSextets[256] = {
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x3E, 0x80, 0x80, 0x80, 0x3F,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x80, 0x80, 0x80, 0x81, 0x80, 0x80,
+    0x80, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E,
+    0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32, 0x33, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+};
+
+// Decodes as many whole blocks of base64 characters as possible, stopping at the first block containing a
+// character outside of the alphabet. Returns the number of characters decoded, which produced 3/4 as many bytes.
+typedef size_t (*HTTPStubsBase64BlockDecoder)(const uint8_t* input, size_t length, uint8_t* output);
+
+// Returns the number of bytes written to output, or SIZE_MAX if the input ends with a truncated group of characters.
+// Output must have room for (length / 4) * 3 + 3 bytes.
+static size_t HTTPStubsBase64Decode(const uint8_t* input, size_t length, uint8_t* output, HTTPStubsBase64BlockDecoder blockDecoder)
+{
+    size_t inputIndex = 0;
+    size_t outputIndex = 0;
+    uint32_t accumulator = 0;
+    unsigned pending = 0;
+    // Once the vector decoder stopped, the scalar loop goes on up to the next skipped character (typically a line break)
+    BOOL vectorStopped = NO;
+    while (inputIndex < length)
+    {
+        // Between two groups of 4 characters, let the vector decoder go as far as it can
+        if (pending == 0 && blockDecoder && !vectorStopped)
+        {
+            size_t decoded = blockDecoder(input + inputIndex, length - inputIndex, output + outputIndex);
+            inputIndex += decoded;
+            outputIndex += decoded / 4 * 3;
+            if (inputIndex == length)
+            {
+                break;
+            }
+            vectorStopped = YES;
+        }
+
+        uint8_t sextet = kSextets[input[inputIndex++]];
+        if (sextet == kPaddingCharacter)
+        {
+            break;
+        }
+        if (sextet == kSkippedCharacter)
+        {
+            vectorStopped = NO;
+            continue;
+        }
+        accumulator = (accumulator << 6) | sextet;
+        if (++pending == 4)
+        {
+            output[outputIndex++] = (uint8_t)(accumulator >> 16);
+            output[outputIndex++] = (uint8_t)(accumulator >> 8);
+            output[outputIndex++] = (uint8_t)accumulator;
+            accumulator = 0;
+            pending = 0;
+        }
+    }
+
+    switch (pending)
+    {
+        case 1:
+            return SIZE_MAX;
+        case 2:
+            output[outputIndex++] = (uint8_t)(accumulator >> 4);
+            break;
+        case 3:
+            output[outputIndex++] = (uint8_t)(accumulator >> 10);
+            output[outputIndex++] = (uint8_t)(accumulator >> 2);
+            break;
+        default:
+            break;
+    }
+    return outputIndex;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Vector decoding
+
+// Characters are translated to their 6-bit values by range: 'A'-'Z' - 65, 'a'-'z' - 71, '0'-'9' + 4, '+' + 19, '/' + 16.
+// Each group of 4 values (00aaaaaa 00bbbbbb 00cccccc 00dddddd) is then packed into aaaaaabb bbbbcccc ccdddddd.
+
+#if HTTPSTUBS_BASE64_X86
+
+__attribute__((target("ssse3")))
+static size_t HTTPStubsBase64DecodeBlocksSSSE3(const uint8_t* input, size_t length, uint8_t* output)
+{
+    size_t consumed = 0;
+    while (length - consumed >= 16)
+    {
+        __m128i chars = _mm_loadu_si128((const __m128i*)(input + consumed));
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(chars, _mm_set1_epi8('Z' + 1)));
+        __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(chars, _mm_set1_epi8('z' + 1)));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+        __m128i plus = _mm_cmpeq_epi8(chars, _mm_set1_epi8('+'));
+        __m128i slash = _mm_cmpeq_epi8(chars, _mm_set1_epi8('/'));
+        __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(plus, slash)));
+        if (_mm_movemask_epi8(valid) != 0xFFFF)
+        {
+            break;
+        }
+        __m128i shift = _mm_or_si128(_mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-65)), _mm_and_si128(lower, _mm_set1_epi8(-71))),
+                                     _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(4)),
+                                                  _mm_or_si128(_mm_and_si128(plus, _mm_set1_epi8(19)), _mm_and_si128(slash, _mm_set1_epi8(16)))));
+        __m128i sextets = _mm_add_epi8(chars, shift);
+
+        // aaaaaabbbbbb and ccccccdddddd in 16 bits, then the 24 bits of the group in 32 bits, then 3 bytes out of 4
+        __m128i pairs = _mm_maddubs_epi16(sextets, _mm_set1_epi32(0x01400140));
+        __m128i groups = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+        __m128i bytes = _mm_shuffle_epi8(groups, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+        uint8_t buffer[16];
+        _mm_storeu_si128((__m128i*)buffer, bytes);
+        memcpy(output + consumed / 4 * 3, buffer, 12);
+        consumed += 16;
+    }
+    return consumed;
+}
+
+__attribute__((target("avx2")))
+static size_t HTTPStubsBase64DecodeBlocksAVX2(const uint8_t* input, size_t length, uint8_t* output)
+{
+    size_t consumed = 0;
+    while (length - consumed >= 32)
+    {
+        __m256i chars = _mm256_loadu_si256((const __m256i*)(input + consumed));
+        __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), chars));
+        __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), chars));
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), chars));
+        __m256i plus = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('+'));
+        __m256i slash = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('/'));
+        __m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(digit, _mm256_or_si256(plus, slash)));
+        if (_mm256_movemask_epi8(valid) != -1)
+        {
+            break;
+        }
+        __m256i shift = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(upper, _mm256_set1_epi8(-65)), _mm256_and_si256(lower, _mm256_set1_epi8(-71))),
+                                        _mm256_or_si256(_mm256_and_si256(digit, _mm256_set1_epi8(4)),
+                                                        _mm256_or_si256(_mm256_and_si256(plus, _mm256_set1_epi8(19)), _mm256_and_si256(slash, _mm256_set1_epi8(16)))));
+        __m256i sextets = _mm256_add_epi8(chars, shift);
+
+        __m256i pairs = _mm256_maddubs_epi16(sextets, _mm256_set1_epi32(0x01400140));
+        __m256i groups = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+        // Byte shuffles stay within 128-bit lanes, so the 12 bytes of each lane are then joined with a cross-lane permutation
+        __m256i bytes = _mm256_shuffle_epi8(groups, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                                     2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        bytes = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+
+        uint8_t buffer[32];
+        _mm256_storeu_si256((__m256i*)buffer, bytes);
+        memcpy(output + consumed / 4 * 3, buffer, 24);
+        consumed += 32;
+    }
+    return consumed;
+}
+
+static HTTPStubsBase64BlockDecoder HTTPStubsBase64SelectBlockDecoder(void)
+{
+#if defined(__APPLE__)
+    int avx2 = 0, ssse3 = 0;
+    size_t size = sizeof(avx2);
+    sysctlbyname("hw.optional.avx2_0", &avx2, &size, NULL, 0);
+    size = sizeof(ssse3);
+    sysctlbyname("hw.optional.supplementalsse3", &ssse3, &size, NULL, 0);
+#else
+    __builtin_cpu_init();
+    int avx2 = __builtin_cpu_supports("avx2");
+    int ssse3 = __builtin_cpu_supports("ssse3");
+#endif
+    if (avx2)
+    {
+        return HTTPStubsBase64DecodeBlocksAVX2;
+    }
+    return ssse3 ? HTTPStubsBase64DecodeBlocksSSSE3 : NULL;
+}
+
+#elif HTTPSTUBS_BASE64_NEON
+
+static inline uint8x16_t HTTPStubsBase64SextetsNEON(uint8x16_t chars, uint8x16_t* valid)
+{
+    uint8x16_t upper = vandq_u8(vcgeq_u8(chars, vdupq_n_u8('A')), vcleq_u8(chars, vdupq_n_u8('Z')));
+    uint8x16_t lower = vandq_u8(vcgeq_u8(chars, vdupq_n_u8('a')), vcleq_u8(chars, vdupq_n_u8('z')));
+    uint8x16_t digit = vandq_u8(vcgeq_u8(chars, vdupq_n_u8('0')), vcleq_u8(chars, vdupq_n_u8('9')));
+    uint8x16_t plus = vceqq_u8(chars, vdupq_n_u8('+'));
+    uint8x16_t slash = vceqq_u8(chars, vdupq_n_u8('/'));
+    *valid = vorrq_u8(vorrq_u8(upper, lower), vorrq_u8(digit, vorrq_u8(plus, slash)));
+    uint8x16_t shift = vorrq_u8(vorrq_u8(vandq_u8(upper, vdupq_n_u8((uint8_t)-65)), vandq_u8(lower, vdupq_n_u8((uint8_t)-71))),
+                                vorrq_u8(vandq_u8(digit, vdupq_n_u8(4)),
+                                         vorrq_u8(vandq_u8(plus, vdupq_n_u8(19)), vandq_u8(slash, vdupq_n_u8(16)))));
+    return vaddq_u8(chars, shift);
+}
+
+static size_t HTTPStubsBase64DecodeBlocksNEON(const uint8_t* input, size_t length, uint8_t* output)
+{
+    size_t consumed = 0;
+    while (length - consumed >= 64)
+    {
+        // Deinterleaved, so that each register holds the same character of 16 groups
+        uint8x16x4_t chars = vld4q_u8(input + consumed);
+        uint8x16_t valid0, valid1, valid2, valid3;
+        uint8x16_t a = HTTPStubsBase64SextetsNEON(chars.val[0], &valid0);
+        uint8x16_t b = HTTPStubsBase64SextetsNEON(chars.val[1], &valid1);
+        uint8x16_t c = HTTPStubsBase64SextetsNEON(chars.val[2], &valid2);
+        uint8x16_t d = HTTPStubsBase64SextetsNEON(chars.val[3], &valid3);
+        if (vminvq_u8(vandq_u8(vandq_u8(valid0, valid1), vandq_u8(valid2, valid3))) != 0xFF)
+        {
+            break;
+        }
+
+        uint8x16x3_t bytes;
+        bytes.val[0] = vorrq_u8(vshlq_n_u8(a, 2), vshrq_n_u8(b, 4));
+        bytes.val[1] = vorrq_u8(vshlq_n_u8(b, 4), vshrq_n_u8(c, 2));
+        bytes.val[2] = vorrq_u8(vshlq_n_u8(c, 6), d);
+        vst3q_u8(output + consumed / 4 * 3, bytes);
+        consumed += 64;
+    }
+    return consumed;
+}
+
+static HTTPStubsBase64BlockDecoder HTTPStubsBase64SelectBlockDecoder(void)
+{
+    return HTTPStubsBase64DecodeBlocksNEON;
+}
+
+#else
+
+static HTTPStubsBase64BlockDecoder HTTPStubsBase64SelectBlockDecoder(void)
+{
+    return NULL;
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Public API
+
+NSData* __nullable HTTPStubsBase64DecodedData(NSData* base64Data)
+{
+    static HTTPStubsBase64BlockDecoder blockDecoder;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        blockDecoder = HTTPStubsBase64SelectBlockDecoder();
+    });
+
+    uint8_t* bytes = malloc(base64Data.length / 4 * 3 + 3);
+    if (!bytes)
+    {
+        return nil;
+    }
+    size_t length = HTTPStubsBase64Decode(base64Data.bytes, base64Data.length, bytes, blockDecoder);
+    if (length == SIZE_MAX)
+    {
+        free(bytes);
+        return nil;
+    }
+    return [NSData dataWithBytesNoCopy:bytes length:length freeWhenDone:YES];
+}
@@ -0,0 +1,76 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Imports
+
+#import <Foundation/Foundation.h>
+
+#import "HTTPStubs.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class HTTPStubsMocktailBase64Body;
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Parsed Mocktail
+
+/**
+ *  A parsed Mocktail file, ready to be matched against requests.
+ *
+ *  Not part of the public API: only shared with the Mocktail tool, so that it
+ *  measures the very parsing done when stubbing.
+ */
+@interface HTTPStubsMocktail : NSObject
+@property(nonatomic, strong, nullable) NSURL *fileURL;
+@property(nonatomic, copy) NSString *methodPattern;
+@property(nonatomic, copy) NSString *absoluteURLPattern;
+// Compiled from the patterns on first use if not set
+@property(nonatomic, strong, nullable) NSRegularExpression *methodRegex;
+@property(nonatomic, strong, nullable) NSRegularExpression *absoluteURLRegex;
+@property(nonatomic, assign) int statusCode;
+@property(nonatomic, copy) NSDictionary *headers;
+// The offset of the body in fileURL, past the header and the empty line ending it
+@property(nonatomic, assign) NSUInteger bodyOffset;
+@property(nonatomic, strong, nullable) HTTPStubsMocktailBase64Body *base64Body;
+// The body, when it doesn't come from fileURL
+@property(nonatomic, strong, nullable) NSData *body;
+// Whether only the patterns are known yet, the rest being parsed from fileURL on first response
+@property(nonatomic, assign, getter=isDeferred) BOOL deferred;
+@end
+
+@interface HTTPStubs (MocktailPrivate)
+/**
+ *  Parses a Mocktail file, without stubbing it.
+ *
+ *  @param fileURL The URL of the Mocktail file.
+ *  @param error An out value that returns any error encountered while parsing.
+ *
+ *  @return The parsed Mocktail, or nil if the file is not valid.
+ */
++(nullable HTTPStubsMocktail *)mocktailWithContentsOfURL:(NSURL *)fileURL error:(NSError **)error;
+@end
+
+NS_ASSUME_NONNULL_END
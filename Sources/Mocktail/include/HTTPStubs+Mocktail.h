@@ -45,9 +45,18 @@ typedef NS_ENUM(NSInteger, OHHTTPStubsMocktailError) {
     /** The specified Mocktail file has invalid headers */
     OHHTTPStubsMocktailErrorInvalidFileHeader,
     /** An unexpected internal error occured */
-    OHHTTPStubsMocktailErrorInternalError
+    OHHTTPStubsMocktailErrorInternalError,
+    /** The specified file is not a valid Mocktail pack */
+    OHHTTPStubsMocktailErrorInvalidPackFile,
+    /** The manifest of the specified folder is not valid */
+    OHHTTPStubsMocktailErrorInvalidManifest
 };
 
+/**
+ * The name of the optional manifest of a Mocktail folder, see `stubRequestsUsingMocktailsRecursivelyAtURL:error:`
+ */
+extern NSString* const MocktailManifestFileName;
+
 extern NSString* const MocktailErrorDomain;
 
 @interface HTTPStubs (Mocktail)
@@ -84,17 +93,114 @@ extern NSString* const MocktailErrorDomain;
 /**
  * Add stubs using files under a folder in the format of Mocktail as defined at https://github.com/square/objc-mocktail.
  *
- * This method will retrieve all the files under the folder; for each file with surfix of ".tail", it will split the HTTP method Regex, the absolute URL Regex, the headers, the HTTP status code and response body, and use them to add a stub.
+ * This method will retrieve all the files under the folder; for each file with surfix of ".tail", it will split the HTTP method Regex, the absolute URL Regex, the headers, the HTTP status code and response body.
+ * It then adds a single stub routing each request to the matching file, only evaluating the regular expressions of the files whose
+ * HTTP method and required literal URL text can match: a URL pattern like `.*/users/[0-9]+` is only tested against URLs
+ * containing "/users/". Patterns without literal text outside of groups and classes, or with a top-level alternation
+ * (like `.*` or `a|b`), are tested against every request. If several files match the same request, the last one listed in the folder wins.
  *
  * @param path The name of the folder containing files in the Mocktail format.
  * @param bundleOrNil The bundle in which the path is located. If `nil`, the `[NSBundle bundleForClass:self.class]` will be used.
  * @param error An out value that returns any error encountered during stubbing. Returns an NSError object if any error; otherwise returns nil.
  *
- * @return an array of stub descriptor that uniquely identifies the stub and can be later used to remove it with
- * `removeStub:`.
+ * @return an array containing the stub descriptor of the folder (empty if the folder has no valid Mocktail file),
+ * that uniquely identifies the stub and can be later used to remove it with `removeStub:`.
  */
 +(NSArray *)stubRequestsUsingMocktailsAtPath:(NSString *)path inBundle:(nullable NSBundle*)bundleOrNil error:(NSError **)error;
 
+/**
+ * Add a stub using the files under a folder in the format of Mocktail, and keep it up to date as the files change.
+ *
+ * The folder is stubbed like with `stubRequestsUsingMocktailsAtPath:inBundle:error:`, then watched for added, changed
+ * and removed ".tail" files, through file system notifications and by polling the files modification dates every second.
+ * Only the changed files are parsed again, and the stub switches to the new set of Mocktails at once, so that no
+ * request ever sees a partial set. If several files match the same request, the last one in alphabetical order wins.
+ *
+ * @param folderURL The URL of the folder containing files in the Mocktail format.
+ * @param error An out value that returns any error encountered during stubbing. Returns an NSError object if any error; otherwise returns nil.
+ *
+ * @return a stub descriptor that uniquely identifies the stub and can be later used to remove it with
+ * `removeStub:`. The folder stops being watched once the stub is removed.
+ */
++(nullable id<HTTPStubsDescriptor>)stubRequestsUsingMocktailsWatchingFolderAtURL:(NSURL *)folderURL error:(NSError **)error;
+
+/**
+ * Add a stub using the files under a folder and all its subfolders in the format of Mocktail.
+ *
+ * If the folder contains a manifest file (named `MocktailManifestFileName`, "mocktails.json"), only the files it lists
+ * are stubbed, and none of them is read when stubbing: the manifest is a JSON array of objects with a "method" pattern,
+ * an "url" pattern and the "file" path relative to the folder, like `{"method": "GET", "url": "^https://api\\.example\\.com/users$", "file": "users/list.tail"}`.
+ * Each file is only read and parsed on the first request matching its patterns, which are taken from the manifest. If the file
+ * turns out to be invalid then, the request fails with the parsing error.
+ *
+ * The patterns of the manifest are compiled when stubbing: an entry with an invalid pattern makes the whole manifest
+ * fail with `OHHTTPStubsMocktailErrorInvalidManifest`.
+ *
+ * Without manifest, every ".tail" file of the folder tree is parsed when stubbing.
+ *
+ * In both cases, if several files match the same request, the last one wins: the last one of the manifest, or else the last one
+ * in alphabetical order of their paths.
+ *
+ * @param folderURL The URL of the folder containing files in the Mocktail format.
+ * @param error An out value that returns any error encountered during stubbing. Returns an NSError object if any error; otherwise returns nil.
+ *
+ * @return a stub descriptor that uniquely identifies the stub and can be later used to remove it with
+ * `removeStub:`, or nil if any error occurred. A folder without any Mocktail file still gets a stub, which never matches.
+ */
++(nullable id<HTTPStubsDescriptor>)stubRequestsUsingMocktailsRecursivelyAtURL:(NSURL *)folderURL error:(NSError **)error;
+
+/**
+ * Add a stub given a Mocktail pack, as written by `writeMocktailPackWithMocktailsAtURL:toURL:error:`.
+ *
+ * The pack is memory-mapped: loading it costs a single mapping whatever the number of Mocktails it contains.
+ * Requests are routed with the index stored in the pack, each entry is only read from the mapped tables
+ * (and its regular expressions compiled) once a request gets routed to it, and the bodies are sent straight
+ * from the mapped file without being copied. An entry found to be corrupt then is logged and never matches.
+ *
+ * @warning Never truncate nor rewrite a pack in place while it is stubbed: reading a page of a mapped file
+ * that no longer exists crashes the process with `SIGBUS`. Replacing the pack file atomically (writing a
+ * new file, then renaming it over the old one) is safe, as the mapping keeps the old file alive;
+ * `writeMocktailPackWithMocktailsAtURL:toURL:error:` always writes packs that way.
+ *
+ * @param fileName The name of the pack file (without extension of '.mocktailpack').
+ * @param bundleOrNil The bundle in which the pack file is located. If `nil`, the `[NSBundle bundleForClass:self.class]` will be used.
+ * @param error An out value that returns any error encountered during stubbing. Returns an NSError object if any error; otherwise returns nil.
+ *
+ * @return a stub descriptor that uniquely identifies the stub and can be later used to remove it with
+ * `removeStub:`, or `nil` if any error occurred. A pack without any Mocktail still gets a stub, which never matches.
+ */
++(nullable id<HTTPStubsDescriptor>)stubRequestsUsingMocktailPackNamed:(NSString *)fileName inBundle:(nullable NSBundle*)bundleOrNil error:(NSError **)error;
+
+/**
+ * Add a stub given a file URL of a Mocktail pack, as written by `writeMocktailPackWithMocktailsAtURL:toURL:error:`.
+ *
+ * @param packURL The URL pointing to the pack file.
+ * @param error An out value that returns any error encountered during stubbing. Returns an NSError object if any error; otherwise returns nil.
+ *
+ * @return a stub descriptor that uniquely identifies the stub and can be later used to remove it with
+ * `removeStub:`, or `nil` if any error occurred. A pack without any Mocktail still gets a stub, which never matches.
+ */
++(nullable id<HTTPStubsDescriptor>)stubRequestsUsingMocktailPack:(NSURL *)packURL error:(NSError **)error;
+
+/**
+ * Compile the files under a folder in the format of Mocktail into a single Mocktail pack file.
+ *
+ * The pack contains a table of the Mocktails, their patterns and headers, a routing index, and their bodies,
+ * already decoded. Stubbing requests with the pack then behaves like `stubRequestsUsingMocktailsAtPath:inBundle:error:`
+ * with the folder. The pack is written to a temporary file then renamed over `packURL`, so that a pack already
+ * stubbed can be regenerated safely.
+ *
+ * @note The `Tools/MocktailTool` command line tool (`rake mocktail_pack[folder,pack]`) calls this method,
+ * so that packs can be generated whenever the fixtures are committed.
+ *
+ * @param folderURL The URL of the folder containing files in the Mocktail format.
+ * @param packURL The URL of the pack file to write.
+ * @param error An out value that returns any error encountered while writing the pack.
+ *
+ * @return `YES` if the pack has been written, `NO` otherwise.
+ */
++(BOOL)writeMocktailPackWithMocktailsAtURL:(NSURL *)folderURL toURL:(NSURL *)packURL error:(NSError **)error;
+
 @end
 
 NS_ASSUME_NONNULL_END
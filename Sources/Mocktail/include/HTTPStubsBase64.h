@@ -0,0 +1,47 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#import <Foundation/Foundation.h>
+
+#import "Compatibility.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  Decodes base64 data, using the SIMD instructions of the CPU when available
+ *  (SSSE3 or AVX2 on Intel, NEON on ARM64), and a scalar decoder otherwise.
+ *
+ *  As with `NSDataBase64DecodingIgnoreUnknownCharacters`, line breaks, whitespace and any other
+ *  character outside of the base64 alphabet are skipped, so that wrapped base64 text like the
+ *  bodies of `;base64` Mocktail files can be decoded as is. Decoding stops at the first padding
+ *  character, which is optional.
+ *
+ *  @param base64Data The base64 encoded data to decode
+ *
+ *  @return The decoded data, or nil if the base64 data ends with a truncated group of characters
+ */
+NSData* __nullable HTTPStubsBase64DecodedData(NSData* base64Data);
+
+NS_ASSUME_NONNULL_END
@@ -37,6 +37,18 @@
 @interface HTTPStubsProtocol : NSURLProtocol @end
 
 static NSTimeInterval const kSlotTime = 0.25; // Must be >0. We will send a chunk of the data from the stream each 'slotTime' seconds
+static NSUInteger const kMaxChunkSize = 16 * 1024; // Maximum size of the chunks read from the stream (and of a body of unknown size)
+static NSString* const HTTPStubsRequestScanCacheKey = @"OHHTTPStubsRequestScanCache"; // Key of the requestScanCache in the thread dictionary
+
+// HEAD requests, 1xx, 204 and 304 responses never carry a body (RFC 7230 section 3.3.3)
+static BOOL HTTPStubsResponseHasNoBody(NSURLRequest* request, HTTPStubsResponse* response)
+{
+    int statusCode = response.statusCode;
+    return [request.HTTPMethod isEqualToString:@"HEAD"]
+        || (statusCode >= 100 && statusCode < 200)
+        || statusCode == 204
+        || statusCode == 304;
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 #pragma mark - Private Interfaces
@@ -49,6 +61,7 @@ static NSTimeInterval const kSlotTime = 0.25; // Must be >0. We will send a chun
 @property(atomic, copy, nullable) void (^onStubRedirectBlock)(NSURLRequest*, NSURLRequest*, id<HTTPStubsDescriptor>, HTTPStubsResponse*);
 @property(atomic, copy, nullable) void (^afterStubFinishBlock)(NSURLRequest*, id<HTTPStubsDescriptor>, HTTPStubsResponse*, NSError*);
 @property(atomic, copy, nullable) void (^onStubMissingBlock)(NSURLRequest*);
+@property(atomic, strong, nullable) id<HTTPStubsUnmatchedRequestHandler> unmatchedRequestHandler;
 @end
 
 @interface HTTPStubsDescriptor : NSObject <HTTPStubsDescriptor>
@@ -152,6 +165,11 @@ static NSTimeInterval const kSlotTime = 0.25; // Must be >0. We will send a chun
     [HTTPStubs.sharedInstance removeAllStubs];
 }
 
++(nullable NSMutableDictionary*)requestScanCache
+{
+    return NSThread.currentThread.threadDictionary[HTTPStubsRequestScanCacheKey];
+}
+
 #pragma mark > Disabling & Re-Enabling stubs
 
 +(void)_setEnable:(BOOL)enable
@@ -250,6 +268,18 @@ static NSTimeInterval const kSlotTime = 0.25; // Must be >0. We will send a chun
     [HTTPStubs.sharedInstance setOnStubMissingBlock:block];
 }
 
+#pragma mark > Unmatched Requests
+
++(void)setUnmatchedRequestHandler:(nullable id<HTTPStubsUnmatchedRequestHandler>)handler
+{
+    [HTTPStubs.sharedInstance setUnmatchedRequestHandler:handler];
+}
+
++(nullable id<HTTPStubsUnmatchedRequestHandler>)unmatchedRequestHandler
+{
+    return [HTTPStubs.sharedInstance unmatchedRequestHandler];
+}
+
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -303,18 +333,31 @@ static NSTimeInterval const kSlotTime = 0.25; // Must be >0. We will send a chun
 
 - (HTTPStubsDescriptor*)firstStubPassingTestForRequest:(NSURLRequest*)request
 {
+    // The previous cache is restored in case a test block itself has another request matched
+    NSMutableDictionary* threadDictionary = NSThread.currentThread.threadDictionary;
+    id previousCache = threadDictionary[HTTPStubsRequestScanCacheKey];
+    threadDictionary[HTTPStubsRequestScanCacheKey] = [NSMutableDictionary new];
+
     HTTPStubsDescriptor* foundStub = nil;
-    @synchronized(_stubDescriptors)
+    @try
     {
-        for(HTTPStubsDescriptor* stub in _stubDescriptors.reverseObjectEnumerator)
+        @synchronized(_stubDescriptors)
         {
-            if (stub.testBlock(request))
+            for(HTTPStubsDescriptor* stub in _stubDescriptors.reverseObjectEnumerator)
             {
-                foundStub = stub;
-                break;
+                if (stub.testBlock(request))
+                {
+                    foundStub = stub;
+                    break;
+                }
             }
         }
     }
+    @finally
+    {
+        // Even if a test block throws, so that the next lookups on this thread don't see this request's cache
+        threadDictionary[HTTPStubsRequestScanCacheKey] = previousCache;
+    }
     return foundStub;
 }
 
@@ -335,6 +378,8 @@ static NSTimeInterval const kSlotTime = 0.25; // Must be >0. We will send a chun
 @interface HTTPStubsProtocol()
 @property(assign) BOOL stopped;
 @property(strong) HTTPStubsDescriptor* stub;
+@property(strong) id<HTTPStubsUnmatchedRequestHandler> unmatchedRequestHandler;
+@property(copy) dispatch_block_t cancelUnmatchedLoad;
 @property(assign) CFRunLoopRef clientRunLoop;
 - (void)executeOnClientRunLoopAfterDelay:(NSTimeInterval)delayInSeconds block:(dispatch_block_t)block;
 @end
@@ -347,7 +392,7 @@ static NSTimeInterval const kSlotTime = 0.25; // Must be >0. We will send a chun
     if (!found && HTTPStubs.sharedInstance.onStubMissingBlock) {
         HTTPStubs.sharedInstance.onStubMissingBlock(request);
     }
-    return found;
+    return found || [HTTPStubs.sharedInstance.unmatchedRequestHandler shouldLoadUnmatchedRequest:request];
 }
 
 - (id)initWithRequest:(NSURLRequest *)request cachedResponse:(NSCachedURLResponse *)response client:(id<NSURLProtocolClient>)client
@@ -355,6 +400,14 @@ static NSTimeInterval const kSlotTime = 0.25; // Must be >0. We will send a chun
     // Make super sure that we never use a cached response.
     HTTPStubsProtocol* proto = [super initWithRequest:request cachedResponse:nil client:client];
     proto.stub = [HTTPStubs.sharedInstance firstStubPassingTestForRequest:request];
+    if (!proto.stub)
+    {
+        id<HTTPStubsUnmatchedRequestHandler> handler = HTTPStubs.sharedInstance.unmatchedRequestHandler;
+        if ([handler shouldLoadUnmatchedRequest:request])
+        {
+            proto.unmatchedRequestHandler = handler;
+        }
+    }
     return proto;
 }
 
@@ -392,6 +445,13 @@ static NSTimeInterval const kSlotTime = 0.25; // Must be >0. We will send a chun
     NSURLRequest* request = self.request;
     id<NSURLProtocolClient> client = self.client;
 
+    if (!self.stub && self.unmatchedRequestHandler)
+    {
+        // Unmatched request taken over by the handler, which reports the response to the client itself
+        self.cancelUnmatchedLoad = [self.unmatchedRequestHandler startLoadingUnmatchedRequestForProtocol:self];
+        return;
+    }
+
     if (!self.stub)
     {
         NSDictionary* userInfo = [NSDictionary dictionaryWithObjectsAndKeys:
@@ -484,30 +544,54 @@ static NSTimeInterval const kSlotTime = 0.25; // Must be >0. We will send a chun
 
                 // Send the response (even for redirections)
                 [client URLProtocol:self didReceiveResponse:urlResponse cacheStoragePolicy:NSURLCacheStorageNotAllowed];
-                if(responseStub.inputStream.streamStatus == NSStreamStatusNotOpen)
+                void(^completion)(NSError*) = ^(NSError * error)
                 {
-                    [responseStub.inputStream open];
+                    if (responseStub.inputStream.streamStatus != NSStreamStatusNotOpen)
+                    {
+                        [responseStub.inputStream close];
+                    }
+                    NSError *blockError = nil;
+                    if (error==nil)
+                    {
+                        [client URLProtocolDidFinishLoading:self];
+                    }
+                    else
+                    {
+                        [client URLProtocol:self didFailWithError:responseStub.error];
+                        blockError = responseStub.error;
+                    }
+                    if (HTTPStubs.sharedInstance.afterStubFinishBlock)
+                    {
+                        HTTPStubs.sharedInstance.afterStubFinishBlock(request, self.stub, responseStub, blockError);
+                    }
+                };
+
+                if (HTTPStubsResponseHasNoBody(request, responseStub))
+                {
+                    // Never touch the body source: just wait for the responseTime then finish
+                    [self executeOnClientRunLoopAfterDelay:MAX(responseStub.responseTime, 0) block:^{
+                        if (!self.stopped)
+                        {
+                            completion(nil);
+                        }
+                    }];
+                }
+                else if (responseStub.frameProvider)
+                {
+                    [self streamFramesForClient:client
+                               withStubResponse:responseStub
+                                     completion:completion];
+                }
+                else
+                {
+                    if(responseStub.inputStream.streamStatus == NSStreamStatusNotOpen)
+                    {
+                        [responseStub.inputStream open];
+                    }
+                    [self streamDataForClient:client
+                             withStubResponse:responseStub
+                                   completion:completion];
                 }
-                [self streamDataForClient:client
-                         withStubResponse:responseStub
-                               completion:^(NSError * error)
-                 {
-                     [responseStub.inputStream close];
-                     NSError *blockError = nil;
-                     if (error==nil)
-                     {
-                         [client URLProtocolDidFinishLoading:self];
-                     }
-                     else
-                     {
-                         [client URLProtocol:self didFailWithError:responseStub.error];
-                         blockError = responseStub.error;
-                     }
-                     if (HTTPStubs.sharedInstance.afterStubFinishBlock)
-                     {
-                         HTTPStubs.sharedInstance.afterStubFinishBlock(request, self.stub, responseStub, blockError);
-                     }
-                 }];
             }
         }];
     } else {
@@ -528,6 +612,11 @@ static NSTimeInterval const kSlotTime = 0.25; // Must be >0. We will send a chun
 - (void)stopLoading
 {
     self.stopped = YES;
+    dispatch_block_t cancelUnmatchedLoad = self.cancelUnmatchedLoad;
+    if (cancelUnmatchedLoad)
+    {
+        cancelUnmatchedLoad();
+    }
 }
 
 typedef struct {
@@ -556,6 +645,26 @@ typedef struct {
                 // Bytes send each 'slotTime' seconds = Speed in KB/s * 1000 * slotTime in seconds
                 timingInfo.chunkSizePerSlot = (fabs(stubResponse.responseTime) * 1000) * timingInfo.slotTime;
             }
+            else if (stubResponse.dataSize == OHHTTPStubsUnknownDataSize)
+            {
+                // We can't spread a body of unknown size over responseTime, so send it as fast as it is produced,
+                // and only finish loading once responseTime has elapsed
+                timingInfo.chunkSizePerSlot = kMaxChunkSize;
+                timingInfo.slotTime = 0;
+                if (stubResponse.responseTime > 0)
+                {
+                    NSDate* endDate = [NSDate dateWithTimeIntervalSinceNow:stubResponse.responseTime];
+                    void(^streamCompletion)(NSError*) = completion;
+                    completion = ^(NSError* error) {
+                        [self executeOnClientRunLoopAfterDelay:MAX(endDate.timeIntervalSinceNow, 0) block:^{
+                            if (streamCompletion && !self.stopped)
+                            {
+                                streamCompletion(error);
+                            }
+                        }];
+                    };
+                }
+            }
             else if (stubResponse.responseTime < kSlotTime) // includes case when responseTime == 0
             {
                 // We want to send the whole data quicker than the slotTime, so send it all in one chunk.
@@ -568,6 +677,13 @@ typedef struct {
                 timingInfo.chunkSizePerSlot = ((stubResponse.dataSize/stubResponse.responseTime) * timingInfo.slotTime);
             }
 
+            if (timingInfo.chunkSizePerSlot > kMaxChunkSize)
+            {
+                // Never read more than kMaxChunkSize at once: send smaller chunks more often, at the same speed
+                timingInfo.slotTime *= kMaxChunkSize / timingInfo.chunkSizePerSlot;
+                timingInfo.chunkSizePerSlot = kMaxChunkSize;
+            }
+
             [self streamDataForClient:client
                            fromStream:stubResponse.inputStream
                            timingInfo:timingInfo
@@ -642,6 +758,40 @@ typedef struct {
     }
 }
 
+- (void)streamFramesForClient:(id<NSURLProtocolClient>)client
+             withStubResponse:(HTTPStubsResponse*)stubResponse
+                   completion:(void(^)(NSError * error))completion
+{
+    if (self.stopped)
+    {
+        return;
+    }
+
+    // Only ask for the next frame once the previous one has been sent, so that a long stream never piles up in memory
+    NSTimeInterval delay = 0;
+    NSData* frame = stubResponse.frameProvider(&delay);
+    if (!frame)
+    {
+        if (completion)
+        {
+            // The provider may have set an error to end the stream with a failure
+            completion(stubResponse.error);
+        }
+        return;
+    }
+
+    [self executeOnClientRunLoopAfterDelay:delay block:^{
+        if (!self.stopped)
+        {
+            if (frame.length > 0)
+            {
+                [client URLProtocol:self didLoadData:frame];
+            }
+            [self streamFramesForClient:client withStubResponse:stubResponse completion:completion];
+        }
+    }];
+}
+
 /////////////////////////////////////////////
 // Delayed execution utility methods
 /////////////////////////////////////////////
@@ -0,0 +1,94 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Imports
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Body Stream Tee
+
+/**
+ *  An input stream wrapping the HTTPBodyStream of a request, so that stubs can
+ *  look at the body before the loader reads it.
+ *
+ *  The bytes read ahead for the stubs are kept (in memory up to `memoryLimit`, in
+ *  a temporary file beyond that) and replayed to the next reader, before reading
+ *  the rest of the wrapped stream. The bytes no stub looked at are passed through
+ *  without being copied.
+ *
+ *  When the reader schedules the stream in a run loop, as CFNetwork does when
+ *  uploading the body of a request no stub matched, the wrapped stream is scheduled
+ *  along and its events are relayed, after the events of the bytes read ahead.
+ */
+@interface HTTPStubsBodyStream : NSInputStream
+
+-(instancetype)initWithInputStream:(NSInputStream*)stream memoryLimit:(NSUInteger)memoryLimit;
+
+/**
+ *  The first bytes of the body, reading ahead only as much as needed.
+ *
+ *  @param length The number of bytes to return.
+ *
+ *  @return The first `length` bytes, or less if the body is shorter.
+ */
+-(NSData*)prefixOfLength:(NSUInteger)length;
+
+/**
+ *  The whole body, reading ahead to its end.
+ *
+ *  @return The body, or nil if it is larger than `memoryLimit` or could not be read.
+ */
+-(nullable NSData*)body;
+
+/**
+ *  The SHA-256 digest of the whole body, reading ahead to its end.
+ *
+ *  @return The digest, or nil if the body could not be read.
+ */
+-(nullable NSData*)digest;
+
+/**
+ *  The fingerprint of the whole body (see `HTTPStubsBodyFingerprint`), computed
+ *  along with the digest while reading ahead to its end.
+ *
+ *  @return The fingerprint, or nil if the body could not be read.
+ */
+-(nullable NSData*)fingerprint;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Fingerprint
+
+/**
+ *  The length and the 64-bit XXH64 hash of a body: 16 bytes which can be compared
+ *  and used as dictionary keys.
+ */
+NSData* HTTPStubsBodyFingerprint(NSData* body);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,733 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+#if ! __has_feature(objc_arc)
+#error This file is expected to be compiled with ARC turned ON
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Imports
+
+#import "HTTPStubsBodyStream.h"
+
+#import <CommonCrypto/CommonDigest.h>
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Defines & Constants
+
+static NSUInteger const kReadAheadChunkSize = 16 * 1024;
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Fingerprint
+
+// Fast non-cryptographic hash of the bodies, to tell most different bodies apart without comparing them.
+// XXH64 (little-endian platforms only, which all Apple platforms are), computed incrementally so that
+// streamed bodies are hashed as they are read ahead.
+static uint64_t const kPrime1 = 0x9E3779B185EBCA87ULL;
+static uint64_t const kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+static uint64_t const kPrime3 = 0x165667B19E3779F9ULL;
+static uint64_t const kPrime4 = 0x85EBCA77C2B2AE63ULL;
+static uint64_t const kPrime5 = 0x27D4EB2F165667C5ULL;
+
+typedef struct {
+    uint64_t totalLength;
+    uint64_t v1, v2, v3, v4;
+    // The bytes not hashed yet, until they make a whole 32-byte stripe
+    uint8_t stripe[32];
+    size_t stripeLength;
+} HTTPStubsHash64State;
+
+static inline uint64_t HTTPStubsRotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t HTTPStubsRead64(const uint8_t* p)
+{
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t HTTPStubsRead32(const uint8_t* p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t HTTPStubsRound64(uint64_t acc, uint64_t input)
+{
+    acc += input * kPrime2;
+    return HTTPStubsRotl64(acc, 31) * kPrime1;
+}
+
+static inline uint64_t HTTPStubsMerge64(uint64_t acc, uint64_t lane)
+{
+    acc ^= HTTPStubsRound64(0, lane);
+    return acc * kPrime1 + kPrime4;
+}
+
+static void HTTPStubsHash64Init(HTTPStubsHash64State* state)
+{
+    memset(state, 0, sizeof(*state));
+    state->v1 = kPrime1 + kPrime2;
+    state->v2 = kPrime2;
+    state->v3 = 0;
+    state->v4 = -kPrime1;
+}
+
+static inline void HTTPStubsHash64Stripe(HTTPStubsHash64State* state, const uint8_t* p)
+{
+    state->v1 = HTTPStubsRound64(state->v1, HTTPStubsRead64(p));
+    state->v2 = HTTPStubsRound64(state->v2, HTTPStubsRead64(p + 8));
+    state->v3 = HTTPStubsRound64(state->v3, HTTPStubsRead64(p + 16));
+    state->v4 = HTTPStubsRound64(state->v4, HTTPStubsRead64(p + 24));
+}
+
+static void HTTPStubsHash64Update(HTTPStubsHash64State* state, const uint8_t* bytes, size_t length)
+{
+    state->totalLength += length;
+    if (state->stripeLength + length < sizeof(state->stripe))
+    {
+        memcpy(state->stripe + state->stripeLength, bytes, length);
+        state->stripeLength += length;
+        return;
+    }
+    if (state->stripeLength > 0)
+    {
+        size_t fill = sizeof(state->stripe) - state->stripeLength;
+        memcpy(state->stripe + state->stripeLength, bytes, fill);
+        HTTPStubsHash64Stripe(state, state->stripe);
+        bytes += fill;
+        length -= fill;
+        state->stripeLength = 0;
+    }
+    for (; length >= sizeof(state->stripe); bytes += sizeof(state->stripe), length -= sizeof(state->stripe))
+    {
+        HTTPStubsHash64Stripe(state, bytes);
+    }
+    memcpy(state->stripe, bytes, length);
+    state->stripeLength = length;
+}
+
+static uint64_t HTTPStubsHash64Final(const HTTPStubsHash64State* state)
+{
+    uint64_t hash;
+    if (state->totalLength >= sizeof(state->stripe))
+    {
+        hash = HTTPStubsRotl64(state->v1, 1) + HTTPStubsRotl64(state->v2, 7) + HTTPStubsRotl64(state->v3, 12) + HTTPStubsRotl64(state->v4, 18);
+        hash = HTTPStubsMerge64(hash, state->v1);
+        hash = HTTPStubsMerge64(hash, state->v2);
+        hash = HTTPStubsMerge64(hash, state->v3);
+        hash = HTTPStubsMerge64(hash, state->v4);
+    }
+    else
+    {
+        hash = kPrime5;
+    }
+    hash += state->totalLength;
+
+    const uint8_t* p = state->stripe;
+    const uint8_t* end = state->stripe + state->stripeLength;
+    for (; p + 8 <= end; p += 8)
+    {
+        hash ^= HTTPStubsRound64(0, HTTPStubsRead64(p));
+        hash = HTTPStubsRotl64(hash, 27) * kPrime1 + kPrime4;
+    }
+    if (p + 4 <= end)
+    {
+        hash ^= (uint64_t)HTTPStubsRead32(p) * kPrime1;
+        hash = HTTPStubsRotl64(hash, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+    {
+        hash ^= (*p) * kPrime5;
+        hash = HTTPStubsRotl64(hash, 11) * kPrime1;
+    }
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+static NSData* HTTPStubsHash64Fingerprint(const HTTPStubsHash64State* state)
+{
+    uint64_t fingerprint[2] = { state->totalLength, HTTPStubsHash64Final(state) };
+    return [NSData dataWithBytes:fingerprint length:sizeof(fingerprint)];
+}
+
+NSData* HTTPStubsBodyFingerprint(NSData* body)
+{
+    __block HTTPStubsHash64State state;
+    HTTPStubsHash64Init(&state);
+    [body enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
+        HTTPStubsHash64Update(&state, bytes, byteRange.length);
+    }];
+    return HTTPStubsHash64Fingerprint(&state);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Implementation
+
+@interface HTTPStubsBodyStream ()
+-(void)wrappedStreamDidSendEvent:(NSStreamEvent)event;
+@end
+
+// The client of the wrapped stream while the body stream is scheduled, which doesn't retain the body stream
+static void HTTPStubsBodyStreamWrappedStreamCallback(CFReadStreamRef stream, CFStreamEventType type, void* info)
+{
+    [(__bridge HTTPStubsBodyStream*)info wrappedStreamDidSendEvent:(NSStreamEvent)type];
+}
+
+@implementation HTTPStubsBodyStream
+{
+    NSInputStream* _stream;
+    NSUInteger _memoryLimit;
+    NSStreamStatus _status;
+    NSError* _error;
+    __weak id<NSStreamDelegate> _delegate;
+
+    // The first bytes of the body, read ahead for the stubs: the first memoryLimit bytes
+    // in memory, the others in a temporary file
+    NSMutableData* _buffer;
+    NSString* _spillPath;
+    NSFileHandle* _spillFile;
+    unsigned long long _readAheadLength;
+    BOOL _readAheadEnded;
+    BOOL _readAheadFailed;
+    CC_SHA256_CTX _digestContext;
+    NSData* _digest;
+    HTTPStubsHash64State _fingerprintState;
+    NSData* _fingerprint;
+
+    // How much of the read-ahead bytes were given back to the reader, and whether
+    // it then read from the wrapped stream directly
+    unsigned long long _replayOffset;
+    BOOL _passedThrough;
+
+    // The run loop the reader scheduled the stream in, and its CFReadStream client
+    CFRunLoopRef _runLoop;
+    NSMutableArray<NSString*>* _runLoopModes;
+    CFOptionFlags _clientFlags;
+    CFReadStreamClientCallBack _clientCallback;
+    CFStreamClientContext _clientContext;
+    BOOL _openEventPending;
+    BOOL _signalPending;
+}
+
+-(instancetype)initWithInputStream:(NSInputStream*)stream memoryLimit:(NSUInteger)memoryLimit
+{
+    self = [super init];
+    if (self)
+    {
+        _stream = stream;
+        _memoryLimit = memoryLimit;
+        _status = NSStreamStatusNotOpen;
+        _buffer = [NSMutableData new];
+        _runLoopModes = [NSMutableArray new];
+        CC_SHA256_Init(&_digestContext);
+        HTTPStubsHash64Init(&_fingerprintState);
+    }
+    return self;
+}
+
+-(void)dealloc
+{
+    if (_runLoop)
+    {
+        CFReadStreamSetClient((__bridge CFReadStreamRef)_stream, kCFStreamEventNone, NULL, NULL);
+        for (NSString* mode in _runLoopModes)
+        {
+            CFReadStreamUnscheduleFromRunLoop((__bridge CFReadStreamRef)_stream, _runLoop, (__bridge CFStringRef)mode);
+        }
+        CFRelease(_runLoop);
+    }
+    [self releaseClientContext];
+    [self removeSpillFile];
+}
+
+#pragma mark - Read ahead
+
+-(NSData*)prefixOfLength:(NSUInteger)length
+{
+    @synchronized(self)
+    {
+        [self readAheadToLength:length];
+        return [self readAheadDataInRange:NSMakeRange(0, (NSUInteger)MIN(length, _readAheadLength))];
+    }
+}
+
+-(nullable NSData*)body
+{
+    @synchronized(self)
+    {
+        [self readAheadToLength:ULLONG_MAX];
+        if (_readAheadFailed || !_readAheadEnded || _readAheadLength > _memoryLimit)
+        {
+            return nil;
+        }
+        return [_buffer copy];
+    }
+}
+
+-(nullable NSData*)digest
+{
+    @synchronized(self)
+    {
+        [self readAheadToLength:ULLONG_MAX];
+        if (_readAheadFailed || !_readAheadEnded)
+        {
+            return nil;
+        }
+        if (!_digest)
+        {
+            unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+            CC_SHA256_Final(digest, &_digestContext);
+            _digest = [NSData dataWithBytes:digest length:CC_SHA256_DIGEST_LENGTH];
+        }
+        return _digest;
+    }
+}
+
+-(nullable NSData*)fingerprint
+{
+    @synchronized(self)
+    {
+        [self readAheadToLength:ULLONG_MAX];
+        if (_readAheadFailed || !_readAheadEnded)
+        {
+            return nil;
+        }
+        if (!_fingerprint)
+        {
+            _fingerprint = HTTPStubsHash64Fingerprint(&_fingerprintState);
+        }
+        return _fingerprint;
+    }
+}
+
+// Must be called while synchronized on self
+-(void)readAheadToLength:(unsigned long long)length
+{
+    // Once the reader went past the read-ahead bytes, the body can't be looked at anymore
+    if (_passedThrough)
+    {
+        return;
+    }
+    [self openStreamIfNeeded];
+
+    uint8_t chunk[kReadAheadChunkSize];
+    while (_readAheadLength < length && !_readAheadEnded && !_readAheadFailed)
+    {
+        NSInteger count = [_stream read:chunk maxLength:(NSUInteger)MIN((unsigned long long)kReadAheadChunkSize, length - _readAheadLength)];
+        if (count < 0)
+        {
+            _readAheadFailed = YES;
+            _error = _stream.streamError;
+        }
+        else if (count == 0)
+        {
+            _readAheadEnded = YES;
+        }
+        else
+        {
+            CC_SHA256_Update(&_digestContext, chunk, (CC_LONG)count);
+            HTTPStubsHash64Update(&_fingerprintState, chunk, (size_t)count);
+            [self appendReadAheadBytes:chunk length:(NSUInteger)count];
+        }
+    }
+}
+
+-(void)appendReadAheadBytes:(const uint8_t*)bytes length:(NSUInteger)length
+{
+    NSUInteger inMemory = (_buffer.length < _memoryLimit && !_spillFile) ? MIN(length, _memoryLimit - _buffer.length) : 0;
+    [_buffer appendBytes:bytes length:inMemory];
+    if (inMemory < length)
+    {
+        if (!_spillFile)
+        {
+            _spillPath = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"OHHTTPStubs-body-%@", NSUUID.UUID.UUIDString]];
+            [NSFileManager.defaultManager createFileAtPath:_spillPath contents:nil attributes:nil];
+            _spillFile = [NSFileHandle fileHandleForUpdatingAtPath:_spillPath];
+        }
+        [_spillFile seekToEndOfFile];
+        [_spillFile writeData:[NSData dataWithBytesNoCopy:(void*)(bytes + inMemory) length:length - inMemory freeWhenDone:NO]];
+    }
+    _readAheadLength += length;
+}
+
+-(NSData*)readAheadDataInRange:(NSRange)range
+{
+    if (NSMaxRange(range) <= _buffer.length)
+    {
+        return [_buffer subdataWithRange:range];
+    }
+    NSMutableData* data = [NSMutableData dataWithCapacity:range.length];
+    if (range.location < _buffer.length)
+    {
+        [data appendData:[_buffer subdataWithRange:NSMakeRange(range.location, _buffer.length - range.location)]];
+    }
+    [_spillFile seekToFileOffset:(unsigned long long)(range.location + data.length - _buffer.length)];
+    [data appendData:[_spillFile readDataOfLength:range.length - data.length]];
+    return data;
+}
+
+-(void)openStreamIfNeeded
+{
+    if (_stream.streamStatus == NSStreamStatusNotOpen)
+    {
+        [_stream open];
+    }
+}
+
+-(void)removeSpillFile
+{
+    [_spillFile closeFile];
+    _spillFile = nil;
+    if (_spillPath)
+    {
+        [NSFileManager.defaultManager removeItemAtPath:_spillPath error:NULL];
+        _spillPath = nil;
+    }
+}
+
+#pragma mark - NSInputStream
+
+-(void)open
+{
+    @synchronized(self)
+    {
+        _status = NSStreamStatusOpen;
+        // Opened now so that its events, if scheduled, flow to the reader once the read-ahead bytes are given back
+        [self openStreamIfNeeded];
+        _openEventPending = YES;
+        [self signalReader];
+    }
+}
+
+-(void)close
+{
+    @synchronized(self)
+    {
+        [_stream close];
+        [self removeSpillFile];
+        _status = NSStreamStatusClosed;
+    }
+}
+
+-(NSInteger)read:(uint8_t*)buffer maxLength:(NSUInteger)length
+{
+    @synchronized(self)
+    {
+        if (_status != NSStreamStatusOpen)
+        {
+            return (_status == NSStreamStatusAtEnd) ? 0 : -1;
+        }
+
+        // Give back the bytes read ahead first
+        if (_replayOffset < _readAheadLength)
+        {
+            NSUInteger count = (NSUInteger)MIN((unsigned long long)length, _readAheadLength - _replayOffset);
+            [[self readAheadDataInRange:NSMakeRange((NSUInteger)_replayOffset, count)] getBytes:buffer length:count];
+            _replayOffset += count;
+            // The wrapped stream doesn't know about these bytes, so tell the reader what comes next
+            [self signalReader];
+            return (NSInteger)count;
+        }
+        if (_readAheadFailed)
+        {
+            _status = NSStreamStatusError;
+            return -1;
+        }
+        if (_readAheadEnded)
+        {
+            _status = NSStreamStatusAtEnd;
+            return 0;
+        }
+
+        [self openStreamIfNeeded];
+        _passedThrough = YES;
+        NSInteger count = [_stream read:buffer maxLength:length];
+        if (count == 0)
+        {
+            _status = NSStreamStatusAtEnd;
+        }
+        else if (count < 0)
+        {
+            _status = NSStreamStatusError;
+            _error = _stream.streamError;
+        }
+        return count;
+    }
+}
+
+-(BOOL)getBuffer:(uint8_t**)buffer length:(NSUInteger*)length
+{
+    return NO;
+}
+
+-(BOOL)hasBytesAvailable
+{
+    @synchronized(self)
+    {
+        if (_status != NSStreamStatusOpen)
+        {
+            return NO;
+        }
+        // At the end of the read-ahead body, a read tells the reader about the end or the error
+        if (_replayOffset < _readAheadLength || _readAheadEnded || _readAheadFailed)
+        {
+            return YES;
+        }
+        [self openStreamIfNeeded];
+        return _stream.hasBytesAvailable;
+    }
+}
+
+-(NSStreamStatus)streamStatus
+{
+    @synchronized(self)
+    {
+        return _status;
+    }
+}
+
+-(NSError*)streamError
+{
+    @synchronized(self)
+    {
+        return _error;
+    }
+}
+
+-(id<NSStreamDelegate>)delegate
+{
+    return _delegate;
+}
+
+-(void)setDelegate:(id<NSStreamDelegate>)delegate
+{
+    _delegate = delegate;
+}
+
+-(id)propertyForKey:(NSStreamPropertyKey)key
+{
+    return nil;
+}
+
+-(BOOL)setProperty:(id)property forKey:(NSStreamPropertyKey)key
+{
+    return NO;
+}
+
+-(void)scheduleInRunLoop:(NSRunLoop*)runLoop forMode:(NSRunLoopMode)mode
+{
+    [self _scheduleInCFRunLoop:runLoop.getCFRunLoop forMode:(__bridge CFStringRef)mode];
+}
+
+-(void)removeFromRunLoop:(NSRunLoop*)runLoop forMode:(NSRunLoopMode)mode
+{
+    [self _unscheduleFromCFRunLoop:runLoop.getCFRunLoop forMode:(__bridge CFStringRef)mode];
+}
+
+#pragma mark - CFReadStream bridging
+
+// Undocumented methods called when CFNetwork uses the stream as a CFReadStream,
+// which NSInputStream subclasses must implement to be used as an HTTPBodyStream.
+// The wrapped stream is scheduled along, and its events relayed to the client.
+-(void)_scheduleInCFRunLoop:(CFRunLoopRef)runLoop forMode:(CFStringRef)mode
+{
+    @synchronized(self)
+    {
+        if (_runLoop && _runLoop != runLoop)
+        {
+            // Like CFNetwork, only expect to be scheduled in a single run loop at a time
+            return;
+        }
+        if (!_runLoop)
+        {
+            _runLoop = (CFRunLoopRef)CFRetain(runLoop);
+            CFStreamClientContext context = { 0, (__bridge void*)self, NULL, NULL, NULL };
+            CFReadStreamSetClient((__bridge CFReadStreamRef)_stream,
+                                  kCFStreamEventHasBytesAvailable | kCFStreamEventEndEncountered | kCFStreamEventErrorOccurred,
+                                  HTTPStubsBodyStreamWrappedStreamCallback, &context);
+        }
+        if (![_runLoopModes containsObject:(__bridge NSString*)mode])
+        {
+            [_runLoopModes addObject:(__bridge NSString*)mode];
+            CFReadStreamScheduleWithRunLoop((__bridge CFReadStreamRef)_stream, runLoop, mode);
+        }
+        [self signalReader];
+    }
+}
+
+-(void)_unscheduleFromCFRunLoop:(CFRunLoopRef)runLoop forMode:(CFStringRef)mode
+{
+    @synchronized(self)
+    {
+        if (runLoop != _runLoop || ![_runLoopModes containsObject:(__bridge NSString*)mode])
+        {
+            return;
+        }
+        CFReadStreamUnscheduleFromRunLoop((__bridge CFReadStreamRef)_stream, runLoop, mode);
+        [_runLoopModes removeObject:(__bridge NSString*)mode];
+        if (_runLoopModes.count == 0)
+        {
+            CFReadStreamSetClient((__bridge CFReadStreamRef)_stream, kCFStreamEventNone, NULL, NULL);
+            CFRelease(_runLoop);
+            _runLoop = NULL;
+        }
+    }
+}
+
+-(BOOL)_setCFClientFlags:(CFOptionFlags)flags callback:(CFReadStreamClientCallBack)callback context:(CFStreamClientContext*)context
+{
+    @synchronized(self)
+    {
+        [self releaseClientContext];
+        _clientCallback = callback;
+        _clientFlags = callback ? flags : kCFStreamEventNone;
+        if (callback && context)
+        {
+            _clientContext = *context;
+            if (_clientContext.info && _clientContext.retain)
+            {
+                _clientContext.info = (void*)_clientContext.retain(_clientContext.info);
+            }
+        }
+        [self signalReader];
+    }
+    return YES;
+}
+
+#pragma mark - Events
+
+// Must be called while synchronized on self
+-(void)releaseClientContext
+{
+    if (_clientContext.info && _clientContext.release)
+    {
+        _clientContext.release(_clientContext.info);
+    }
+    memset(&_clientContext, 0, sizeof(_clientContext));
+}
+
+// The event telling the reader what it can read next without the wrapped stream signalling it: the bytes read ahead,
+// then the end of the body if it was reached while reading ahead, or the bytes the wrapped stream signalled meanwhile.
+// Must be called while synchronized on self
+-(NSStreamEvent)pendingReaderEvent
+{
+    if (_status != NSStreamStatusOpen || (_readAheadLength == 0 && !_readAheadEnded && !_readAheadFailed))
+    {
+        // Without read ahead, the wrapped stream signals everything itself
+        return NSStreamEventNone;
+    }
+    if (_replayOffset < _readAheadLength)
+    {
+        return NSStreamEventHasBytesAvailable;
+    }
+    if (_readAheadFailed)
+    {
+        return NSStreamEventErrorOccurred;
+    }
+    if (_readAheadEnded)
+    {
+        return NSStreamEventEndEncountered;
+    }
+    return (!_passedThrough && _stream.hasBytesAvailable) ? NSStreamEventHasBytesAvailable : NSStreamEventNone;
+}
+
+// Send the pending events to the reader on the run loop it scheduled the stream in, if any.
+// Must be called while synchronized on self
+-(void)signalReader
+{
+    if (!_runLoop || _signalPending || _runLoopModes.count == 0 || (!_openEventPending && [self pendingReaderEvent] == NSStreamEventNone))
+    {
+        return;
+    }
+    _signalPending = YES;
+    CFRunLoopPerformBlock(_runLoop, (__bridge CFTypeRef)[_runLoopModes copy], ^{
+        BOOL openCompleted;
+        NSStreamEvent event;
+        @synchronized(self)
+        {
+            // Computed when delivered, as the reader may have read more since
+            self->_signalPending = NO;
+            openCompleted = self->_openEventPending && self->_status == NSStreamStatusOpen;
+            self->_openEventPending = NO;
+            event = [self pendingReaderEvent];
+        }
+        if (openCompleted)
+        {
+            [self sendEvent:NSStreamEventOpenCompleted];
+        }
+        if (event != NSStreamEventNone)
+        {
+            [self sendEvent:event];
+        }
+    });
+    CFRunLoopWakeUp(_runLoop);
+}
+
+-(void)sendEvent:(NSStreamEvent)event
+{
+    CFReadStreamClientCallBack callback = NULL;
+    void* info = NULL;
+    @synchronized(self)
+    {
+        if (_clientFlags & (CFOptionFlags)event)
+        {
+            callback = _clientCallback;
+            info = _clientContext.info;
+        }
+    }
+    if (callback)
+    {
+        callback((__bridge CFReadStreamRef)self, (CFStreamEventType)event, info);
+    }
+    id<NSStreamDelegate> delegate = self.delegate;
+    if ([delegate respondsToSelector:@selector(stream:handleEvent:)])
+    {
+        [delegate stream:self handleEvent:event];
+    }
+}
+
+-(void)wrappedStreamDidSendEvent:(NSStreamEvent)event
+{
+    @synchronized(self)
+    {
+        // Until the reader got the read-ahead bytes, the events of the wrapped stream are about bytes it doesn't know about yet
+        if (_status != NSStreamStatusOpen || _replayOffset < _readAheadLength || _readAheadEnded || _readAheadFailed)
+        {
+            return;
+        }
+    }
+    [self sendEvent:event];
+}
+
+@end
@@ -0,0 +1,272 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+#if ! __has_feature(objc_arc)
+#error This file is expected to be compiled with ARC turned ON
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Imports
+
+#import "HTTPStubsFileMetadata.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Defines & Constants
+
+#ifndef O_EVTONLY
+#define O_EVTONLY O_RDONLY
+#endif
+
+#if defined(__APPLE__)
+#define HTTPStubsStatModificationTime(fileStat) ((fileStat)->st_mtimespec)
+#else
+#define HTTPStubsStatModificationTime(fileStat) ((fileStat)->st_mtim)
+#endif
+
+// Each watched entry keeps a file descriptor open to be notified of changes,
+// so we only cache that many files at once. Other files are still served,
+// but their metadata are read from the file system every time.
+static NSUInteger const kMaxCachedFiles = 128;
+
+static unsigned long const kWatchedFileEvents = DISPATCH_VNODE_DELETE | DISPATCH_VNODE_WRITE | DISPATCH_VNODE_EXTEND
+                                              | DISPATCH_VNODE_ATTRIB | DISPATCH_VNODE_LINK | DISPATCH_VNODE_RENAME
+                                              | DISPATCH_VNODE_REVOKE;
+
+// Guards the cache dictionary. A cache hit only takes this lock: no system call at all.
+static pthread_mutex_t sCacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Private Interface
+
+@interface HTTPStubsFileMetadata ()
+// The raw modification time, only compared to the one of the file for entries without a watcher
+@property(nonatomic, assign) struct timespec modificationTime;
+// Drops the entry as soon as the file changes. nil if no vnode source could be created for the file,
+// in which case the entry is checked against a stat(2) of the file on each lookup instead.
+@property(nonatomic, strong, nullable) dispatch_source_t watcher;
+@end
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Implementation
+
+@implementation HTTPStubsFileMetadata
+
++(NSMutableDictionary*)cache
+{
+    static NSMutableDictionary* cache = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        cache = [NSMutableDictionary new];
+    });
+    return cache;
+}
+
++(dispatch_queue_t)watcherQueue
+{
+    static dispatch_queue_t queue = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        queue = dispatch_queue_create("com.alisoftware.OHHTTPStubs.file-metadata", DISPATCH_QUEUE_SERIAL);
+    });
+    return queue;
+}
+
+-(instancetype)initWithStat:(const struct stat*)fileStat
+{
+    self = [super init];
+    if (self)
+    {
+        struct timespec modificationTime = HTTPStubsStatModificationTime(fileStat);
+        _fileSize = (unsigned long long)fileStat->st_size;
+        _modificationTime = modificationTime;
+        _modificationDate = [NSDate dateWithTimeIntervalSince1970:(NSTimeInterval)modificationTime.tv_sec
+                                                                  + (NSTimeInterval)modificationTime.tv_nsec / NSEC_PER_SEC];
+        _inode = (unsigned long long)fileStat->st_ino;
+    }
+    return self;
+}
+
+-(BOOL)matchesStat:(const struct stat*)fileStat
+{
+    struct timespec modificationTime = HTTPStubsStatModificationTime(fileStat);
+    return self.inode == (unsigned long long)fileStat->st_ino
+        && self.fileSize == (unsigned long long)fileStat->st_size
+        && self.modificationTime.tv_sec == modificationTime.tv_sec
+        && self.modificationTime.tv_nsec == modificationTime.tv_nsec;
+}
+
++(nullable instancetype)metadataForFileURL:(NSURL*)fileURL error:(NSError**)error
+{
+    NSString* path = fileURL.path;
+    NSMutableDictionary* cache = self.cache;
+
+    HTTPStubsFileMetadata* cachedMetadata = nil;
+    if (path)
+    {
+        pthread_mutex_lock(&sCacheLock);
+        cachedMetadata = cache[path];
+        pthread_mutex_unlock(&sCacheLock);
+    }
+    if (cachedMetadata.watcher)
+    {
+        // Still watched, so the file hasn't changed since the entry was built
+        return cachedMetadata;
+    }
+    struct stat fileStat;
+    if (cachedMetadata && stat(path.fileSystemRepresentation, &fileStat) == 0 && [cachedMetadata matchesStat:&fileStat])
+    {
+        // Unwatched entry, still up to date
+        return cachedMetadata;
+    }
+
+    // Open the file first and then read its metadata from the descriptor, so that the
+    // watcher is notified of any change happening after the metadata have been read.
+    int fd = path ? open(path.fileSystemRepresentation, O_EVTONLY) : -1;
+    if (fd < 0 || fstat(fd, &fileStat) != 0)
+    {
+        int errorCode = path ? errno : ENOENT;
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        if (path)
+        {
+            [self invalidateMetadataForPath:path];
+        }
+        if (error)
+        {
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errorCode userInfo:@{NSURLErrorKey: fileURL}];
+        }
+        return nil;
+    }
+
+    HTTPStubsFileMetadata* metadata = [[self alloc] initWithStat:&fileStat];
+    HTTPStubsFileMetadata* replacedMetadata = nil;
+    pthread_mutex_lock(&sCacheLock);
+    HTTPStubsFileMetadata* currentMetadata = cache[path];
+    if (currentMetadata.watcher)
+    {
+        // Another thread cached (and watches) this file in the meantime
+        metadata = currentMetadata;
+    }
+    else if (currentMetadata || cache.count < kMaxCachedFiles)
+    {
+        dispatch_source_t watcher = dispatch_source_create(DISPATCH_SOURCE_TYPE_VNODE, (uintptr_t)fd, kWatchedFileEvents, self.watcherQueue);
+        if (watcher)
+        {
+            __weak HTTPStubsFileMetadata* weakMetadata = metadata;
+            dispatch_source_set_event_handler(watcher, ^{
+                HTTPStubsFileMetadata* changedMetadata = weakMetadata;
+                if (changedMetadata)
+                {
+                    [HTTPStubsFileMetadata invalidateMetadata:changedMetadata forPath:path];
+                }
+            });
+            dispatch_source_set_cancel_handler(watcher, ^{
+                close(fd);
+            });
+            metadata.watcher = watcher;
+            dispatch_resume(watcher);
+            fd = -1; // now owned by the watcher
+        }
+        replacedMetadata = currentMetadata;
+        cache[path] = metadata;
+    }
+    pthread_mutex_unlock(&sCacheLock);
+
+    if (replacedMetadata.watcher)
+    {
+        dispatch_source_cancel(replacedMetadata.watcher);
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    return metadata;
+}
+
++(void)invalidateMetadataForFileURL:(NSURL*)fileURL
+{
+    if (fileURL.path)
+    {
+        [self invalidateMetadataForPath:fileURL.path];
+    }
+}
+
++(void)invalidateMetadataForPath:(NSString*)path
+{
+    [self invalidateMetadata:nil forPath:path];
+}
+
+// Drops the entry for path, only if it still is the given one (any entry if metadata is nil).
++(void)invalidateMetadata:(nullable HTTPStubsFileMetadata*)metadata forPath:(NSString*)path
+{
+    NSMutableDictionary* cache = self.cache;
+    pthread_mutex_lock(&sCacheLock);
+    HTTPStubsFileMetadata* cachedMetadata = cache[path];
+    if (metadata && cachedMetadata != metadata)
+    {
+        cachedMetadata = nil;
+    }
+    if (cachedMetadata)
+    {
+        [cache removeObjectForKey:path];
+    }
+    pthread_mutex_unlock(&sCacheLock);
+
+    if (cachedMetadata.watcher)
+    {
+        dispatch_source_cancel(cachedMetadata.watcher);
+    }
+}
+
++(void)invalidateAllMetadata
+{
+    NSMutableDictionary* cache = self.cache;
+    pthread_mutex_lock(&sCacheLock);
+    NSArray* allMetadata = cache.allValues;
+    [cache removeAllObjects];
+    pthread_mutex_unlock(&sCacheLock);
+
+    for (HTTPStubsFileMetadata* metadata in allMetadata)
+    {
+        if (metadata.watcher)
+        {
+            dispatch_source_cancel(metadata.watcher);
+        }
+    }
+}
+
+-(NSString*)description
+{
+    return [NSString stringWithFormat:@"<%@ %p size:%llu modificationDate:%@ inode:%llu>",
+            self.class, self, self.fileSize, self.modificationDate, self.inode];
+}
+
+@end
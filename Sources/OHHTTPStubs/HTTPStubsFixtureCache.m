@@ -0,0 +1,385 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+#if ! __has_feature(objc_arc)
+#error This file is expected to be compiled with ARC turned ON
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Imports
+
+#import "HTTPStubsFixtureCache.h"
+#import "HTTPStubsFileMetadata.h"
+
+#import <CommonCrypto/CommonDigest.h>
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Defines & Constants
+
+static unsigned long long const kDefaultByteBudget = 64 * 1024 * 1024;
+static NSUInteger const kDefaultMinimumDataLength = 1024;
+
+// Not using the UIKit constant, so that we don't have to link against UIKit
+static NSString* const kMemoryWarningNotification = @"UIApplicationDidReceiveMemoryWarningNotification";
+
+static NSData* HTTPStubsContentHash(NSData* data)
+{
+    __block CC_SHA256_CTX context;
+    CC_SHA256_Init(&context);
+    [data enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
+        CC_SHA256_Update(&context, bytes, (CC_LONG)byteRange.length);
+    }];
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256_Final(digest, &context);
+    return [NSData dataWithBytes:digest length:CC_SHA256_DIGEST_LENGTH];
+}
+
+static NSString* HTTPStubsFixtureCacheFileKey(NSString* path, unsigned long long offset, BOOL decoded)
+{
+    return [NSString stringWithFormat:@"%@#%llu%@", path, offset, decoded ? @"+decoded" : @""];
+}
+
+static NSData* HTTPStubsFixtureCacheReadFile(NSURL* fileURL, unsigned long long offset, NSError** error)
+{
+    if (offset == 0)
+    {
+        return [NSData dataWithContentsOfURL:fileURL options:0 error:error];
+    }
+    NSFileHandle* fileHandle = [NSFileHandle fileHandleForReadingFromURL:fileURL error:error];
+    [fileHandle seekToFileOffset:offset];
+    NSData* data = [fileHandle readDataToEndOfFile];
+    [fileHandle closeFile];
+    return data;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Private Interfaces
+
+// A cached body, linked to its neighbours in least-recently-used order
+@interface HTTPStubsFixtureCacheEntry : NSObject
+@property(nonatomic, strong) NSData* contentHash;
+@property(nonatomic, strong) NSData* data;
+@property(nonatomic, weak) HTTPStubsFixtureCacheEntry* previous;
+@property(nonatomic, strong) HTTPStubsFixtureCacheEntry* next;
+// The keys of the file entries whose cached content is this body
+@property(nonatomic, strong) NSMutableSet<NSString*>* fileKeys;
+@end
+
+@implementation HTTPStubsFixtureCacheEntry @end
+
+// The cached content of a file region, valid as long as the file keeps the same metadata
+@interface HTTPStubsFixtureCacheFileEntry : NSObject
+@property(nonatomic, strong) NSData* contentHash;
+@property(nonatomic, strong) HTTPStubsFileMetadata* metadata;
+@end
+
+@implementation HTTPStubsFixtureCacheFileEntry @end
+
+@interface HTTPStubsFixtureCache ()
+@property(atomic, assign, readwrite) unsigned long long totalBytes;
+@property(atomic, assign, readwrite) NSUInteger hitCount;
+@property(atomic, assign, readwrite) NSUInteger missCount;
+@property(atomic, assign, readwrite) NSUInteger evictionCount;
+@end
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Implementation
+
+@implementation HTTPStubsFixtureCache
+{
+    NSMutableDictionary<NSData*, HTTPStubsFixtureCacheEntry*>* _entries;
+    // Keyed by path, offset and whether the content is decoded (see HTTPStubsFixtureCacheFileKey)
+    NSMutableDictionary<NSString*, HTTPStubsFixtureCacheFileEntry*>* _fileEntries;
+    HTTPStubsFixtureCacheEntry* _mostRecentlyUsed;
+    HTTPStubsFixtureCacheEntry* _leastRecentlyUsed;
+    dispatch_source_t _memoryPressureSource;
+}
+
++(instancetype)sharedCache
+{
+    static HTTPStubsFixtureCache *sharedCache = nil;
+
+    static dispatch_once_t predicate;
+    dispatch_once(&predicate, ^{
+        sharedCache = [[self alloc] init];
+    });
+
+    return sharedCache;
+}
+
+-(instancetype)init
+{
+    return [self initWithByteBudget:kDefaultByteBudget];
+}
+
+-(instancetype)initWithByteBudget:(unsigned long long)byteBudget
+{
+    self = [super init];
+    if (self)
+    {
+        _byteBudget = byteBudget;
+        _minimumDataLength = kDefaultMinimumDataLength;
+        _entries = [NSMutableDictionary new];
+        _fileEntries = [NSMutableDictionary new];
+
+        __weak __typeof__(self) weakSelf = self;
+        _memoryPressureSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0,
+                                                       DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL,
+                                                       dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
+        dispatch_source_t source = _memoryPressureSource;
+        dispatch_source_set_event_handler(_memoryPressureSource, ^{
+            if (dispatch_source_get_data(source) & DISPATCH_MEMORYPRESSURE_CRITICAL)
+            {
+                [weakSelf removeAllData];
+            }
+            else
+            {
+                [weakSelf trimToByteSize:weakSelf.byteBudget / 2];
+            }
+        });
+        dispatch_resume(_memoryPressureSource);
+
+        [NSNotificationCenter.defaultCenter addObserver:self
+                                               selector:@selector(didReceiveMemoryWarning:)
+                                                   name:kMemoryWarningNotification
+                                                 object:nil];
+    }
+    return self;
+}
+
+-(void)dealloc
+{
+    [NSNotificationCenter.defaultCenter removeObserver:self];
+    dispatch_source_cancel(_memoryPressureSource);
+}
+
+-(void)didReceiveMemoryWarning:(NSNotification*)notification
+{
+    [self removeAllData];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Lookups
+
+-(NSData*)cachedDataForData:(NSData*)data
+{
+    if (data.length < self.minimumDataLength || data.length > self.byteBudget)
+    {
+        return data;
+    }
+    return [self cachedDataForData:data contentHash:HTTPStubsContentHash(data)];
+}
+
+-(NSData*)cachedDataForData:(NSData*)data contentHash:(NSData*)contentHash
+{
+    @synchronized(self)
+    {
+        HTTPStubsFixtureCacheEntry* entry = _entries[contentHash];
+        if (entry && entry.data.length == data.length)
+        {
+            self.hitCount += 1;
+            [self touchEntry:entry];
+            return entry.data;
+        }
+
+        self.missCount += 1;
+        entry = [HTTPStubsFixtureCacheEntry new];
+        entry.contentHash = contentHash;
+        entry.data = [data copy];
+        entry.fileKeys = [NSMutableSet new];
+        _entries[contentHash] = entry;
+        [self touchEntry:entry];
+        self.totalBytes += entry.data.length;
+        [self trimToByteSize:self.byteBudget];
+        return entry.data;
+    }
+}
+
+-(nullable NSData*)dataWithContentsOfFileURL:(NSURL*)fileURL error:(NSError**)error
+{
+    return [self dataWithContentsOfFileURL:fileURL offset:0 decoder:nil error:error];
+}
+
+-(nullable NSData*)dataWithContentsOfFileURL:(NSURL*)fileURL
+                                      offset:(unsigned long long)offset
+                                     decoder:(nullable HTTPStubsFixtureDecoder)decoder
+                                       error:(NSError**)error
+{
+    HTTPStubsFileMetadata* metadata = [HTTPStubsFileMetadata metadataForFileURL:fileURL error:error];
+    if (!metadata)
+    {
+        return nil;
+    }
+
+    NSString* fileKey = HTTPStubsFixtureCacheFileKey(fileURL.path, offset, decoder != nil);
+    @synchronized(self)
+    {
+        HTTPStubsFixtureCacheFileEntry* fileEntry = _fileEntries[fileKey];
+        HTTPStubsFixtureCacheEntry* entry = fileEntry ? _entries[fileEntry.contentHash] : nil;
+        if (entry && fileEntry.metadata.inode == metadata.inode
+            && fileEntry.metadata.fileSize == metadata.fileSize
+            && [fileEntry.metadata.modificationDate isEqualToDate:metadata.modificationDate])
+        {
+            self.hitCount += 1;
+            [self touchEntry:entry];
+            return entry.data;
+        }
+    }
+
+    NSData* data = HTTPStubsFixtureCacheReadFile(fileURL, offset, error);
+    if (data && decoder)
+    {
+        data = decoder(data);
+    }
+    if (!data || data.length < self.minimumDataLength || data.length > self.byteBudget)
+    {
+        return data;
+    }
+
+    NSData* contentHash = HTTPStubsContentHash(data);
+    HTTPStubsFixtureCacheFileEntry* fileEntry = [HTTPStubsFixtureCacheFileEntry new];
+    fileEntry.contentHash = contentHash;
+    fileEntry.metadata = metadata;
+    @synchronized(self)
+    {
+        [self removeFileEntryForKey:fileKey];
+        NSData* cachedData = [self cachedDataForData:data contentHash:contentHash];
+        // The body may already be evicted if it alone is over the budget
+        HTTPStubsFixtureCacheEntry* entry = _entries[contentHash];
+        if (entry)
+        {
+            _fileEntries[fileKey] = fileEntry;
+            [entry.fileKeys addObject:fileKey];
+        }
+        return cachedData;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Eviction
+
+-(void)removeAllData
+{
+    @synchronized(self)
+    {
+        self.evictionCount += _entries.count;
+        [_entries removeAllObjects];
+        [_fileEntries removeAllObjects];
+        _mostRecentlyUsed = nil;
+        _leastRecentlyUsed = nil;
+        self.totalBytes = 0;
+    }
+}
+
+-(void)resetStatistics
+{
+    @synchronized(self)
+    {
+        self.hitCount = 0;
+        self.missCount = 0;
+        self.evictionCount = 0;
+    }
+}
+
+-(void)trimToByteSize:(unsigned long long)byteSize
+{
+    @synchronized(self)
+    {
+        while (self.totalBytes > byteSize && _leastRecentlyUsed)
+        {
+            HTTPStubsFixtureCacheEntry* entry = _leastRecentlyUsed;
+            [self unlinkEntry:entry];
+            [_entries removeObjectForKey:entry.contentHash];
+            [_fileEntries removeObjectsForKeys:entry.fileKeys.allObjects];
+            self.totalBytes -= entry.data.length;
+            self.evictionCount += 1;
+        }
+    }
+}
+
+// Must be called while holding the lock
+-(void)removeFileEntryForKey:(NSString*)fileKey
+{
+    HTTPStubsFixtureCacheFileEntry* fileEntry = _fileEntries[fileKey];
+    if (fileEntry)
+    {
+        [_entries[fileEntry.contentHash].fileKeys removeObject:fileKey];
+        [_fileEntries removeObjectForKey:fileKey];
+    }
+}
+
+// Must be called while holding the lock
+-(void)touchEntry:(HTTPStubsFixtureCacheEntry*)entry
+{
+    if (entry == _mostRecentlyUsed)
+    {
+        return;
+    }
+    [self unlinkEntry:entry];
+    entry.next = _mostRecentlyUsed;
+    _mostRecentlyUsed.previous = entry;
+    _mostRecentlyUsed = entry;
+    if (!_leastRecentlyUsed)
+    {
+        _leastRecentlyUsed = entry;
+    }
+}
+
+// Must be called while holding the lock
+-(void)unlinkEntry:(HTTPStubsFixtureCacheEntry*)entry
+{
+    HTTPStubsFixtureCacheEntry* previous = entry.previous;
+    HTTPStubsFixtureCacheEntry* next = entry.next;
+    previous.next = next;
+    next.previous = previous;
+    if (entry == _mostRecentlyUsed)
+    {
+        _mostRecentlyUsed = next;
+    }
+    if (entry == _leastRecentlyUsed)
+    {
+        _leastRecentlyUsed = previous;
+    }
+    entry.previous = nil;
+    entry.next = nil;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Statistics
+
+-(double)hitRate
+{
+    NSUInteger hits = self.hitCount;
+    NSUInteger lookups = hits + self.missCount;
+    return lookups > 0 ? (double)hits / (double)lookups : 0;
+}
+
+-(NSString*)description
+{
+    return [NSString stringWithFormat:@"<%@ %p bodies:%lu bytes:%llu/%llu hitRate:%.1f%% (%lu hits, %lu misses) evictions:%lu>",
+            self.class, self, (unsigned long)_entries.count, self.totalBytes, self.byteBudget,
+            self.hitRate * 100, (unsigned long)self.hitCount, (unsigned long)self.missCount, (unsigned long)self.evictionCount];
+}
+
+@end
@@ -0,0 +1,162 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#if ! __has_feature(objc_arc)
+#error This file is expected to be compiled with ARC turned ON
+#endif
+
+#import "HTTPStubsResponse+EventStream.h"
+
+static NSDictionary* HTTPStubsHeadersWithContentType(NSDictionary* httpHeaders, NSString* contentType)
+{
+    if (httpHeaders[@"Content-Type"])
+    {
+        return httpHeaders;
+    }
+    NSMutableDictionary* mutableHeaders = [NSMutableDictionary dictionaryWithDictionary:httpHeaders];
+    mutableHeaders[@"Content-Type"] = contentType;
+    return [NSDictionary dictionaryWithDictionary:mutableHeaders]; // make immutable again
+}
+
+@implementation HTTPStubsServerSentEvent
+
++(instancetype)eventWithData:(NSString*)data delay:(NSTimeInterval)delay
+{
+    HTTPStubsServerSentEvent* event = [self new];
+    event.data = data;
+    event.delay = delay;
+    return event;
+}
+
+-(NSData*)serializedData
+{
+    NSMutableString* message = [NSMutableString new];
+    if (self.identifier)
+    {
+        [message appendFormat:@"id: %@\n", self.identifier];
+    }
+    if (self.name)
+    {
+        [message appendFormat:@"event: %@\n", self.name];
+    }
+    if (self.retry > 0)
+    {
+        [message appendFormat:@"retry: %.0f\n", self.retry * 1000];
+    }
+    if (self.data)
+    {
+        NSString* data = [self.data stringByReplacingOccurrencesOfString:@"\r\n" withString:@"\n"];
+        for (NSString* line in [data componentsSeparatedByString:@"\n"])
+        {
+            [message appendFormat:@"data: %@\n", line];
+        }
+    }
+    [message appendString:@"\n"];
+    return [message dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+@end
+
+@implementation HTTPStubsResponse (EventStream)
+
+/*! @name Building streaming responses */
+
++(instancetype)responseWithServerSentEvents:(NSArray<HTTPStubsServerSentEvent*>*)events
+                                 statusCode:(int)statusCode
+                                    headers:(nullable NSDictionary*)httpHeaders
+{
+    NSArray* eventsCopy = [events copy];
+    return [self responseWithServerSentEventProvider:^HTTPStubsServerSentEvent*(NSUInteger index) {
+        return index < eventsCopy.count ? eventsCopy[index] : nil;
+    } statusCode:statusCode headers:httpHeaders];
+}
+
++(instancetype)responseWithServerSentEventProvider:(HTTPStubsServerSentEvent* __nullable (^)(NSUInteger index))eventProvider
+                                        statusCode:(int)statusCode
+                                           headers:(nullable NSDictionary*)httpHeaders
+{
+    NSMutableDictionary* headers = [HTTPStubsHeadersWithContentType(httpHeaders, @"text/event-stream") mutableCopy];
+    if (!headers[@"Cache-Control"])
+    {
+        headers[@"Cache-Control"] = @"no-cache";
+    }
+
+    __block NSUInteger index = 0;
+    return [self responseWithFrameProvider:^NSData*(NSTimeInterval* delay) {
+        HTTPStubsServerSentEvent* event = eventProvider(index++);
+        *delay = event.delay;
+        return [event serializedData];
+    } statusCode:statusCode headers:headers];
+}
+
++(instancetype)responseWithJSONLines:(NSArray*)jsonObjects
+                            interval:(NSTimeInterval)interval
+                          statusCode:(int)statusCode
+                             headers:(nullable NSDictionary*)httpHeaders
+{
+    NSArray* objectsCopy = [jsonObjects copy];
+    return [self responseWithJSONLineProvider:^id(NSUInteger index, NSTimeInterval* delay) {
+        *delay = interval;
+        return index < objectsCopy.count ? objectsCopy[index] : nil;
+    } statusCode:statusCode headers:httpHeaders];
+}
+
++(instancetype)responseWithJSONLineProvider:(id __nullable (^)(NSUInteger index, NSTimeInterval* delay))jsonObjectProvider
+                                 statusCode:(int)statusCode
+                                    headers:(nullable NSDictionary*)httpHeaders
+{
+    static NSData* newline;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        newline = [NSData dataWithBytes:"\n" length:1];
+    });
+
+    __block NSUInteger index = 0;
+    HTTPStubsResponse* response = [self responseWithFrameProvider:^NSData*(NSTimeInterval* delay) { return nil; }
+                                                       statusCode:statusCode
+                                                          headers:HTTPStubsHeadersWithContentType(httpHeaders, @"application/x-ndjson")];
+    __weak HTTPStubsResponse* weakResponse = response;
+    response.frameProvider = ^NSData*(NSTimeInterval* delay) {
+        id jsonObject = jsonObjectProvider(index++, delay);
+        if (!jsonObject)
+        {
+            return nil;
+        }
+        // dataWithJSONObject: raises on invalid objects: fail the response instead
+        if (![NSJSONSerialization isValidJSONObject:jsonObject])
+        {
+            weakResponse.error = [NSError errorWithDomain:NSCocoaErrorDomain
+                                                     code:NSPropertyListWriteInvalidError
+                                                 userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Invalid JSON object at index %lu: %@", (unsigned long)(index - 1), jsonObject]}];
+            return nil;
+        }
+        NSMutableData* line = [[NSJSONSerialization dataWithJSONObject:jsonObject options:0 error:nil] mutableCopy];
+        [line appendData:newline];
+        return line;
+    };
+    return response;
+}
+
+@end
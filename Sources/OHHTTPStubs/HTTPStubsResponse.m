@@ -30,6 +30,8 @@
 #pragma mark - Imports
 
 #import "HTTPStubsResponse.h"
+#import "HTTPStubsFileMetadata.h"
+#import "HTTPStubsFixtureCache.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 #pragma mark - Defines & Constants
@@ -41,6 +43,8 @@ const double OHHTTPStubsDownloadSpeed3G     =-  3200 / 8; // kbps -> KB/s
 const double OHHTTPStubsDownloadSpeed3GPlus =-  7200 / 8; // kbps -> KB/s
 const double OHHTTPStubsDownloadSpeedWifi   =- 12000 / 8; // kbps -> KB/s
 
+const unsigned long long OHHTTPStubsUnknownDataSize = ULLONG_MAX;
+
 ////////////////////////////////////////////////////////////////////////////////
 #pragma mark - Implementation
 
@@ -85,6 +89,30 @@ const double OHHTTPStubsDownloadSpeedWifi   =- 12000 / 8; // kbps -> KB/s
     return response;
 }
 
++(instancetype)responseWithFileURL:(NSURL *)fileURL
+                            offset:(unsigned long long)offset
+                        statusCode:(int)statusCode
+                           headers:(nullable NSDictionary *)httpHeaders
+{
+    HTTPStubsResponse* response = [[self alloc] initWithFileURL:fileURL
+                                                         offset:offset
+                                                     statusCode:statusCode
+                                                        headers:httpHeaders];
+    return response;
+}
+
+#pragma mark > Building a streamed response
+
++(instancetype)responseWithFrameProvider:(HTTPStubsFrameProvider)frameProvider
+                              statusCode:(int)statusCode
+                                 headers:(nullable NSDictionary*)httpHeaders
+{
+    HTTPStubsResponse* response = [[self alloc] initWithFrameProvider:frameProvider
+                                                           statusCode:statusCode
+                                                              headers:httpHeaders];
+    return response;
+}
+
 #pragma mark > Building an error response
 
 +(instancetype)responseWithError:(NSError*)error
@@ -131,7 +159,7 @@ const double OHHTTPStubsDownloadSpeedWifi   =- 12000 / 8; // kbps -> KB/s
         _statusCode = statusCode;
         NSMutableDictionary * headers = [NSMutableDictionary dictionaryWithDictionary:httpHeaders];
         static NSString *const ContentLengthHeader = @"Content-Length";
-        if (!headers[ContentLengthHeader])
+        if (!headers[ContentLengthHeader] && _dataSize != OHHTTPStubsUnknownDataSize)
         {
             headers[ContentLengthHeader] = [NSString stringWithFormat:@"%llu",_dataSize];
         }
@@ -154,6 +182,16 @@ const double OHHTTPStubsDownloadSpeedWifi   =- 12000 / 8; // kbps -> KB/s
 -(instancetype)initWithFileURL:(NSURL *)fileURL
                     statusCode:(int)statusCode
                        headers:(nullable NSDictionary *)httpHeaders {
+    return [self initWithFileURL:fileURL
+                          offset:0
+                      statusCode:statusCode
+                         headers:httpHeaders];
+}
+
+-(instancetype)initWithFileURL:(NSURL *)fileURL
+                        offset:(unsigned long long)offset
+                    statusCode:(int)statusCode
+                       headers:(nullable NSDictionary *)httpHeaders {
     if (!fileURL) {
         NSLog(@"%s: nil file path. Returning empty data", __PRETTY_FUNCTION__);
         return [self initWithInputStream:[NSInputStream inputStreamWithData:[NSData data]]
@@ -165,18 +203,39 @@ const double OHHTTPStubsDownloadSpeedWifi   =- 12000 / 8; // kbps -> KB/s
     // [NSURL -isFileURL] is only available on iOS 8+
     NSAssert([fileURL.scheme isEqualToString:NSURLFileScheme], @"%s: Only file URLs may be passed to this method.",__PRETTY_FUNCTION__);
 
-    NSNumber *fileSize;
+    // Metadata are cached process-wide, so that stubs building their response from
+    // the same file on each request don't have to hit the file system every time.
     NSError *error;
-    const BOOL success __unused = [fileURL getResourceValue:&fileSize forKey:NSURLFileSizeKey error:&error];
+    HTTPStubsFileMetadata *metadata = [HTTPStubsFileMetadata metadataForFileURL:fileURL error:&error];
 
-    NSAssert(success && fileSize, @"%s Couldn't get the file size for URL. \
+    NSAssert(metadata, @"%s Couldn't get the file size for URL. \
 The URL was: %@. \
-The operation to retrieve the file size was %@. \
 The error associated with that operation was: %@",
-             __PRETTY_FUNCTION__, fileURL, success ? @"successful" : @"unsuccessful", error);
+             __PRETTY_FUNCTION__, fileURL, error);
+
+    unsigned long long dataSize = (metadata.fileSize > offset) ? metadata.fileSize - offset : 0;
+    HTTPStubsFixtureCache* fixtureCache = HTTPStubsFixtureCache.sharedCache;
+    if (fixtureCache.enabled && dataSize >= fixtureCache.minimumDataLength && dataSize <= fixtureCache.byteBudget)
+    {
+        // Only hold the shared body while this response is sent, so that the cache can evict it
+        NSData* data = [fixtureCache dataWithContentsOfFileURL:fileURL offset:offset decoder:nil error:NULL];
+        if (data)
+        {
+            return [self initWithInputStream:[NSInputStream inputStreamWithData:data]
+                                    dataSize:data.length
+                                  statusCode:statusCode
+                                     headers:httpHeaders];
+        }
+    }
 
-    return [self initWithInputStream:[NSInputStream inputStreamWithURL:fileURL]
-                            dataSize:[fileSize unsignedLongLongValue]
+    NSInputStream* inputStream = [NSInputStream inputStreamWithURL:fileURL];
+    if (offset > 0)
+    {
+        // Only honored before the stream is opened
+        [inputStream setProperty:@(offset) forKey:NSStreamFileCurrentOffsetKey];
+    }
+    return [self initWithInputStream:inputStream
+                            dataSize:dataSize
                           statusCode:statusCode
                              headers:httpHeaders];
 }
@@ -193,6 +252,21 @@ The error associated with that operation was: %@",
     return self;
 }
 
+-(instancetype)initWithFrameProvider:(HTTPStubsFrameProvider)frameProvider
+                          statusCode:(int)statusCode
+                             headers:(nullable NSDictionary*)httpHeaders
+{
+    self = [self initWithInputStream:[NSInputStream inputStreamWithData:[NSData data]]
+                            dataSize:OHHTTPStubsUnknownDataSize
+                          statusCode:statusCode
+                             headers:httpHeaders];
+    if (self)
+    {
+        _frameProvider = [frameProvider copy];
+    }
+    return self;
+}
+
 -(instancetype)initWithError:(NSError*)error
 {
     self = [super init];
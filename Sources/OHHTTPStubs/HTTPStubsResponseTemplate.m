@@ -0,0 +1,387 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#if ! __has_feature(objc_arc)
+#error This file is expected to be compiled with ARC turned ON
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Imports
+
+#import "HTTPStubsResponseTemplate.h"
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Defines & Constants
+
+static NSString* const kRequestPlaceholderPrefix = @"request.";
+
+typedef NSData* __nonnull (^HTTPStubsTemplateResolver)(NSString* placeholder);
+
+static NSString* HTTPStubsTemplateRequestValue(NSString* placeholder, NSURLRequest* request)
+{
+    if (![placeholder hasPrefix:kRequestPlaceholderPrefix])
+    {
+        return nil;
+    }
+    NSString* key = [placeholder substringFromIndex:kRequestPlaceholderPrefix.length];
+    NSURL* url = request.URL;
+
+    if ([key isEqualToString:@"method"]) return request.HTTPMethod;
+    if ([key isEqualToString:@"url"]) return url.absoluteString;
+    if ([key isEqualToString:@"host"]) return url.host;
+    if ([key isEqualToString:@"path"]) return url.path;
+
+    if ([key hasPrefix:@"path."])
+    {
+        NSString* indexString = [key substringFromIndex:@"path.".length];
+        NSInteger index = indexString.integerValue;
+        NSMutableArray* components = [url.pathComponents mutableCopy];
+        [components removeObject:@"/"];
+        if ([indexString isEqualToString:@(index).stringValue] && index >= 0 && (NSUInteger)index < components.count)
+        {
+            return components[index];
+        }
+        return nil;
+    }
+    if ([key hasPrefix:@"query."])
+    {
+        NSString* name = [key substringFromIndex:@"query.".length];
+        NSURLComponents* components = [NSURLComponents componentsWithURL:url resolvingAgainstBaseURL:NO];
+        for (NSURLQueryItem* item in components.queryItems)
+        {
+            if ([item.name isEqualToString:name])
+            {
+                return item.value;
+            }
+        }
+        return nil;
+    }
+    if ([key hasPrefix:@"header."])
+    {
+        return [request valueForHTTPHeaderField:[key substringFromIndex:@"header.".length]];
+    }
+    return nil;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Template Segments
+
+// A piece of the template: either a range of literal bytes, or a placeholder
+@interface HTTPStubsTemplateSegment : NSObject
+@property(nonatomic, assign) NSRange range;
+@property(nonatomic, copy, nullable) NSString* placeholder;
+@end
+
+@implementation HTTPStubsTemplateSegment
+@end
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Streaming Body
+
+// Produces the substituted body on demand, reading the literal parts straight from the template bytes
+@interface HTTPStubsTemplateInputStream : NSInputStream
+@property(nonatomic, assign) NSStreamStatus streamStatus;
+@property(nonatomic, strong, nullable) NSError* streamError;
+@property(nonatomic, weak, nullable) id<NSStreamDelegate> delegate;
+-(instancetype)initWithTemplateData:(NSData*)data
+                           segments:(NSArray<HTTPStubsTemplateSegment*>*)segments
+                           resolver:(HTTPStubsTemplateResolver)resolver;
+@end
+
+@implementation HTTPStubsTemplateInputStream
+{
+    NSData* _templateData;
+    NSArray<HTTPStubsTemplateSegment*>* _segments;
+    HTTPStubsTemplateResolver _resolver;
+    NSUInteger _segmentIndex;
+    NSData* _currentData; // The template data for a literal segment, the value for a placeholder
+    NSRange _currentRange; // What remains to send from _currentData
+}
+@synthesize streamStatus = _streamStatus;
+@synthesize streamError = _streamError;
+@synthesize delegate = _delegate;
+
+-(instancetype)initWithTemplateData:(NSData*)data
+                           segments:(NSArray<HTTPStubsTemplateSegment*>*)segments
+                           resolver:(HTTPStubsTemplateResolver)resolver
+{
+    self = [super init];
+    if (self)
+    {
+        _templateData = data;
+        _segments = segments;
+        _resolver = [resolver copy];
+        _streamStatus = NSStreamStatusNotOpen;
+    }
+    return self;
+}
+
+// Moves to the next segment having bytes to send. Returns NO at the end of the template.
+-(BOOL)prepareCurrentSegment
+{
+    while (_currentRange.length == 0)
+    {
+        if (_segmentIndex >= _segments.count)
+        {
+            return NO;
+        }
+        HTTPStubsTemplateSegment* segment = _segments[_segmentIndex++];
+        if (segment.placeholder)
+        {
+            _currentData = _resolver(segment.placeholder);
+            _currentRange = NSMakeRange(0, _currentData.length);
+        }
+        else
+        {
+            _currentData = _templateData;
+            _currentRange = segment.range;
+        }
+    }
+    return YES;
+}
+
+-(void)open
+{
+    self.streamStatus = NSStreamStatusOpen;
+}
+
+-(void)close
+{
+    self.streamStatus = NSStreamStatusClosed;
+    _currentData = nil;
+}
+
+// Side-effect free: placeholders are only resolved by read:maxLength:, so that polling the stream never runs the
+// value blocks. Trailing empty segments make the last read return 0, which readers already handle as the end.
+-(BOOL)hasBytesAvailable
+{
+    return self.streamStatus == NSStreamStatusOpen;
+}
+
+-(NSInteger)read:(uint8_t *)buffer maxLength:(NSUInteger)len
+{
+    if (self.streamStatus != NSStreamStatusOpen)
+    {
+        return (self.streamStatus == NSStreamStatusAtEnd) ? 0 : -1;
+    }
+
+    NSUInteger totalRead = 0;
+    // Keep going through the segments even if some are empty, as returning 0 means EOF
+    while (totalRead < len && [self prepareCurrentSegment])
+    {
+        NSUInteger length = MIN(len - totalRead, _currentRange.length);
+        [_currentData getBytes:buffer + totalRead range:NSMakeRange(_currentRange.location, length)];
+        _currentRange.location += length;
+        _currentRange.length -= length;
+        totalRead += length;
+    }
+    if (totalRead < len)
+    {
+        self.streamStatus = NSStreamStatusAtEnd;
+        _currentData = nil;
+    }
+    return (NSInteger)totalRead;
+}
+
+-(BOOL)getBuffer:(uint8_t * _Nullable *)buffer length:(NSUInteger *)len
+{
+    return NO;
+}
+
+-(id)propertyForKey:(NSStreamPropertyKey)key
+{
+    return nil;
+}
+
+-(BOOL)setProperty:(id)property forKey:(NSStreamPropertyKey)key
+{
+    return NO;
+}
+
+-(void)scheduleInRunLoop:(NSRunLoop *)aRunLoop forMode:(NSRunLoopMode)mode
+{
+}
+
+-(void)removeFromRunLoop:(NSRunLoop *)aRunLoop forMode:(NSRunLoopMode)mode
+{
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Implementation
+
+@implementation HTTPStubsResponseTemplate
+{
+    NSData* _data;
+    NSArray<HTTPStubsTemplateSegment*>* _segments;
+    unsigned long long _literalLength;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Commodity Constructors
+
++(instancetype)templateWithData:(NSData*)data
+{
+    return [[self alloc] initWithData:data];
+}
+
++(instancetype)templateWithContentsOfFileURL:(NSURL*)fileURL error:(NSError**)error
+{
+    NSData* data = [NSData dataWithContentsOfURL:fileURL options:0 error:error];
+    return data ? [[self alloc] initWithData:data] : nil;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Initializers
+
+-(instancetype)initWithData:(NSData*)data
+{
+    self = [super init];
+    if (self)
+    {
+        _data = [data copy];
+        [self parseTemplate];
+    }
+    return self;
+}
+
+-(void)parseTemplate
+{
+    NSMutableArray<HTTPStubsTemplateSegment*>* segments = [NSMutableArray new];
+    NSMutableOrderedSet<NSString*>* placeholders = [NSMutableOrderedSet new];
+    const char* bytes = _data.bytes;
+    NSUInteger length = _data.length;
+    NSUInteger literalStart = 0;
+    NSUInteger cursor = 0;
+    _literalLength = 0;
+
+    void(^addLiteral)(NSUInteger) = ^(NSUInteger end) {
+        if (end > literalStart)
+        {
+            HTTPStubsTemplateSegment* segment = [HTTPStubsTemplateSegment new];
+            segment.range = NSMakeRange(literalStart, end - literalStart);
+            [segments addObject:segment];
+            self->_literalLength += segment.range.length;
+        }
+    };
+
+    while (cursor + 1 < length)
+    {
+        if (bytes[cursor] != '{' || bytes[cursor+1] != '{')
+        {
+            cursor++;
+            continue;
+        }
+        const char* closing = NULL;
+        for (NSUInteger i = cursor + 2; i + 1 < length; i++)
+        {
+            if (bytes[i] == '}' && bytes[i+1] == '}')
+            {
+                closing = bytes + i;
+                break;
+            }
+        }
+        if (!closing)
+        {
+            // Unterminated placeholder: keep the rest of the template as is
+            break;
+        }
+        NSString* name = [[NSString alloc] initWithBytes:bytes + cursor + 2
+                                                  length:(NSUInteger)(closing - bytes) - cursor - 2
+                                                encoding:NSUTF8StringEncoding];
+        name = [name stringByTrimmingCharactersInSet:NSCharacterSet.whitespaceCharacterSet];
+        NSUInteger end = (NSUInteger)(closing - bytes) + 2;
+        if (name.length > 0)
+        {
+            addLiteral(cursor);
+            HTTPStubsTemplateSegment* segment = [HTTPStubsTemplateSegment new];
+            segment.range = NSMakeRange(cursor, end - cursor);
+            segment.placeholder = name;
+            [segments addObject:segment];
+            [placeholders addObject:name];
+            literalStart = end;
+        }
+        cursor = end;
+    }
+    addLiteral(length);
+
+    _segments = [segments copy];
+    _placeholders = placeholders.array;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Responses
+
+-(HTTPStubsResponse*)responseForRequest:(NSURLRequest*)request
+                                 values:(NSDictionary<NSString*, NSString*>*)values
+                             statusCode:(int)statusCode
+                                headers:(NSDictionary*)httpHeaders
+{
+    // Resolve each distinct placeholder once, so that we know the size of the body upfront
+    NSMutableDictionary<NSString*, NSData*>* resolvedValues = [NSMutableDictionary dictionaryWithCapacity:self.placeholders.count];
+    for (NSString* placeholder in self.placeholders)
+    {
+        NSString* value = values[placeholder] ?: HTTPStubsTemplateRequestValue(placeholder, request);
+        resolvedValues[placeholder] = [value dataUsingEncoding:NSUTF8StringEncoding] ?: [NSData data];
+    }
+    unsigned long long dataSize = _literalLength;
+    for (HTTPStubsTemplateSegment* segment in _segments)
+    {
+        if (segment.placeholder)
+        {
+            dataSize += resolvedValues[segment.placeholder].length;
+        }
+    }
+
+    NSInputStream* inputStream = [[HTTPStubsTemplateInputStream alloc] initWithTemplateData:_data
+                                                                                   segments:_segments
+                                                                                   resolver:^NSData*(NSString* placeholder) {
+        return resolvedValues[placeholder];
+    }];
+    return [[HTTPStubsResponse alloc] initWithInputStream:inputStream
+                                                 dataSize:dataSize
+                                               statusCode:statusCode
+                                                  headers:httpHeaders];
+}
+
+-(HTTPStubsResponse*)responseForRequest:(NSURLRequest*)request
+                             valueBlock:(HTTPStubsTemplateValueBlock)valueBlock
+                             statusCode:(int)statusCode
+                                headers:(NSDictionary*)httpHeaders
+{
+    NSInputStream* inputStream = [[HTTPStubsTemplateInputStream alloc] initWithTemplateData:_data
+                                                                                   segments:_segments
+                                                                                   resolver:^NSData*(NSString* placeholder) {
+        NSString* value = valueBlock(placeholder, request) ?: HTTPStubsTemplateRequestValue(placeholder, request);
+        return [value dataUsingEncoding:NSUTF8StringEncoding] ?: [NSData data];
+    }];
+    return [[HTTPStubsResponse alloc] initWithInputStream:inputStream
+                                                 dataSize:OHHTTPStubsUnknownDataSize
+                                               statusCode:statusCode
+                                                  headers:httpHeaders];
+}
+
+@end
@@ -30,17 +30,154 @@
 #pragma mark - Imports
 
 #import "HTTPStubsMethodSwizzling.h"
+#import "HTTPStubsBodyStream.h"
+
+#import <CommonCrypto/CommonDigest.h>
+#import <stdatomic.h>
 
 ////////////////////////////////////////////////////////////////////////////////
 #pragma mark - NSURLRequest+CustomHTTPBody
 
 NSString * const OHHTTPStubs_HTTPBodyKey = @"HTTPBody";
+NSString * const OHHTTPStubs_HTTPBodyDigestKey = @"HTTPBodyDigest";
+NSString * const OHHTTPStubs_HTTPBodyFingerprintKey = @"HTTPBodyFingerprint";
+
+// Configuration values, expected to be set before the requests are built, but read from any thread
+static atomic_bool sHTTPBodyCaptureEnabled = false;
+// Whether the capture was enabled or disabled explicitly, rather than on first use of the body
+static atomic_bool sHTTPBodyCaptureConfigured = false;
+static _Atomic(NSUInteger) sHTTPBodyCaptureLimit = 1024 * 1024;
+
+// Called when the body of a request is asked for but was not captured (or the request has none, which can't be told apart):
+// unless the capture was configured explicitly, enable it so that the body of the requests built from now on can be tested
+static void OHHTTPStubs_HTTPBodyNotCaptured(void)
+{
+    bool configured = false;
+    if (!atomic_load(&sHTTPBodyCaptureEnabled) && atomic_compare_exchange_strong(&sHTTPBodyCaptureConfigured, &configured, true))
+    {
+        atomic_store(&sHTTPBodyCaptureEnabled, true);
+        NSLog(@"[OHHTTPStubs] The body of a request was asked for while the body capture was disabled, so it could not be captured. "
+              @"The capture is now enabled for the requests built from now on: call +[NSURLRequest OHHTTPStubs_setHTTPBodyCaptureEnabled:YES] "
+              @"before building the requests whose body your stubs test.");
+    }
+}
+
+static NSData* OHHTTPStubs_SHA256(NSData* data)
+{
+    __block CC_SHA256_CTX context;
+    CC_SHA256_Init(&context);
+    [data enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
+        CC_SHA256_Update(&context, bytes, (CC_LONG)byteRange.length);
+    }];
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256_Final(digest, &context);
+    return [NSData dataWithBytes:digest length:CC_SHA256_DIGEST_LENGTH];
+}
+
+// The body stream of the request, if it was wrapped when set so that its body can be read ahead
+static HTTPStubsBodyStream* OHHTTPStubs_HTTPBodyStream(NSURLRequest* request)
+{
+    NSInputStream* stream = request.HTTPBodyStream;
+    return [stream isKindOfClass:HTTPStubsBodyStream.class] ? (HTTPStubsBodyStream*)stream : nil;
+}
+
+// The body captured by setHTTPBody:, or the body of requests which have not been sent yet
+static NSData* OHHTTPStubs_CapturedHTTPBody(NSURLRequest* request)
+{
+    return [NSURLProtocol propertyForKey:OHHTTPStubs_HTTPBodyKey inRequest:request] ?: request.HTTPBody;
+}
 
 @implementation NSURLRequest (HTTPBodyTesting)
 
 - (NSData*)OHHTTPStubs_HTTPBody
 {
-    return [NSURLProtocol propertyForKey:OHHTTPStubs_HTTPBodyKey inRequest:self];
+    NSData* body = OHHTTPStubs_CapturedHTTPBody(self) ?: [OHHTTPStubs_HTTPBodyStream(self) body];
+    if (!body && ![NSURLProtocol propertyForKey:OHHTTPStubs_HTTPBodyDigestKey inRequest:self])
+    {
+        OHHTTPStubs_HTTPBodyNotCaptured();
+    }
+    return body;
+}
+
+- (NSData*)OHHTTPStubs_HTTPBodyDigest
+{
+    NSData* digest = [NSURLProtocol propertyForKey:OHHTTPStubs_HTTPBodyDigestKey inRequest:self];
+    if (digest)
+    {
+        return digest;
+    }
+    NSData* body = OHHTTPStubs_CapturedHTTPBody(self);
+    digest = body ? OHHTTPStubs_SHA256(body) : [OHHTTPStubs_HTTPBodyStream(self) digest];
+    if (!digest)
+    {
+        OHHTTPStubs_HTTPBodyNotCaptured();
+    }
+    return digest;
+}
+
+- (NSData*)OHHTTPStubs_HTTPBodyFingerprint
+{
+    NSData* fingerprint = [NSURLProtocol propertyForKey:OHHTTPStubs_HTTPBodyFingerprintKey inRequest:self];
+    if (fingerprint)
+    {
+        return fingerprint;
+    }
+    NSData* body = OHHTTPStubs_CapturedHTTPBody(self);
+    // The stream computes it while reading ahead, alongside its digest, then keeps it
+    return body ? HTTPStubsBodyFingerprint(body) : [OHHTTPStubs_HTTPBodyStream(self) fingerprint];
+}
+
++ (NSData*)OHHTTPStubs_fingerprintForData:(NSData*)data
+{
+    return HTTPStubsBodyFingerprint(data);
+}
+
+- (NSData*)OHHTTPStubs_HTTPBodyPrefixOfLength:(NSUInteger)length
+{
+    NSData* body = OHHTTPStubs_CapturedHTTPBody(self);
+    if (body)
+    {
+        return [body subdataWithRange:NSMakeRange(0, MIN(length, body.length))];
+    }
+    return [OHHTTPStubs_HTTPBodyStream(self) prefixOfLength:length];
+}
+
+- (BOOL)OHHTTPStubs_HTTPBodyIsEqualToData:(NSData*)data
+{
+    NSData* body = OHHTTPStubs_CapturedHTTPBody(self);
+    if (body)
+    {
+        return [body isEqualToData:data];
+    }
+    HTTPStubsBodyStream* stream = OHHTTPStubs_HTTPBodyStream(self);
+    if (stream)
+    {
+        // One more byte than expected is enough to tell, without reading the whole stream
+        return [[stream prefixOfLength:data.length + 1] isEqualToData:data];
+    }
+    NSData* digest = [NSURLProtocol propertyForKey:OHHTTPStubs_HTTPBodyDigestKey inRequest:self];
+    return digest != nil && [digest isEqualToData:OHHTTPStubs_SHA256(data)];
+}
+
++ (void)OHHTTPStubs_setHTTPBodyCaptureEnabled:(BOOL)enabled
+{
+    atomic_store(&sHTTPBodyCaptureConfigured, true);
+    atomic_store(&sHTTPBodyCaptureEnabled, (bool)enabled);
+}
+
++ (BOOL)OHHTTPStubs_isHTTPBodyCaptureEnabled
+{
+    return atomic_load(&sHTTPBodyCaptureEnabled);
+}
+
++ (void)OHHTTPStubs_setHTTPBodyCaptureLimit:(NSUInteger)limit
+{
+    atomic_store(&sHTTPBodyCaptureLimit, limit);
+}
+
++ (NSUInteger)OHHTTPStubs_HTTPBodyCaptureLimit
+{
+    return atomic_load(&sHTTPBodyCaptureLimit);
 }
 
 @end
@@ -53,9 +190,19 @@ static HTTPStubsSetterIMP orig_setHTTPBody;
 
 static void OHHTTPStubs_setHTTPBody(id self, SEL _cmd, NSData* HTTPBody)
 {
-    // store the http body via NSURLProtocol
-    if (HTTPBody) {
-        [NSURLProtocol setProperty:HTTPBody forKey:OHHTTPStubs_HTTPBodyKey inRequest:self];
+    // store the http body via NSURLProtocol, only if some stub may need it
+    if (HTTPBody && atomic_load(&sHTTPBodyCaptureEnabled)) {
+        if (HTTPBody.length <= atomic_load(&sHTTPBodyCaptureLimit)) {
+            [NSURLProtocol setProperty:HTTPBody forKey:OHHTTPStubs_HTTPBodyKey inRequest:self];
+            // computed once here, rather than by each stub testing the body
+            [NSURLProtocol setProperty:HTTPStubsBodyFingerprint(HTTPBody) forKey:OHHTTPStubs_HTTPBodyFingerprintKey inRequest:self];
+            [NSURLProtocol removePropertyForKey:OHHTTPStubs_HTTPBodyDigestKey inRequest:self];
+        } else {
+            // Only keep the digest of large bodies, so that uploads are not retained twice nor hashed twice
+            [NSURLProtocol setProperty:OHHTTPStubs_SHA256(HTTPBody) forKey:OHHTTPStubs_HTTPBodyDigestKey inRequest:self];
+            [NSURLProtocol removePropertyForKey:OHHTTPStubs_HTTPBodyKey inRequest:self];
+            [NSURLProtocol removePropertyForKey:OHHTTPStubs_HTTPBodyFingerprintKey inRequest:self];
+        }
     } else {
         // unfortunately resetting does not work properly as the NSURLSession also uses this to reset the property
     }
@@ -63,9 +210,26 @@ static void OHHTTPStubs_setHTTPBody(id self, SEL _cmd, NSData* HTTPBody)
     orig_setHTTPBody(self, _cmd, HTTPBody);
 }
 
+static HTTPStubsSetterIMP orig_setHTTPBodyStream;
+
+static void OHHTTPStubs_setHTTPBodyStream(id self, SEL _cmd, NSInputStream* HTTPBodyStream)
+{
+    // wrap the stream, so that stubs can read the body ahead without consuming it for the loader
+    if (HTTPBodyStream && atomic_load(&sHTTPBodyCaptureEnabled) && ![HTTPBodyStream isKindOfClass:HTTPStubsBodyStream.class]) {
+        HTTPBodyStream = [[HTTPStubsBodyStream alloc] initWithInputStream:HTTPBodyStream memoryLimit:atomic_load(&sHTTPBodyCaptureLimit)];
+        // the body now comes from the stream, not from a previous setHTTPBody:
+        for (NSString* key in @[OHHTTPStubs_HTTPBodyKey, OHHTTPStubs_HTTPBodyDigestKey, OHHTTPStubs_HTTPBodyFingerprintKey]) {
+            [NSURLProtocol removePropertyForKey:key inRequest:self];
+        }
+    }
+
+    orig_setHTTPBodyStream(self, _cmd, HTTPBodyStream);
+}
+
 /**
- *   Swizzles setHTTPBody: in order to maintain a copy of the http body for later
- *   reference and calls the original implementation.
+ *   Swizzles setHTTPBody: and setHTTPBodyStream: in order to maintain a copy of the
+ *   http body for later reference (while the body capture is enabled) and calls the
+ *   original implementations.
  *
  *   @warning Should not be used in production, testing only.
  */
@@ -79,6 +243,10 @@ static void OHHTTPStubs_setHTTPBody(id self, SEL _cmd, NSData* HTTPBody)
                                                                      (IMP)OHHTTPStubs_setHTTPBody,
                                                                      [NSMutableURLRequest class],
                                                                      NO);
+    orig_setHTTPBodyStream = (HTTPStubsSetterIMP)HTTPStubsReplaceMethod(@selector(setHTTPBodyStream:),
+                                                                           (IMP)OHHTTPStubs_setHTTPBodyStream,
+                                                                           [NSMutableURLRequest class],
+                                                                           NO);
 }
 
 @end
@@ -60,6 +60,33 @@ typedef HTTPStubsResponse* __nonnull (^HTTPStubsResponseBlock)( NSURLRequest* re
 @property(nonatomic, strong, nullable) NSString* name;
 @end
 
+/**
+ *  Loads the requests which are not matched by any stub, instead of leaving them to the
+ *  next `NSURLProtocol`. This is the hook used by extensions like `HTTPStubsRecorder`
+ *  (`Recorder` subspec) to let some unmatched requests through to the network.
+ *
+ *  @see `+[HTTPStubs setUnmatchedRequestHandler:]`
+ */
+@protocol HTTPStubsUnmatchedRequestHandler <NSObject>
+/**
+ *  Whether the handler loads this request, which is not matched by any stub.
+ *
+ *  @note This is called by `+[NSURLProtocol canInitWithRequest:]`, from any thread, and must be fast.
+ */
+-(BOOL)shouldLoadUnmatchedRequest:(NSURLRequest*)request;
+
+/**
+ *  Start loading the request of the protocol, reporting the response to the protocol's client
+ *  on the current run loop.
+ *
+ *  @note This is called from the protocol's `-startLoading`.
+ *
+ *  @return A block cancelling the load, called if the protocol is stopped. Nothing must be
+ *          reported to the client once it has been called.
+ */
+-(dispatch_block_t)startLoadingUnmatchedRequestForProtocol:(NSURLProtocol*)protocol;
+@end
+
 ////////////////////////////////////////////////////////////////////////////////
 #pragma mark - Interface
 
@@ -109,6 +136,18 @@ typedef HTTPStubsResponse* __nonnull (^HTTPStubsResponseBlock)( NSURLRequest* re
  */
 +(void)removeAllStubs;
 
+/**
+ *  A dictionary shared by all the test blocks evaluated for the same request while
+ *  looking for its stub, to cache the values derived from the request (parsed URL,
+ *  decoded body…) so that they are computed once per request rather than once per stub.
+ *
+ *  Each request being matched gets a new, empty dictionary.
+ *
+ *  @return The cache of the request being matched on the current thread, or `nil`
+ *          when called outside of a test block.
+ */
++(nullable NSMutableDictionary*)requestScanCache;
+
 ////////////////////////////////////////////////////////////////////////////////
 #pragma mark - Disabling & Re-Enabling stubs
 
@@ -213,6 +252,24 @@ typedef HTTPStubsResponse* __nonnull (^HTTPStubsResponseBlock)( NSURLRequest* re
  */
 +(void)onStubMissing:( nullable void(^)(NSURLRequest* request) )block;
 
+#pragma mark - Unmatched Requests
+
+/**
+ *  Set the handler loading the requests which are not matched by any stub.
+ *
+ *  Without handler, the requests not matched by any stub are left to the next `NSURLProtocol`
+ *  (typically, they go to the network). The `onStubMissing:` block is still called for them.
+ *
+ *  @param handler The handler of the unmatched requests, retained until it is replaced.
+ *                 Set it to `nil` to leave them to the next `NSURLProtocol`. Default is `nil`.
+ */
++(void)setUnmatchedRequestHandler:(nullable id<HTTPStubsUnmatchedRequestHandler>)handler;
+
+/**
+ *  The handler loading the requests which are not matched by any stub, if any.
+ */
++(nullable id<HTTPStubsUnmatchedRequestHandler>)unmatchedRequestHandler;
+
 @end
 
 NS_ASSUME_NONNULL_END
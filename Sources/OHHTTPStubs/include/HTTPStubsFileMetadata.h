@@ -0,0 +1,97 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Imports
+
+#import <Foundation/Foundation.h>
+
+#import "Compatibility.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Interface
+
+/**
+ *  Metadata of a file fixture (size, modification date and inode), as used
+ *  to build file-backed `HTTPStubsResponse`s.
+ *
+ *  Metadata are kept in a process-wide cache keyed by file URL, so that a stub
+ *  building a response from the same file on each request only hits the file
+ *  system once. Each cached file is watched with a vnode dispatch source, and
+ *  its entry is dropped as soon as the file is written to, renamed or deleted.
+ *  Files that can't be watched are checked against a `stat(2)` on each lookup.
+ *
+ *  @note File system events are delivered asynchronously: a response built right
+ *        after rewriting a fixture may still see the old metadata. Call
+ *        `invalidateMetadataForFileURL:` after rewriting a fixture if the very
+ *        next response must see the change.
+ */
+@interface HTTPStubsFileMetadata : NSObject
+
+/**
+ *  The size of the file, in bytes.
+ */
+@property(nonatomic, assign, readonly) unsigned long long fileSize;
+/**
+ *  The last modification date of the file.
+ */
+@property(nonatomic, strong, readonly) NSDate* modificationDate;
+/**
+ *  The inode number of the file.
+ */
+@property(nonatomic, assign, readonly) unsigned long long inode;
+
+/**
+ *  Returns the metadata of the file at the given URL, from the cache if possible.
+ *
+ *  @param fileURL The URL of the file. Must be a file URL.
+ *  @param error   An out value that returns the error encountered when reading the
+ *                 metadata from the file system, if any.
+ *
+ *  @return The metadata of the file, or `nil` if they could not be read.
+ */
++(nullable instancetype)metadataForFileURL:(NSURL*)fileURL error:(NSError**)error;
+
+/**
+ *  Drop the cached metadata of the file at the given URL, if any.
+ *
+ *  @param fileURL The URL of the file
+ *
+ *  @note You only need this if the next response must see a change you just made
+ *        to the file, or if the change is not notified by the file system
+ *        (e.g. on a network volume).
+ */
++(void)invalidateMetadataForFileURL:(NSURL*)fileURL;
+
+/**
+ *  Drop all the cached file metadata.
+ */
++(void)invalidateAllMetadata;
+
+@end
+
+NS_ASSUME_NONNULL_END
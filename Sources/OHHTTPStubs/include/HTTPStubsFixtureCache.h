@@ -0,0 +1,186 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Imports
+
+#import <Foundation/Foundation.h>
+
+#import "Compatibility.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Types
+
+/**
+ *  Turns the raw content of a fixture file into the body to cache (e.g. decodes it).
+ *
+ *  @param fileData The content of the file, from the requested offset
+ *
+ *  @return The body to cache, or `nil` if it could not be decoded
+ */
+typedef NSData* _Nullable (^HTTPStubsFixtureDecoder)(NSData* fileData);
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Interface
+
+/**
+ *  Content-addressed cache for fixture bodies.
+ *
+ *  Bodies are stored once by content hash (SHA-256), so that the same payload
+ *  returned by several stubs, or read again by the same stub on each request,
+ *  is only kept once in memory.
+ *
+ *  The least recently used bodies are evicted when the total size of the cached
+ *  bodies goes over `byteBudget`, and the cache is trimmed when the system reports
+ *  memory pressure. Responses only hold their body while it is being sent, and
+ *  fetch it from the cache again for the next request, so eviction actually
+ *  frees the memory: an evicted body is read from its file again when needed.
+ *
+ *  @note The shared cache is disabled by default. When enabled, it is used for the
+ *        responses built from files (`responseWithFileAtPath:`, `responseWithFileURL:`,
+ *        and thus `responseNamed:`, HTTPMessage and Mocktail fixtures) whose body
+ *        fits in `byteBudget`, and for base64 Mocktail bodies. Responses built from
+ *        data in memory are never hashed behind your back: pass their data through
+ *        `cachedDataForData:` yourself to share it.
+ */
+@interface HTTPStubsFixtureCache : NSObject
+
+/**
+ *  The cache used by the file-backed `HTTPStubsResponse`s, once `enabled`.
+ */
++(instancetype)sharedCache;
+
+/**
+ *  Whether the responses built from fixture files use this cache. Only relevant for the `sharedCache`.
+ *
+ *  Defaults to `NO`.
+ */
+@property(atomic, assign, getter=isEnabled) BOOL enabled;
+
+/**
+ *  The maximum total size of the cached bodies, in bytes.
+ *
+ *  Defaults to 64 MB.
+ */
+@property(atomic, assign) unsigned long long byteBudget;
+
+/**
+ *  Bodies smaller than this size, in bytes, are not worth hashing and are never cached.
+ *
+ *  Defaults to 1 KB.
+ */
+@property(atomic, assign) NSUInteger minimumDataLength;
+
+/**
+ *  The total size of the bodies currently in the cache, in bytes.
+ */
+@property(atomic, assign, readonly) unsigned long long totalBytes;
+
+/**
+ *  The number of lookups that found their body in the cache.
+ */
+@property(atomic, assign, readonly) NSUInteger hitCount;
+
+/**
+ *  The number of lookups that had to add their body to the cache.
+ */
+@property(atomic, assign, readonly) NSUInteger missCount;
+
+/**
+ *  The ratio of lookups that found their body in the cache, between 0 and 1.
+ */
+@property(atomic, assign, readonly) double hitRate;
+
+/**
+ *  The number of bodies evicted from the cache since its creation.
+ */
+@property(atomic, assign, readonly) NSUInteger evictionCount;
+
+/**
+ *  Create a new cache.
+ *
+ *  @param byteBudget The maximum total size of the cached bodies, in bytes.
+ *
+ *  @return A new, empty cache
+ */
+-(instancetype)initWithByteBudget:(unsigned long long)byteBudget NS_DESIGNATED_INITIALIZER;
+
+/**
+ *  Returns the cached body with the same content as the given data, adding it to the
+ *  cache if needed.
+ *
+ *  @param data The body to look up
+ *
+ *  @return The instance shared by all the callers using the same content. Use it instead
+ *          of `data`, so that your copy can be released.
+ */
+-(NSData*)cachedDataForData:(NSData*)data;
+
+/**
+ *  Returns the content of the file at the given URL, only reading it from disk if it is
+ *  not already cached or if it changed since it was cached.
+ *
+ *  @param fileURL The URL of the file to read. Must be a file URL.
+ *  @param error   An out value that returns any error encountered while reading the file.
+ *
+ *  @return The content of the file, shared with all the cached bodies having the same content.
+ */
+-(nullable NSData*)dataWithContentsOfFileURL:(NSURL*)fileURL error:(NSError**)error;
+
+/**
+ *  Returns the content of the file at the given URL from the given offset, optionally
+ *  decoded, only reading and decoding it if it is not already cached or if the file
+ *  changed since it was cached.
+ *
+ *  @param fileURL The URL of the file to read. Must be a file URL.
+ *  @param offset  The offset of the content in the file, in bytes.
+ *  @param decoder The block turning the content of the file into the body to cache,
+ *                 or `nil` to cache the content as is. Always use the same decoder
+ *                 for a given file and offset, as the cache can't tell them apart.
+ *  @param error   An out value that returns any error encountered while reading the file.
+ *
+ *  @return The (decoded) content of the file, shared with all the cached bodies having
+ *          the same content.
+ */
+-(nullable NSData*)dataWithContentsOfFileURL:(NSURL*)fileURL
+                                      offset:(unsigned long long)offset
+                                     decoder:(nullable HTTPStubsFixtureDecoder)decoder
+                                       error:(NSError**)error;
+
+/**
+ *  Remove all the bodies from the cache.
+ */
+-(void)removeAllData;
+
+/**
+ *  Reset the hit, miss and eviction counters.
+ */
+-(void)resetStatistics;
+
+@end
+
+NS_ASSUME_NONNULL_END
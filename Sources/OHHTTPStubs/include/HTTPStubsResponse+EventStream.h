@@ -0,0 +1,140 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#import "HTTPStubsResponse.h"
+#import "Compatibility.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  An event of a Server-Sent Events stream (`text/event-stream`).
+ */
+@interface HTTPStubsServerSentEvent : NSObject
+
+/**
+ *  The data of the event. Multi-line data is sent as several `data:` fields.
+ */
+@property(nonatomic, copy, nullable) NSString* data;
+/**
+ *  The name of the event, sent as the `event:` field.
+ */
+@property(nonatomic, copy, nullable) NSString* name;
+/**
+ *  The identifier of the event, sent as the `id:` field.
+ */
+@property(nonatomic, copy, nullable) NSString* identifier;
+/**
+ *  The reconnection time to send as the `retry:` field, in seconds. Not sent if 0.
+ */
+@property(nonatomic, assign) NSTimeInterval retry;
+/**
+ *  The delay to wait before sending the event, in seconds. Defaults to 0.
+ */
+@property(nonatomic, assign) NSTimeInterval delay;
+
+/**
+ *  Builds an event carrying the given data.
+ *
+ *  @param data  The data of the event
+ *  @param delay The delay to wait before sending the event, in seconds
+ *
+ *  @return The event
+ */
++(instancetype)eventWithData:(nullable NSString*)data delay:(NSTimeInterval)delay;
+
+@end
+
+/**
+ *  Adds convenience methods to build streaming responses, whose events are sent
+ *  one by one, each one as a whole, after its own delay.
+ *
+ *  The variants taking a provider block only build each event when it is due,
+ *  which keeps long-running streams bounded in memory.
+ */
+@interface HTTPStubsResponse (EventStream)
+
+/**
+ *  Builds a Server-Sent Events response sending the given events.
+ *
+ *  @param events      The events to send, in order
+ *  @param statusCode  The HTTP Status Code to use in the response
+ *  @param httpHeaders The HTTP Headers to return in the response
+ *                     If a "Content-Type" header is not included, "Content-Type: text/event-stream" will be added.
+ *
+ *  @return An `HTTPStubsResponse` describing the corresponding response to return by the stub
+ */
++(instancetype)responseWithServerSentEvents:(NSArray<HTTPStubsServerSentEvent*>*)events
+                                 statusCode:(int)statusCode
+                                    headers:(nullable NSDictionary*)httpHeaders;
+
+/**
+ *  Builds a Server-Sent Events response sending the events returned by a block.
+ *
+ *  @param eventProvider The block returning the event at the given index, or `nil` to end the stream
+ *  @param statusCode    The HTTP Status Code to use in the response
+ *  @param httpHeaders   The HTTP Headers to return in the response
+ *                       If a "Content-Type" header is not included, "Content-Type: text/event-stream" will be added.
+ *
+ *  @return An `HTTPStubsResponse` describing the corresponding response to return by the stub
+ */
++(instancetype)responseWithServerSentEventProvider:(HTTPStubsServerSentEvent* __nullable (^)(NSUInteger index))eventProvider
+                                        statusCode:(int)statusCode
+                                           headers:(nullable NSDictionary*)httpHeaders;
+
+/**
+ *  Builds a newline-delimited JSON response, sending one JSON object per line.
+ *
+ *  @param jsonObjects The objects to send, in order.
+ *                     Each may be any object accepted by `+[NSJSONSerialization dataWithJSONObject:options:error:]`
+ *  @param interval    The delay to wait before sending each line, in seconds
+ *  @param statusCode  The HTTP Status Code to use in the response
+ *  @param httpHeaders The HTTP Headers to return in the response
+ *                     If a "Content-Type" header is not included, "Content-Type: application/x-ndjson" will be added.
+ *
+ *  @return An `HTTPStubsResponse` describing the corresponding response to return by the stub
+ */
++(instancetype)responseWithJSONLines:(NSArray*)jsonObjects
+                            interval:(NSTimeInterval)interval
+                          statusCode:(int)statusCode
+                             headers:(nullable NSDictionary*)httpHeaders;
+
+/**
+ *  Builds a newline-delimited JSON response, sending the objects returned by a block.
+ *
+ *  @param jsonObjectProvider The block returning the object at the given index, or `nil` to end the stream.
+ *                            Set `delay` to the delay to wait before sending the line.
+ *  @param statusCode         The HTTP Status Code to use in the response
+ *  @param httpHeaders        The HTTP Headers to return in the response
+ *                            If a "Content-Type" header is not included, "Content-Type: application/x-ndjson" will be added.
+ *
+ *  @return An `HTTPStubsResponse` describing the corresponding response to return by the stub
+ */
++(instancetype)responseWithJSONLineProvider:(id __nullable (^)(NSUInteger index, NSTimeInterval* delay))jsonObjectProvider
+                                 statusCode:(int)statusCode
+                                    headers:(nullable NSDictionary*)httpHeaders;
+
+@end
+
+NS_ASSUME_NONNULL_END
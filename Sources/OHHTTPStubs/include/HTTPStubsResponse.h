@@ -46,9 +46,22 @@ OHHTTPStubsDownloadSpeed3G,
 OHHTTPStubsDownloadSpeed3GPlus,
 OHHTTPStubsDownloadSpeedWifi;
 
+// Use as the dataSize of a response whose body size is not known in advance
+extern const unsigned long long
+OHHTTPStubsUnknownDataSize;
+
 
 NS_ASSUME_NONNULL_BEGIN
 
+/**
+ *  Block providing the frames of a streamed response body, one at a time.
+ *
+ *  @param delay The delay to wait before sending the returned frame. Defaults to 0.
+ *
+ *  @return The next frame to send, or `nil` once the body is complete.
+ */
+typedef NSData* __nullable (^HTTPStubsFrameProvider)(NSTimeInterval* delay);
+
 ////////////////////////////////////////////////////////////////////////////////
 #pragma mark - Interface
 
@@ -76,6 +89,11 @@ NS_ASSUME_NONNULL_BEGIN
 @property(nonatomic, strong, nullable) NSInputStream* inputStream;
 /**
  *  The size of the fake response body, in bytes.
+ *
+ *  @note Set to `OHHTTPStubsUnknownDataSize` if the size of the body is not known
+ *        in advance. In that case no `Content-Length` header is added, and a positive
+ *        `responseTime` can't be spread over the body: the body is sent as fast as it
+ *        is produced, and the response only finishes once `responseTime` has elapsed.
  */
 @property(nonatomic, assign) unsigned long long dataSize;
 /**
@@ -96,6 +114,17 @@ NS_ASSUME_NONNULL_BEGIN
  *  If `error` is non-`nil`, the request will result in a failure and no response will be sent.
  */
 @property(nonatomic, strong, nullable) NSError* error;
+/**
+ *  The block providing the response body frame by frame, for streaming responses.
+ *
+ *  When set, it is used instead of the `inputStream`: each frame is sent as a whole
+ *  after its own delay, and `responseTime` is ignored.
+ *  @note The block is called on the thread of the client, right after the previous frame
+ *        has been sent (and before waiting for the delay it returns), so that only one frame
+ *        at a time is kept in memory. To end the stream with a failure rather than cleanly,
+ *        set the `error` of the response before returning `nil`.
+ */
+@property(nonatomic, copy, nullable) HTTPStubsFrameProvider frameProvider;
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -155,6 +184,39 @@ NS_ASSUME_NONNULL_BEGIN
                         statusCode:(int)statusCode
                            headers:(nullable NSDictionary *)httpHeaders;
 
+/**
+ *  Builds a response sending the content of a file from a given offset, the status code, and headers.
+ *
+ *  @param fileURL     The URL of the file containing the data to return in the response
+ *  @param offset      The offset in bytes of the data to return, the bytes before it being skipped
+ *  @param statusCode  The HTTP Status Code to use in the response
+ *  @param httpHeaders The HTTP Headers to return in the response
+ *
+ *  @return An `HTTPStubsResponse` describing the corresponding response to return by the stub
+ *
+ *  @note This method applies only to URLs that represent file system resources
+ */
++(instancetype)responseWithFileURL:(NSURL *)fileURL
+                            offset:(unsigned long long)offset
+                        statusCode:(int)statusCode
+                           headers:(nullable NSDictionary *)httpHeaders;
+
+/* -------------------------------------------------------------------------- */
+#pragma mark > Building a streamed response
+
+/**
+ *  Builds a response whose body is sent as a sequence of frames.
+ *
+ *  @param frameProvider The block returning each frame of the body and its delay, then `nil`.
+ *  @param statusCode    The HTTP Status Code to use in the response
+ *  @param httpHeaders   The HTTP Headers to return in the response
+ *
+ *  @return An `HTTPStubsResponse` describing the corresponding response to return by the stub
+ */
++(instancetype)responseWithFrameProvider:(HTTPStubsFrameProvider)frameProvider
+                              statusCode:(int)statusCode
+                                 headers:(nullable NSDictionary*)httpHeaders;
+
 /* -------------------------------------------------------------------------- */
 #pragma mark > Building an error response
 
@@ -226,7 +288,7 @@ NS_ASSUME_NONNULL_BEGIN
  *  statusCode and headers.
  *
  *  @param inputStream The input stream that will provide the data to return in the response
- *  @param dataSize The size of the data in the stream.
+ *  @param dataSize The size of the data in the stream, or `OHHTTPStubsUnknownDataSize` if not known in advance.
  *  @param statusCode The HTTP Status Code to use in the response
  *  @param httpHeaders The HTTP Headers to return in the response
  *
@@ -271,6 +333,23 @@ NS_ASSUME_NONNULL_BEGIN
                     statusCode:(int)statusCode
                        headers:(nullable NSDictionary *)httpHeaders;
 
+/**
+ *  Initialize a response with a given URL and offset, statusCode and headers.
+ *
+ *  @param fileURL     The URL of the file containing the data to return in the response
+ *  @param offset      The offset in bytes of the data to return, the bytes before it being skipped
+ *  @param statusCode  The HTTP Status Code to use in the response
+ *  @param httpHeaders The HTTP Headers to return in the response
+ *
+ *  @return An `HTTPStubsResponse` describing the corresponding response to return by the stub
+ *
+ *  @note The `dataSize` of the response, and thus its `Content-Length` header if missing, is the size of the file minus the offset.
+ */
+-(instancetype)initWithFileURL:(NSURL *)fileURL
+                        offset:(unsigned long long)offset
+                    statusCode:(int)statusCode
+                       headers:(nullable NSDictionary *)httpHeaders;
+
 /**
  *  Initialize a response with the given data, statusCode and headers.
  *
@@ -284,6 +363,21 @@ NS_ASSUME_NONNULL_BEGIN
                  statusCode:(int)statusCode
                     headers:(nullable NSDictionary*)httpHeaders;
 
+/**
+ *  Initialize a response whose body is sent as a sequence of frames.
+ *
+ *  @param frameProvider The block returning each frame of the body and its delay, then `nil`.
+ *  @param statusCode    The HTTP Status Code to use in the response
+ *  @param httpHeaders   The HTTP Headers to return in the response
+ *
+ *  @return An `HTTPStubsResponse` describing the corresponding response to return by the stub
+ *
+ *  @note The size of such a body is unknown (`OHHTTPStubsUnknownDataSize`), so no `Content-Length` header is added.
+ */
+-(instancetype)initWithFrameProvider:(HTTPStubsFrameProvider)frameProvider
+                          statusCode:(int)statusCode
+                             headers:(nullable NSDictionary*)httpHeaders;
+
 
 /**
  *  Designed initializer. Initialize a response with the given error.
@@ -0,0 +1,147 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Imports
+
+#import <Foundation/Foundation.h>
+
+#import "HTTPStubsResponse.h"
+#import "Compatibility.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Types
+
+/**
+ *  Block returning the value to use for a placeholder of a template, or `nil`
+ *  to fall back to the built-in request placeholders.
+ */
+typedef NSString* __nullable (^HTTPStubsTemplateValueBlock)(NSString* placeholder, NSURLRequest* request);
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Interface
+
+/**
+ *  A response body template, with `{{placeholder}}` markers substituted for each request.
+ *
+ *  The template is split into literal and placeholder segments once, when it is created.
+ *  Responses built from it then stream the substituted body chunk by chunk, without ever
+ *  building the whole body in memory.
+ *
+ *  Besides the values you provide, the following placeholders are derived from the request:
+ *
+ *  - `{{request.method}}`, `{{request.url}}`, `{{request.host}}`, `{{request.path}}`
+ *  - `{{request.path.N}}`: the N-th path component, `/` excluded (`{{request.path.1}}` is `42` in `/users/42`)
+ *  - `{{request.query.NAME}}`: the value of the `NAME` query parameter
+ *  - `{{request.header.NAME}}`: the value of the `NAME` request header
+ *
+ *  Unknown placeholders are replaced with an empty string.
+ *
+ *  _Usage example:_
+ *  <pre>HTTPStubsResponseTemplate* userTemplate = [HTTPStubsResponseTemplate templateWithContentsOfFileURL:url error:NULL];
+ *  [HTTPStubs stubRequestsPassingTest:… withStubResponse:^HTTPStubsResponse*(NSURLRequest *request) {
+ *    return [userTemplate responseForRequest:request values:nil statusCode:200 headers:nil];
+ *  }];</pre>
+ */
+@interface HTTPStubsResponseTemplate : NSObject
+
+/**
+ *  The names of the placeholders used in the template, in order of first appearance.
+ */
+@property(nonatomic, strong, readonly) NSArray<NSString*>* placeholders;
+
+/**
+ *  Builds a template from UTF-8 data.
+ *
+ *  @param data The template content
+ *
+ *  @return The parsed template
+ */
++(instancetype)templateWithData:(NSData*)data;
+
+/**
+ *  Builds a template from the content of a file.
+ *
+ *  @param fileURL The URL of the template file. Must be a file URL.
+ *  @param error   An out value that returns any error encountered while reading the file.
+ *
+ *  @return The parsed template, or `nil` if the file could not be read
+ */
++(nullable instancetype)templateWithContentsOfFileURL:(NSURL*)fileURL error:(NSError**)error;
+
+-(instancetype)init NS_UNAVAILABLE;
+
+/**
+ *  Designated initializer. Parses the template from UTF-8 data.
+ *
+ *  @param data The template content
+ *
+ *  @return The parsed template
+ */
+-(instancetype)initWithData:(NSData*)data NS_DESIGNATED_INITIALIZER;
+
+/**
+ *  Builds a response streaming the template substituted with the given values.
+ *
+ *  All the values are resolved upfront, so the response has a known `dataSize` and a
+ *  `Content-Length` header.
+ *
+ *  @param request     The request to derive the `request.*` placeholders from
+ *  @param values      The values of the placeholders. Take precedence over the `request.*` placeholders.
+ *  @param statusCode  The HTTP Status Code to use in the response
+ *  @param httpHeaders The HTTP Headers to return in the response
+ *
+ *  @return An `HTTPStubsResponse` describing the corresponding response to return by the stub
+ */
+-(HTTPStubsResponse*)responseForRequest:(NSURLRequest*)request
+                                 values:(nullable NSDictionary<NSString*, NSString*>*)values
+                             statusCode:(int)statusCode
+                                headers:(nullable NSDictionary*)httpHeaders;
+
+/**
+ *  Builds a response streaming the template, asking for the value of each placeholder
+ *  only when the body reaches it.
+ *
+ *  As the values are only known while the body is being sent, the response has an unknown
+ *  `dataSize` (`OHHTTPStubsUnknownDataSize`) and no `Content-Length` header.
+ *
+ *  @param request     The request to derive the `request.*` placeholders from
+ *  @param valueBlock  The block returning the value of each placeholder occurrence.
+ *                     Called on the thread sending the response body.
+ *  @param statusCode  The HTTP Status Code to use in the response
+ *  @param httpHeaders The HTTP Headers to return in the response
+ *
+ *  @return An `HTTPStubsResponse` describing the corresponding response to return by the stub
+ */
+-(HTTPStubsResponse*)responseForRequest:(NSURLRequest*)request
+                             valueBlock:(HTTPStubsTemplateValueBlock)valueBlock
+                             statusCode:(int)statusCode
+                                headers:(nullable NSDictionary*)httpHeaders;
+
+@end
+
+NS_ASSUME_NONNULL_END
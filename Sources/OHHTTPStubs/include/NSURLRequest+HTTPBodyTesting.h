@@ -41,8 +41,102 @@
  *
  *   You can use this method to retrieve the HTTPBody for testing and use it to 
  *   conditionally stub your requests.
+ *
+ *   This also works for the requests whose body is set with `HTTPBodyStream`:
+ *   the stream is read ahead without consuming it, so that the loader (or the
+ *   stub) still gets the whole body.
+ *
+ *   @note Bodies are only kept while the body capture is enabled (see
+ *         `OHHTTPStubs_setHTTPBodyCaptureEnabled:`), and only up to the
+ *         `OHHTTPStubs_HTTPBodyCaptureLimit`. For a larger body, this returns nil
+ *         and only its digest is available. If the capture was never enabled nor
+ *         disabled explicitly, the first call returning nil enables it for the
+ *         requests built afterwards, and logs a message.
+ *
+ *   @note The streams provided later by the task delegate, for requests sent with
+ *         `-[NSURLSession uploadTaskWithStreamedRequest:]`, can't be captured.
  */
 - (NSData *)OHHTTPStubs_HTTPBody;
+
+/**
+ *   A fingerprint of the HTTPBody: its length and a fast 64-bit hash of its content,
+ *   computed once when the body is captured, or while reading ahead a body stream.
+ *   Bodies set over the capture limit only keep their digest, so they have none.
+ *
+ *   Equal bodies always have equal fingerprints, so comparing the fingerprints first
+ *   rules out most of the different bodies without comparing their bytes. Fingerprints
+ *   can also be used as dictionary keys, to find the stub of a body with a single lookup.
+ *
+ *   @return 16 bytes of data, or nil if the body was not captured or was too large to be kept.
+ */
+- (NSData *)OHHTTPStubs_HTTPBodyFingerprint;
+
+/**
+ *   The fingerprint of the given body, to compare with `OHHTTPStubs_HTTPBodyFingerprint`.
+ */
++ (NSData *)OHHTTPStubs_fingerprintForData:(NSData *)data;
+
+/**
+ *   The first bytes of the HTTPBody. For a body set with `HTTPBodyStream`, only
+ *   those bytes are read ahead, making it cheaper than `OHHTTPStubs_HTTPBody`
+ *   for stubs only testing the beginning of large uploads.
+ *
+ *   @param length The number of bytes to return.
+ *
+ *   @return The first `length` bytes of the body (or less if it is shorter),
+ *           or nil if the body was not captured.
+ */
+- (NSData *)OHHTTPStubs_HTTPBodyPrefixOfLength:(NSUInteger)length;
+
+/**
+ *   The SHA-256 digest of the HTTPBody, available even when the body was too
+ *   large to be kept. Returns nil if there is no body or it was not captured.
+ */
+- (NSData *)OHHTTPStubs_HTTPBodyDigest;
+
+/**
+ *   Whether the HTTPBody is equal to the given data, comparing their digests
+ *   when the body was too large to be kept.
+ */
+- (BOOL)OHHTTPStubs_HTTPBodyIsEqualToData:(NSData *)data;
+
+/**
+ *   Enable or disable the capture of the HTTPBody of the requests, which is needed
+ *   for `OHHTTPStubs_HTTPBody` to work once the requests are sent with NSURLSession.
+ *
+ *   While enabled, every body set on a request in the process is retained a second
+ *   time (up to the `OHHTTPStubs_HTTPBodyCaptureLimit`), so it is disabled by default.
+ *   Body streams are wrapped, and the bytes the stubs read ahead are kept in memory up
+ *   to the same limit, then in a temporary file.
+ *   The matchers provided by OHHTTPStubs which test the body enable it when created.
+ *
+ *   @note Only the bodies set while the capture is enabled are captured, so enable it
+ *         before building the requests your stubs need to test the body of.
+ *
+ *   @note Neither the matchers nor the stubs enabling the capture ever disable it, as other
+ *         stubs may still need it: disable it yourself once the stubs testing the body are
+ *         removed, typically in `tearDown`, next to `+[HTTPStubs removeAllStubs]`.
+ *
+ *   This can be called from any thread.
+ */
++ (void)OHHTTPStubs_setHTTPBodyCaptureEnabled:(BOOL)enabled;
+
+/**
+ *   Whether the HTTPBody of the requests is captured. Defaults to `NO`.
+ */
++ (BOOL)OHHTTPStubs_isHTTPBodyCaptureEnabled;
+
+/**
+ *   Set the size, in bytes, above which only the digest of a body is kept (or, for
+ *   body streams, above which the bytes read ahead are kept in a temporary file).
+ *   Defaults to 1 MB.
+ */
++ (void)OHHTTPStubs_setHTTPBodyCaptureLimit:(NSUInteger)limit;
+
+/**
+ *   The size, in bytes, above which only the digest of a body is kept.
+ */
++ (NSUInteger)OHHTTPStubs_HTTPBodyCaptureLimit;
 @end
 
 #endif /* __IPHONE_7_0 || __MAC_10_9 */
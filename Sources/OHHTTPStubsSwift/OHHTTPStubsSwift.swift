@@ -113,6 +113,363 @@ import Foundation
   }
 #endif
 
+#if swift(>=3.0)
+/**
+ * Helper to stub requests with a different response for each of their expected bodies.
+ *
+ * The stubs are indexed by the fingerprint of their body, so that the response of a request
+ * is found with a single lookup however many bodies are stubbed, instead of testing a
+ * `hasBody` matcher for each of them.
+ *
+ * - Parameter condition: the matcher block that determine if the request will be stubbed, before looking at its body
+ * - Parameter responses: the stub response to use for each expected body
+ *
+ * - Returns: The opaque `HTTPStubsDescriptor` that uniquely identifies the stub
+ *            and can be later used to remove it with `removeStub:`
+ */
+  @discardableResult
+  public func stub(condition: @escaping HTTPStubsTestBlock, bodies responses: [Data: HTTPStubsResponseBlock]) -> HTTPStubsDescriptor {
+    NSURLRequest.ohhttpStubs_setHTTPBodyCaptureEnabled(true)
+    var index = [Data: [(body: Data, response: HTTPStubsResponseBlock)]]()
+    for (body, response) in responses {
+      let fingerprint: Data = NSURLRequest.ohhttpStubs_fingerprint(for: body)
+      index[fingerprint] = (index[fingerprint] ?? []) + [(body: body, response: response)]
+    }
+    let responseForRequest: (URLRequest) -> HTTPStubsResponseBlock? = { req in
+      let request = req as NSURLRequest
+      let candidates: [(body: Data, response: HTTPStubsResponseBlock)]
+      if let fingerprint = request.ohhttpStubs_HTTPBodyFingerprint() {
+        candidates = index[fingerprint] ?? []
+      } else {
+        // Bodies over the capture limit only keep their digest, to compare with each expected body
+        candidates = index.values.flatMap { $0 }
+      }
+      // Different bodies may share the same fingerprint
+      return candidates.first { request.ohhttpStubs_HTTPBodyIsEqual(to: $0.body) }?.response
+    }
+    return HTTPStubs.stubRequests(passingTest: { condition($0) && responseForRequest($0) != nil },
+                                  withStubResponse: { responseForRequest($0)!($0) })
+  }
+#endif
+
+
+// MARK: Parsed requests
+
+#if swift(>=3.0)
+/**
+ * The parts of a request the matchers look at (path, query, JSON or form body), parsed lazily.
+ *
+ * While HTTPStubs looks for the stub of a request, the same instance is shared by all the
+ * matchers of all the stubs through `HTTPStubs.requestScanCache()`, so that each part of the
+ * request is parsed at most once however many stubs are tested.
+ */
+final class ParsedRequest {
+  private static let cacheKey = "OHHTTPStubsSwift.ParsedRequest"
+
+  let request: URLRequest
+  private var parts = [String: Any]()
+
+  init(_ request: URLRequest) {
+    self.request = request
+  }
+
+  /**
+   * - Returns: the parsed request shared by the matchers while the stub of `request` is being
+   *            looked for, or a new one when called outside of a matcher
+   */
+  static func parsed(_ request: URLRequest) -> ParsedRequest {
+    guard let cache = HTTPStubs.requestScanCache() else {
+      return ParsedRequest(request)
+    }
+    if let parsed = cache[cacheKey] as? ParsedRequest, parsed.request == request {
+      return parsed
+    }
+    let parsed = ParsedRequest(request)
+    cache[cacheKey] = parsed
+    return parsed
+  }
+
+  fileprivate func part<T>(_ name: String, _ parse: () -> T) -> T {
+    if let part = parts[name] as? T {
+      return part
+    }
+    let part = parse()
+    parts[name] = part
+    return part
+  }
+
+  var path: String? {
+    return part("path") { self.request.url?.path }
+  }
+
+  @available(iOS 8.0, OSX 10.10, *)
+  var queryItems: [URLQueryItem]? {
+    return part("queryItems") {
+      guard let url = self.request.url else { return nil }
+      return URLComponents(url: url, resolvingAgainstBaseURL: true)?.queryItems
+    }
+  }
+
+  var jsonBody: NSDictionary? {
+    return part("jsonBody") {
+      guard
+        let httpBody = self.request.ohhttpStubs_httpBody,
+        let jsonBody = (try? JSONSerialization.jsonObject(with: httpBody, options: [])) as? [AnyHashable : Any]
+      else {
+        return nil
+      }
+      return NSDictionary(dictionary: jsonBody)
+    }
+  }
+
+  /// The items of an `application/x-www-form-urlencoded` body, sorted by name
+  @available(iOS 8.0, OSX 10.10, *)
+  var formItems: [URLQueryItem]? {
+    return part("formItems") {
+      guard
+        case "application/x-www-form-urlencoded"? = self.request.value(forHTTPHeaderField: "Content-Type"),
+        let httpBody = self.request.ohhttpStubs_httpBody,
+        let query = String(data: httpBody, encoding: .utf8)
+      else {
+        return nil
+      }
+      var comps = URLComponents()
+      comps.percentEncodedQuery = query
+      return (comps.queryItems ?? []).sorted(by: { $0.name < $1.name })
+    }
+  }
+}
+#endif
+
+// MARK: Route templates
+
+#if swift(>=3.0)
+/**
+ * Block used to build the response of a stubbed route.
+ *
+ * - Parameter request: the request to stub
+ * - Parameter parameters: the values of the parameters of the route in the request's path,
+ *                         e.g. `["id": "42"]` for the path `/users/42` and the route `/users/:id`
+ */
+public typealias HTTPStubsRouteResponseBlock = (_ request: URLRequest, _ parameters: [String: String]) -> HTTPStubsResponse
+
+/// A route template, like `/users/:id/orders/:orderId`
+private final class Route {
+  /// The segments of the template, with `nil` for its parameters
+  let segments: [String?]
+  /// The name of the parameter for each segment, with `nil` for its literals
+  let parameterNames: [String?]
+
+  init(_ template: String) {
+    let components = Route.segments(of: template)
+    let isParameter: (String) -> Bool = { $0.hasPrefix(":") && $0 != ":" }
+    segments = components.map { isParameter($0) ? nil : $0 }
+    parameterNames = components.map { isParameter($0) ? ($0 as NSString).substring(from: 1) : nil }
+  }
+
+  static func segments(of path: String) -> [String] {
+    return path.components(separatedBy: "/").filter { !$0.isEmpty }
+  }
+
+  func parameters(in pathSegments: [String]) -> [String: String] {
+    var parameters = [String: String]()
+    for (name, value) in zip(parameterNames, pathSegments) {
+      if let name = name {
+        parameters[name] = value
+      }
+    }
+    return parameters
+  }
+}
+
+/**
+ * The routes of all the stubs created with `stub(route:…)`, in a trie of path segments,
+ * so that the routes matching a path are found in a single walk down its segments, instead
+ * of testing the route of each stub in turn.
+ */
+private final class Router {
+  static let shared = Router()
+
+  final class Node {
+    var literals = [String: Node]()
+    var parameter: Node?
+    // Routes are owned by their stubs, so that they leave the trie when their stub is removed
+    var routes = [WeakRoute]()
+  }
+
+  struct WeakRoute {
+    weak var route: Route?
+  }
+
+  private let root = Node()
+  private let lock = NSLock()
+
+  func add(_ route: Route) {
+    lock.lock()
+    defer { lock.unlock() }
+    var node = root
+    for segment in route.segments {
+      if let literal = segment {
+        let child = node.literals[literal] ?? Node()
+        node.literals[literal] = child
+        node = child
+      } else {
+        let child = node.parameter ?? Node()
+        node.parameter = child
+        node = child
+      }
+    }
+    node.routes = node.routes.filter { $0.route != nil } + [WeakRoute(route: route)]
+  }
+
+  /// - Returns: the parameters of each route matching the path, by route
+  func matches(_ path: String) -> [ObjectIdentifier: [String: String]] {
+    let pathSegments = Route.segments(of: path)
+    var matches = [ObjectIdentifier: [String: String]]()
+    lock.lock()
+    defer { lock.unlock() }
+    var nodes = [root]
+    for segment in pathSegments {
+      var children = [Node]()
+      for node in nodes {
+        if let literal = node.literals[segment] { children.append(literal) }
+        if let parameter = node.parameter { children.append(parameter) }
+      }
+      if children.isEmpty { return matches }
+      nodes = children
+    }
+    for node in nodes {
+      for weakRoute in node.routes {
+        if let route = weakRoute.route {
+          matches[ObjectIdentifier(route)] = route.parameters(in: pathSegments)
+        }
+      }
+    }
+    return matches
+  }
+}
+
+extension ParsedRequest {
+  /// The parameters of each route matching the request's path, by route
+  fileprivate var routeMatches: [ObjectIdentifier: [String: String]] {
+    return part("routeMatches") { self.path.map(Router.shared.matches) ?? [:] }
+  }
+}
+
+/**
+ * Helper to stub the requests matching a route template, like `/users/:id/orders/:orderId`,
+ * and build their response from the values of the route's parameters in their path.
+ *
+ * The routes of all the stubs are kept in a single trie of path segments, which is walked once
+ * per request however many routes are stubbed, instead of testing a `pathMatches` regex per stub.
+ * When several routes match a path, the stubs are tested in the usual order (the last one added first).
+ *
+ * - Parameter template: the route to match, whose segments starting with `:` are parameters
+ *                       matching any single segment of the path (e.g. `/users/:id`)
+ * - Parameter condition: a matcher the request must also pass, e.g. `isMethodGET()`
+ * - Parameter response: the block building the stub response for the request and the values of the route's parameters
+ *
+ * - Returns: The opaque `HTTPStubsDescriptor` that uniquely identifies the stub
+ *            and can be later used to remove it with `removeStub:`
+ *
+ * - Note: Empty segments are ignored, so `/users/:id` also matches `/users/42/` or `//users/42`.
+ */
+@discardableResult
+public func stub(route template: String, condition: @escaping HTTPStubsTestBlock = { _ in true }, response: @escaping HTTPStubsRouteResponseBlock) -> HTTPStubsDescriptor {
+  let route = Route(template)
+  Router.shared.add(route)
+  // The blocks of the stub own the route, so that it stays in the router as long as the stub exists
+  return HTTPStubs.stubRequests(passingTest: { req in
+    ParsedRequest.parsed(req).routeMatches[ObjectIdentifier(route)] != nil && condition(req)
+  }, withStubResponse: { req in
+    response(req, ParsedRequest.parsed(req).routeMatches[ObjectIdentifier(route)] ?? [:])
+  })
+}
+#endif
+
+
+
+// MARK: Matcher costs
+
+/**
+ * How costly a matcher built by this library is to test. The `&&` and `||` operators only reorder
+ * matchers tagged with their cost, and keep any other closure where it was written.
+ */
+enum MatcherCost: Int {
+  /// Compares the method, a header or a part of the URL
+  case request
+  /// Parses the query or evaluates a regular expression
+  case parsing
+  /// Reads or parses the body
+  case body
+}
+
+#if swift(>=3.0)
+/**
+ * The costs of the matchers built by this library, so that the `&&` and `||` operators know them
+ * when combining matchers, before testing any request.
+ *
+ * Matchers are plain closures, so their cost is registered under the context of the closure
+ * returned by `tagged(_:_:)`, which is unique while that closure is alive. A closure wrapped
+ * into another one on the way (like when it is stored as a generic value) is no longer found,
+ * and is then treated like any other closure.
+ */
+final class MatcherCosts {
+  private static let lock = NSLock()
+  private static var costs = [UnsafeRawPointer: MatcherCost]()
+
+  /// Captured by a tagged matcher, to unregister its cost before the memory of its context is reused
+  private final class Registration {
+    var context: UnsafeRawPointer?
+
+    deinit {
+      guard let context = context else { return }
+      MatcherCosts.lock.lock()
+      MatcherCosts.costs[context] = nil
+      MatcherCosts.lock.unlock()
+    }
+  }
+
+  static func register(_ cost: MatcherCost, _ matcher: @escaping HTTPStubsTestBlock) -> HTTPStubsTestBlock {
+    let registration = Registration()
+    let registeredMatcher: HTTPStubsTestBlock = { req in
+      return withExtendedLifetime(registration) { matcher(req) }
+    }
+    guard let context = MatcherCosts.context(of: registeredMatcher) else { return registeredMatcher }
+    registration.context = context
+    lock.lock()
+    costs[context] = cost
+    lock.unlock()
+    return registeredMatcher
+  }
+
+  /// The cost of a matcher built by this library, `nil` for any other closure
+  static func cost(of matcher: HTTPStubsTestBlock) -> MatcherCost? {
+    guard let context = MatcherCosts.context(of: matcher) else { return nil }
+    lock.lock()
+    defer { lock.unlock() }
+    return costs[context]
+  }
+
+  private static func context(of matcher: HTTPStubsTestBlock) -> UnsafeRawPointer? {
+    // A closure is a pointer to its function followed by a pointer to its context
+    return unsafeBitCast(matcher, to: (UnsafeRawPointer, UnsafeRawPointer?).self).1
+  }
+}
+
+/**
+ * Tags a matcher built by this library with its cost, which the `&&` and `||` operators
+ * read when combining it with another matcher.
+ */
+func tagged(_ cost: MatcherCost, _ matcher: @escaping HTTPStubsTestBlock) -> HTTPStubsTestBlock {
+  return MatcherCosts.register(cost, matcher)
+}
+#else
+func tagged(cost: MatcherCost, _ matcher: HTTPStubsTestBlock) -> HTTPStubsTestBlock {
+  return matcher
+}
+#endif
+
 
 
 // MARK: Create HTTPStubsTestBlock matchers
@@ -124,7 +481,7 @@ import Foundation
  *            is using the GET method
  */
 public func isMethodGET() -> HTTPStubsTestBlock {
-  return { $0.httpMethod == "GET" }
+  return tagged(.request) { $0.httpMethod == "GET" }
 }
 
 /**
@@ -134,7 +491,7 @@ public func isMethodGET() -> HTTPStubsTestBlock {
  *            is using the POST method
  */
 public func isMethodPOST() -> HTTPStubsTestBlock {
-  return { $0.httpMethod == "POST" }
+  return tagged(.request) { $0.httpMethod == "POST" }
 }
 
 /**
@@ -144,7 +501,7 @@ public func isMethodPOST() -> HTTPStubsTestBlock {
  *            is using the PUT method
  */
 public func isMethodPUT() -> HTTPStubsTestBlock {
-  return { $0.httpMethod == "PUT" }
+  return tagged(.request) { $0.httpMethod == "PUT" }
 }
 
 /**
@@ -154,7 +511,7 @@ public func isMethodPUT() -> HTTPStubsTestBlock {
  *            is using the PATCH method
  */
 public func isMethodPATCH() -> HTTPStubsTestBlock {
-  return { $0.httpMethod == "PATCH" }
+  return tagged(.request) { $0.httpMethod == "PATCH" }
 }
 
 /**
@@ -164,7 +521,7 @@ public func isMethodPATCH() -> HTTPStubsTestBlock {
  *            is using the DELETE method
  */
 public func isMethodDELETE() -> HTTPStubsTestBlock {
-  return { $0.httpMethod == "DELETE" }
+  return tagged(.request) { $0.httpMethod == "DELETE" }
 }
 
 /**
@@ -174,7 +531,7 @@ public func isMethodDELETE() -> HTTPStubsTestBlock {
  *            is using the HEAD method
  */
 public func isMethodHEAD() -> HTTPStubsTestBlock {
-    return { $0.httpMethod == "HEAD" }
+    return tagged(.request) { $0.httpMethod == "HEAD" }
 }
 
 /**
@@ -188,7 +545,7 @@ public func isMethodHEAD() -> HTTPStubsTestBlock {
  *            has the given absolute url
  */
 public func isAbsoluteURLString(_ url: String) -> HTTPStubsTestBlock {
-  return { req in req.url?.absoluteString == url }
+  return tagged(.request) { req in req.url?.absoluteString == url }
 }
 
 /**
@@ -204,7 +561,7 @@ public func isAbsoluteURLString(_ url: String) -> HTTPStubsTestBlock {
 public func isScheme(_ scheme: String) -> HTTPStubsTestBlock {
   precondition(!scheme.contains("://"), "The scheme part of an URL never contains '://'. Only use strings like 'https' for this value, and not things like 'https://'")
   precondition(!scheme.contains("/"), "The scheme part of an URL never contains any slash. Only use strings like 'https' for this value, and not things like 'https://api.example.com/'")
-  return { req in req.url?.scheme == scheme }
+  return tagged(.request) { req in req.url?.scheme == scheme }
 }
 
 /**
@@ -219,7 +576,7 @@ public func isScheme(_ scheme: String) -> HTTPStubsTestBlock {
  */
 public func isHost(_ host: String) -> HTTPStubsTestBlock {
   precondition(!host.contains("/"), "The host part of an URL never contains any slash. Only use strings like 'api.example.com' for this value, and not things like 'https://api.example.com/'")
-  return { req in req.url?.host == host }
+  return tagged(.request) { req in req.url?.host == host }
 }
 
 /**
@@ -236,12 +593,12 @@ public func isHost(_ host: String) -> HTTPStubsTestBlock {
  *         should include in the `path` parameter unless you're testing relative URLs)
  */
 public func isPath(_ path: String) -> HTTPStubsTestBlock {
-  return { req in req.url?.path == path }
+  return tagged(.request) { req in getPath(req) == path }
 }
 
 private func getPath(_ req: URLRequest) -> String? {
   #if swift(>=3.0)
-    return req.url?.path // In Swift 3, path is non-optional
+    return ParsedRequest.parsed(req).path
   #else
     return req.url?.path
   #endif
@@ -258,7 +615,7 @@ private func getPath(_ req: URLRequest) -> String? {
  *         should include in the `path` parameter unless you're testing relative URLs)
  */
 public func pathStartsWith(_ path: String) -> HTTPStubsTestBlock {
-  return { req in getPath(req)?.hasPrefix(path) ?? false }
+  return tagged(.request) { req in getPath(req)?.hasPrefix(path) ?? false }
 }
 
 /**
@@ -270,7 +627,7 @@ public func pathStartsWith(_ path: String) -> HTTPStubsTestBlock {
  *            path ends with the given string
  */
 public func pathEndsWith(_ path: String) -> HTTPStubsTestBlock {
-  return { req in getPath(req)?.hasSuffix(path) ?? false }
+  return tagged(.request) { req in getPath(req)?.hasSuffix(path) ?? false }
 }
 
 /**
@@ -284,7 +641,7 @@ public func pathEndsWith(_ path: String) -> HTTPStubsTestBlock {
  * - Note: URL paths are usually absolute and thus starts with a '/'
  */
 public func pathMatches(_ regex: NSRegularExpression) -> HTTPStubsTestBlock {
-  return { req in
+  return tagged(.parsing) { req in
     guard let path = getPath(req) else { return false }
     let range = NSRange(location: 0, length: path.utf16.count)
     #if swift(>=3.0)
@@ -333,7 +690,7 @@ public func pathMatches(_ regexString: String, options: NSRegularExpression.Opti
  *            ends with the given extension
  */
 public func isExtension(_ ext: String) -> HTTPStubsTestBlock {
-  return { req in req.url?.pathExtension == ext }
+  return tagged(.request) { req in req.url?.pathExtension == ext }
 }
 
 /**
@@ -350,15 +707,17 @@ public func isExtension(_ ext: String) -> HTTPStubsTestBlock {
  */
 @available(iOS 8.0, OSX 10.10, *)
 public func containsQueryParams(_ params: [String:String?]) -> HTTPStubsTestBlock {
-  return { req in
-    if let url = req.url {
-      let comps = NSURLComponents(url: url, resolvingAgainstBaseURL: true)
-      if let queryItems = comps?.queryItems {
-        for (k,v) in params {
-          if queryItems.filter({ qi in qi.name == k && qi.value == v }).count == 0 { return false }
-        }
-        return true
+  return tagged(.parsing) { req in
+    #if swift(>=3.0)
+      let queryItems = ParsedRequest.parsed(req).queryItems
+    #else
+      let queryItems = req.url.flatMap { NSURLComponents(url: $0, resolvingAgainstBaseURL: true)?.queryItems }
+    #endif
+    if let queryItems = queryItems {
+      for (k,v) in params {
+        if queryItems.filter({ qi in qi.name == k && qi.value == v }).count == 0 { return false }
       }
+      return true
     }
     return false
   }
@@ -371,7 +730,7 @@ public func containsQueryParams(_ params: [String:String?]) -> HTTPStubsTestBloc
  * - Returns: a matcher that returns true if the `NSURLRequest`'s headers contain a value for the key name
  */
 public func hasHeaderNamed(_ name: String) -> HTTPStubsTestBlock {
-  return { (req: URLRequest) -> Bool in
+  return tagged(.request) { (req: URLRequest) -> Bool in
     return req.value(forHTTPHeaderField: name) != nil
   }
 }
@@ -385,7 +744,7 @@ public func hasHeaderNamed(_ name: String) -> HTTPStubsTestBlock {
  *            is equal to the parameter value
  */
 public func hasHeaderNamed(_ name: String, value: String) -> HTTPStubsTestBlock {
-  return { (req: URLRequest) -> Bool in
+  return tagged(.request) { (req: URLRequest) -> Bool in
     return req.value(forHTTPHeaderField: name) == value
   }
 }
@@ -398,11 +757,20 @@ public func hasHeaderNamed(_ name: String, value: String) -> HTTPStubsTestBlock
  */
 #if swift(>=3.0)
   public func hasBody(_ body: Data) -> HTTPStubsTestBlock {
-    return { req in (req as NSURLRequest).ohhttpStubs_HTTPBody() == body }
+    NSURLRequest.ohhttpStubs_setHTTPBodyCaptureEnabled(true)
+    let fingerprint: Data = NSURLRequest.ohhttpStubs_fingerprint(for: body)
+    return tagged(.body) { req in
+      let request = req as NSURLRequest
+      // Rule out most of the other bodies by their fingerprint, without comparing their bytes
+      if let requestFingerprint = request.ohhttpStubs_HTTPBodyFingerprint(), requestFingerprint != fingerprint {
+        return false
+      }
+      return request.ohhttpStubs_HTTPBodyIsEqual(to: body)
+    }
   }
 #else
   public func hasBody(_ body: NSData) -> HTTPStubsTestBlock {
-    return { req in req.OHOHHTTPStubs_HTTPBody() == body }
+    return tagged(.body) { req in req.OHOHHTTPStubs_HTTPBody() == body }
   }
 #endif
 
@@ -414,14 +782,9 @@ public func hasHeaderNamed(_ name: String, value: String) -> HTTPStubsTestBlock
  */
 #if swift(>=3.0)
 public func hasJsonBody(_ jsonObject: [AnyHashable : Any]) -> HTTPStubsTestBlock {
-  return { req in
-    guard
-      let httpBody = req.ohhttpStubs_httpBody,
-      let jsonBody = (try? JSONSerialization.jsonObject(with: httpBody, options: [])) as? [AnyHashable : Any]
-    else {
-      return false
-    }
-    return NSDictionary(dictionary: jsonBody).isEqual(to: jsonObject)
+  NSURLRequest.ohhttpStubs_setHTTPBodyCaptureEnabled(true)
+  return tagged(.body) { req in
+    ParsedRequest.parsed(req).jsonBody?.isEqual(to: jsonObject) ?? false
   }
 }
 #endif
@@ -448,18 +811,11 @@ public func hasFormBody(_ params: [String: String?]) -> HTTPStubsTestBlock {
  */
 @available(iOS 8.0, OSX 10.10, *)
 public func hasFormBody(_ queryItems: [URLQueryItem]) -> HTTPStubsTestBlock {
-    return { req in
-        guard
-            case "application/x-www-form-urlencoded"? = req.value(forHTTPHeaderField: "Content-Type"),
-            let httpBody = req.ohhttpStubs_httpBody,
-            let query = String(data: httpBody, encoding: .utf8)
-            else { return false }
-        let items: [URLQueryItem] = {
-            var comps = URLComponents()
-            comps.percentEncodedQuery = query
-            return comps.queryItems ?? []
-        }()
-        return items.sorted(by: { $0.name < $1.name }) == queryItems.sorted(by: { $0.name < $1.name })
+    NSURLRequest.ohhttpStubs_setHTTPBodyCaptureEnabled(true)
+    let expectedItems = queryItems.sorted(by: { $0.name < $1.name })
+    return tagged(.body) { req in
+        guard let items = ParsedRequest.parsed(req).formItems else { return false }
+        return items == expectedItems
     }
 }
 
@@ -478,6 +834,29 @@ public func hasFormBody(_ queryItems: URLQueryItem...) -> HTTPStubsTestBlock {
 
 // MARK: Operators on HTTPStubsTestBlock
 
+#if swift(>=3.0)
+/**
+ * Combines two matchers with a short-circuiting operation ('AND' or 'OR'), testing first the
+ * matcher that is the cheapest to test when both were built by this library.
+ *
+ * The order is decided here, from the costs of both matchers (see `MatcherCosts`): the cheapest
+ * first if both are known, else the written order, so that a closure guarded by the other matcher
+ * (like `isHost("x") && { $0.url!.pathComponents[2] == "y" }`) is never tested on its own. This way
+ * `hasJsonBody(…) && isHost("a")` tests the host first, and only parses the body of the requests to
+ * that host. The combination of two library matchers is itself tagged with the highest of their costs.
+ */
+func shortCircuiting(_ lhs: @escaping HTTPStubsTestBlock, _ rhs: @escaping HTTPStubsTestBlock, shortCircuitResult: Bool) -> HTTPStubsTestBlock {
+  guard let lhsCost = MatcherCosts.cost(of: lhs), let rhsCost = MatcherCosts.cost(of: rhs) else {
+    return { req in lhs(req) == shortCircuitResult ? shortCircuitResult : rhs(req) }
+  }
+  let swapped = rhsCost.rawValue < lhsCost.rawValue
+  let (first, second) = swapped ? (rhs, lhs) : (lhs, rhs)
+  return tagged(swapped ? lhsCost : rhsCost) { req in
+    first(req) == shortCircuitResult ? shortCircuitResult : second(req)
+  }
+}
+#endif
+
 /**
  * Combine different `HTTPStubsTestBlock` matchers with an 'OR' operation.
  *
@@ -485,10 +864,13 @@ public func hasFormBody(_ queryItems: URLQueryItem...) -> HTTPStubsTestBlock {
  * - Parameter rhs: the second matcher to test
  *
  * - Returns: a matcher (`HTTPStubsTestBlock`) that succeeds if either of the given matchers succeeds
+ *
+ * - Note: When both matchers are built by this library (like `isHost` or `hasJsonBody`), the cheapest
+ *         one is tested first, which is not always `lhs`. Any other closure is tested in the written order.
  */
 #if swift(>=3.0)
   public func || (lhs: @escaping HTTPStubsTestBlock, rhs: @escaping HTTPStubsTestBlock) -> HTTPStubsTestBlock {
-    return { req in lhs(req) || rhs(req) }
+    return shortCircuiting(lhs, rhs, shortCircuitResult: true)
   }
 #else
   public func || (lhs: HTTPStubsTestBlock, rhs: HTTPStubsTestBlock) -> HTTPStubsTestBlock {
@@ -503,10 +885,13 @@ public func hasFormBody(_ queryItems: URLQueryItem...) -> HTTPStubsTestBlock {
  * - Parameter rhs: the second matcher to test
  *
  * - Returns: a matcher (`HTTPStubsTestBlock`) that only succeeds if both of the given matchers succeeds
+ *
+ * - Note: When both matchers are built by this library (like `isHost` or `hasJsonBody`), the cheapest
+ *         one is tested first, which is not always `lhs`. Any other closure is tested in the written order.
  */
 #if swift(>=3.0)
   public func && (lhs: @escaping HTTPStubsTestBlock, rhs: @escaping HTTPStubsTestBlock) -> HTTPStubsTestBlock {
-    return { req in lhs(req) && rhs(req) }
+    return shortCircuiting(lhs, rhs, shortCircuitResult: false)
   }
 #else
   public func && (lhs: HTTPStubsTestBlock, rhs: HTTPStubsTestBlock) -> HTTPStubsTestBlock {
@@ -520,10 +905,15 @@ public func hasFormBody(_ queryItems: URLQueryItem...) -> HTTPStubsTestBlock {
  * - Parameter expr: the matcher to negate
  *
  * - Returns: a matcher (HTTPStubsTestBlock) that only succeeds if the expr matcher fails
+ *
+ * - Note: The negation of a matcher built by this library keeps its cost, so `&&` and `||` still reorder it.
  */
 #if swift(>=3.0)
   public prefix func ! (expr: @escaping HTTPStubsTestBlock) -> HTTPStubsTestBlock {
-    return { req in !expr(req) }
+    guard let cost = MatcherCosts.cost(of: expr) else {
+      return { req in !expr(req) }
+    }
+    return tagged(cost) { req in !expr(req) }
   }
 #else
   public prefix func ! (expr: HTTPStubsTestBlock) -> HTTPStubsTestBlock {
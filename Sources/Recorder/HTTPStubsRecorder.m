@@ -0,0 +1,549 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+#if ! __has_feature(objc_arc)
+#error This file is expected to be compiled with ARC turned ON
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Imports
+
+#import "HTTPStubsRecorder.h"
+#import "HTTPStubs.h"
+#import "HTTPStubsResponse.h"
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Defines & Constants
+
+static NSUInteger const kDefaultMaxBodySize = 16 * 1024 * 1024;
+static unsigned long long const kDefaultMaxPendingBytes = 64 * 1024 * 1024;
+static NSUInteger const kMaxFileNameURLLength = 80;
+
+// Marks the requests sent by the forwarding session, so that they are never intercepted again
+static NSString* const kForwardedRequestPropertyKey = @"OHHTTPStubsForwardedRequest";
+
+static HTTPStubsRecorder* sActiveRecorder;
+
+// The body is decoded by the loader, and its length is written by the fixture formats themselves
+static NSDictionary* HTTPStubsRecordedHeaders(NSHTTPURLResponse* response)
+{
+    NSMutableDictionary* headers = [NSMutableDictionary dictionaryWithCapacity:response.allHeaderFields.count];
+    [response.allHeaderFields enumerateKeysAndObjectsUsingBlock:^(NSString* key, NSString* value, BOOL* stop) {
+        NSString* lowercaseKey = key.lowercaseString;
+        if (![lowercaseKey isEqualToString:@"content-encoding"]
+            && ![lowercaseKey isEqualToString:@"content-length"]
+            && ![lowercaseKey isEqualToString:@"transfer-encoding"])
+        {
+            headers[key] = value;
+        }
+    }];
+    return headers;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Private Interfaces
+
+@class HTTPStubsForwardingSession;
+
+@interface HTTPStubsRecorder () <HTTPStubsUnmatchedRequestHandler>
+@property(atomic, assign, readwrite) NSUInteger recordedCount;
+@property(atomic, assign, readwrite) NSUInteger droppedCount;
+@property(nonatomic, strong) dispatch_queue_t writerQueue;
+@property(atomic, strong, nullable) HTTPStubsForwardingSession* forwardingSession;
+@property(nonatomic, assign) unsigned long long pendingBytes; // Only accessed while synchronized on self
+@property(nonatomic, assign) NSUInteger fileCounter; // Only accessed while synchronized on self
+-(void)recordResponse:(NSHTTPURLResponse*)response body:(NSData*)body forRequest:(NSURLRequest*)request;
+-(void)dropResponse;
+@end
+
+// A request forwarded to the network on behalf of an NSURLProtocol, whose responses are relayed
+// to the protocol's client on the run loop it was started on
+@interface HTTPStubsForwardedLoad : NSObject
+@property(nonatomic, strong) HTTPStubsRecorder* recorder;
+@property(nonatomic, strong) NSURLRequest* request;
+@property(nonatomic, weak) NSURLProtocol* protocol;
+@property(nonatomic, assign) CFRunLoopRef clientRunLoop;
+@property(nonatomic, strong) NSURLSessionDataTask* task;
+@property(atomic, assign) BOOL cancelled;
+// Only accessed from the forwarding session's delegate queue
+@property(nonatomic, strong, nullable) NSHTTPURLResponse* response;
+@property(nonatomic, strong, nullable) NSMutableData* body;
+@property(nonatomic, assign) NSUInteger maxBodySize;
+@property(nonatomic, assign) BOOL bodyTooLarge;
+-(instancetype)initWithRecorder:(HTTPStubsRecorder*)recorder protocol:(NSURLProtocol*)protocol;
+// Nothing is relayed to the client after this call
+-(void)cancel;
+@end
+
+// Demultiplexes the callbacks of the shared forwarding session to the loads that started its tasks
+@interface HTTPStubsForwardingSession : NSObject <NSURLSessionDataDelegate>
+@property(nonatomic, strong) NSURLSession* session;
+@property(nonatomic, strong) NSMutableDictionary<NSNumber*, HTTPStubsForwardedLoad*>* loads;
+-(instancetype)initWithConfiguration:(NSURLSessionConfiguration*)configuration;
+-(void)startLoad:(HTTPStubsForwardedLoad*)load;
+@end
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Forwarded Loads
+
+@implementation HTTPStubsForwardedLoad
+
+-(instancetype)initWithRecorder:(HTTPStubsRecorder*)recorder protocol:(NSURLProtocol*)protocol
+{
+    self = [super init];
+    if (self)
+    {
+        _recorder = recorder;
+        _request = protocol.request;
+        _protocol = protocol;
+        _clientRunLoop = (CFRunLoopRef)CFRetain(CFRunLoopGetCurrent());
+        _maxBodySize = recorder.maxBodySize;
+        _body = [NSMutableData new];
+    }
+    return self;
+}
+
+-(void)dealloc
+{
+    CFRelease(_clientRunLoop);
+}
+
+-(void)cancel
+{
+    self.cancelled = YES;
+    [self.task cancel];
+}
+
+// Relay a callback to the protocol's client, in order, on the run loop which started the load
+-(void)relayToClient:(void(^)(NSURLProtocol* protocol, id<NSURLProtocolClient> client))block
+{
+    NSURLProtocol* protocol = self.protocol;
+    if (!protocol || self.cancelled)
+    {
+        return;
+    }
+    CFRunLoopPerformBlock(self.clientRunLoop, kCFRunLoopDefaultMode, ^{
+        if (!self.cancelled)
+        {
+            block(protocol, protocol.client);
+        }
+    });
+    CFRunLoopWakeUp(self.clientRunLoop);
+}
+
+-(void)appendData:(NSData*)data
+{
+    if (self.bodyTooLarge)
+    {
+        return;
+    }
+    if (self.body.length + data.length > self.maxBodySize)
+    {
+        // Keep relaying the response, but stop buffering it
+        self.bodyTooLarge = YES;
+        self.body = nil;
+        return;
+    }
+    [self.body appendData:data];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Forwarding Session
+
+@implementation HTTPStubsForwardingSession
+
+-(instancetype)initWithConfiguration:(NSURLSessionConfiguration*)configuration
+{
+    self = [super init];
+    if (self)
+    {
+        configuration = [configuration copy];
+        [HTTPStubs setEnabled:NO forSessionConfiguration:configuration];
+        // The client's loader already handles caching and cookies for the original request
+        configuration.URLCache = nil;
+        configuration.HTTPCookieStorage = nil;
+        configuration.HTTPShouldSetCookies = NO;
+
+        NSOperationQueue* delegateQueue = [NSOperationQueue new];
+        delegateQueue.maxConcurrentOperationCount = 1;
+        delegateQueue.name = @"OHHTTPStubs.recorder.forwarding";
+
+        _loads = [NSMutableDictionary new];
+        _session = [NSURLSession sessionWithConfiguration:configuration delegate:self delegateQueue:delegateQueue];
+    }
+    return self;
+}
+
+-(void)startLoad:(HTTPStubsForwardedLoad*)load
+{
+    NSMutableURLRequest* request = [load.request mutableCopy];
+    [NSURLProtocol setProperty:@YES forKey:kForwardedRequestPropertyKey inRequest:request];
+
+    NSURLSessionDataTask* task = [self.session dataTaskWithRequest:request];
+    load.task = task;
+    @synchronized(self.loads)
+    {
+        self.loads[@(task.taskIdentifier)] = load;
+    }
+    [task resume];
+}
+
+-(nullable HTTPStubsForwardedLoad*)loadForTask:(NSURLSessionTask*)task remove:(BOOL)remove
+{
+    @synchronized(self.loads)
+    {
+        NSNumber* key = @(task.taskIdentifier);
+        HTTPStubsForwardedLoad* load = self.loads[key];
+        if (remove)
+        {
+            [self.loads removeObjectForKey:key];
+        }
+        return load;
+    }
+}
+
+-(void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask
+didReceiveResponse:(NSURLResponse *)response
+ completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler
+{
+    HTTPStubsForwardedLoad* load = [self loadForTask:dataTask remove:NO];
+    if ([response isKindOfClass:NSHTTPURLResponse.class])
+    {
+        load.response = (NSHTTPURLResponse*)response;
+    }
+    [load relayToClient:^(NSURLProtocol* protocol, id<NSURLProtocolClient> client) {
+        [client URLProtocol:protocol didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+    }];
+    completionHandler(NSURLSessionResponseAllow);
+}
+
+-(void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data
+{
+    HTTPStubsForwardedLoad* load = [self loadForTask:dataTask remove:NO];
+    [load appendData:data];
+    [load relayToClient:^(NSURLProtocol* protocol, id<NSURLProtocolClient> client) {
+        [client URLProtocol:protocol didLoadData:data];
+    }];
+}
+
+-(void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task
+willPerformHTTPRedirection:(NSHTTPURLResponse *)response
+       newRequest:(NSURLRequest *)request
+completionHandler:(void (^)(NSURLRequest * _Nullable))completionHandler
+{
+    // Let the client follow the redirection itself, so that the new request goes through its own
+    // protocols (and is recorded separately if no stub matches it)
+    HTTPStubsForwardedLoad* load = [self loadForTask:task remove:YES];
+    NSMutableURLRequest* redirectRequest = [request mutableCopy];
+    [NSURLProtocol removePropertyForKey:kForwardedRequestPropertyKey inRequest:redirectRequest];
+    if (load && !load.cancelled)
+    {
+        [load.recorder recordResponse:response body:[NSData data] forRequest:load.request];
+    }
+    [load relayToClient:^(NSURLProtocol* protocol, id<NSURLProtocolClient> client) {
+        [client URLProtocol:protocol wasRedirectedToRequest:redirectRequest redirectResponse:response];
+        [client URLProtocol:protocol didFailWithError:[NSError errorWithDomain:NSCocoaErrorDomain code:NSUserCancelledError userInfo:nil]];
+    }];
+    completionHandler(nil);
+    [task cancel];
+}
+
+-(void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task
+didReceiveChallenge:(NSURLAuthenticationChallenge *)challenge
+completionHandler:(void (^)(NSURLSessionAuthChallengeDisposition, NSURLCredential * _Nullable))completionHandler
+{
+    completionHandler(NSURLSessionAuthChallengePerformDefaultHandling, nil);
+}
+
+-(void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didCompleteWithError:(nullable NSError *)error
+{
+    HTTPStubsForwardedLoad* load = [self loadForTask:task remove:YES];
+    if (!load)
+    {
+        // Already handed over to the client by a redirection
+        return;
+    }
+
+    // Record before finishing, so that the stub is already registered when the client gets its response
+    if (!error && !load.cancelled && load.response)
+    {
+        if (load.bodyTooLarge)
+        {
+            [load.recorder dropResponse];
+        }
+        else
+        {
+            [load.recorder recordResponse:load.response body:load.body forRequest:load.request];
+        }
+    }
+
+    [load relayToClient:^(NSURLProtocol* protocol, id<NSURLProtocolClient> client) {
+        if (error)
+        {
+            [client URLProtocol:protocol didFailWithError:error];
+        }
+        else
+        {
+            [client URLProtocolDidFinishLoading:protocol];
+        }
+    }];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Recorder
+
+@implementation HTTPStubsRecorder
+
++(nullable instancetype)activeRecorder
+{
+    @synchronized(HTTPStubsRecorder.class)
+    {
+        return sActiveRecorder;
+    }
+}
+
+-(instancetype)initWithDirectoryURL:(NSURL*)directoryURL format:(HTTPStubsRecordingFormat)format
+{
+    self = [super init];
+    if (self)
+    {
+        _directoryURL = directoryURL;
+        _format = format;
+        _maxBodySize = kDefaultMaxBodySize;
+        _maxPendingBytes = kDefaultMaxPendingBytes;
+        _registersStubs = YES;
+        _forwardingSessionConfiguration = [NSURLSessionConfiguration ephemeralSessionConfiguration];
+        _writerQueue = dispatch_queue_create("OHHTTPStubs.recorder.writer", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(_writerQueue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0));
+    }
+    return self;
+}
+
+-(void)dealloc
+{
+    // The session retains its delegate until it is invalidated
+    [_forwardingSession.session finishTasksAndInvalidate];
+}
+
+-(void)startRecording
+{
+    [NSFileManager.defaultManager createDirectoryAtURL:self.directoryURL withIntermediateDirectories:YES attributes:nil error:NULL];
+    @synchronized(self)
+    {
+        if (!self.forwardingSession)
+        {
+            self.forwardingSession = [[HTTPStubsForwardingSession alloc] initWithConfiguration:self.forwardingSessionConfiguration];
+        }
+    }
+    @synchronized(HTTPStubsRecorder.class)
+    {
+        sActiveRecorder = self;
+        [HTTPStubs setUnmatchedRequestHandler:self];
+    }
+}
+
+-(void)stopRecording
+{
+    @synchronized(HTTPStubsRecorder.class)
+    {
+        if (sActiveRecorder == self)
+        {
+            sActiveRecorder = nil;
+            if (HTTPStubs.unmatchedRequestHandler == self)
+            {
+                [HTTPStubs setUnmatchedRequestHandler:nil];
+            }
+        }
+    }
+}
+
+-(void)waitUntilAllWritten
+{
+    dispatch_sync(self.writerQueue, ^{});
+}
+
+-(void)recordResponse:(NSHTTPURLResponse*)response body:(NSData*)body forRequest:(NSURLRequest*)request
+{
+    NSDictionary* headers = HTTPStubsRecordedHeaders(response);
+    NSString* method = request.HTTPMethod ?: @"GET";
+    NSURL* url = request.URL;
+
+    if (self.registersStubs)
+    {
+        int statusCode = (int)response.statusCode;
+        id<HTTPStubsDescriptor> stub = [HTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest* candidate) {
+            return [(candidate.HTTPMethod ?: @"GET") isEqualToString:method] && [candidate.URL isEqual:url];
+        } withStubResponse:^HTTPStubsResponse*(NSURLRequest* candidate) {
+            return [HTTPStubsResponse responseWithData:body statusCode:statusCode headers:headers];
+        }];
+        stub.name = [NSString stringWithFormat:@"Recorded %@ %@", method, url.absoluteString];
+    }
+
+    // Never hold the response back: if the writer is lagging too far behind, drop the file instead
+    NSUInteger fileIndex;
+    @synchronized(self)
+    {
+        if (self.pendingBytes + body.length > self.maxPendingBytes)
+        {
+            self.droppedCount++;
+            return;
+        }
+        self.pendingBytes += body.length;
+        fileIndex = ++self.fileCounter;
+    }
+
+    dispatch_async(self.writerQueue, ^{
+        NSString* fileName = [self fileNameWithIndex:fileIndex method:method URL:url];
+        NSData* fileData = (self.format == HTTPStubsRecordingFormatMocktail)
+                         ? [self mocktailDataWithResponse:response headers:headers body:body method:method URL:url]
+                         : [self HTTPMessageDataWithResponse:response headers:headers body:body];
+        BOOL written = [fileData writeToURL:[self.directoryURL URLByAppendingPathComponent:fileName] atomically:YES];
+        @synchronized(self)
+        {
+            self.pendingBytes -= body.length;
+            if (written)
+            {
+                self.recordedCount++;
+            }
+            else
+            {
+                self.droppedCount++;
+            }
+        }
+    });
+}
+
+-(void)dropResponse
+{
+    @synchronized(self)
+    {
+        self.droppedCount++;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Unmatched Requests
+
+-(BOOL)shouldLoadUnmatchedRequest:(NSURLRequest*)request
+{
+    if ([HTTPStubsRecorder activeRecorder] != self || [NSURLProtocol propertyForKey:kForwardedRequestPropertyKey inRequest:request])
+    {
+        return NO;
+    }
+    NSString* scheme = request.URL.scheme.lowercaseString;
+    return [scheme isEqualToString:@"http"] || [scheme isEqualToString:@"https"];
+}
+
+-(dispatch_block_t)startLoadingUnmatchedRequestForProtocol:(NSURLProtocol*)protocol
+{
+    HTTPStubsForwardedLoad* load = [[HTTPStubsForwardedLoad alloc] initWithRecorder:self protocol:protocol];
+    [self.forwardingSession startLoad:load];
+    return ^{
+        [load cancel];
+    };
+}
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Fixture Formats
+
+-(NSString*)fileNameWithIndex:(NSUInteger)index method:(NSString*)method URL:(NSURL*)url
+{
+    NSString* location = [NSString stringWithFormat:@"%@%@", url.host ?: @"", url.path ?: @""];
+    NSMutableString* sanitized = [NSMutableString stringWithCapacity:location.length];
+    NSCharacterSet* allowed = NSCharacterSet.alphanumericCharacterSet;
+    for (NSUInteger i = 0; i < location.length && sanitized.length < kMaxFileNameURLLength; ++i)
+    {
+        unichar c = [location characterAtIndex:i];
+        [sanitized appendString:([allowed characterIsMember:c] && c < 128) ? [NSString stringWithCharacters:&c length:1] : @"_"];
+    }
+    NSString* extension = (self.format == HTTPStubsRecordingFormatMocktail) ? @"tail" : @"response";
+    return [NSString stringWithFormat:@"%04lu-%@-%@.%@", (unsigned long)index, method, sanitized, extension];
+}
+
+-(NSData*)HTTPMessageDataWithResponse:(NSHTTPURLResponse*)response headers:(NSDictionary*)headers body:(NSData*)body
+{
+    NSMutableString* head = [NSMutableString stringWithFormat:@"HTTP/1.1 %ld %@\r\n",
+                             (long)response.statusCode,
+                             [NSHTTPURLResponse localizedStringForStatusCode:response.statusCode].capitalizedString];
+    for (NSString* key in [headers.allKeys sortedArrayUsingSelector:@selector(caseInsensitiveCompare:)])
+    {
+        [head appendFormat:@"%@: %@\r\n", key, headers[key]];
+    }
+    [head appendFormat:@"Content-Length: %lu\r\n\r\n", (unsigned long)body.length];
+
+    NSMutableData* data = [[head dataUsingEncoding:NSUTF8StringEncoding] mutableCopy];
+    [data appendData:body];
+    return data;
+}
+
+-(NSData*)mocktailDataWithResponse:(NSHTTPURLResponse*)response headers:(NSDictionary*)headers body:(NSData*)body
+                            method:(NSString*)method URL:(NSURL*)url
+{
+    NSString* contentType = @"application/octet-stream";
+    NSMutableString* otherHeaders = [NSMutableString new];
+    for (NSString* key in [headers.allKeys sortedArrayUsingSelector:@selector(caseInsensitiveCompare:)])
+    {
+        if ([key caseInsensitiveCompare:@"Content-Type"] == NSOrderedSame)
+        {
+            contentType = headers[key];
+        }
+        else
+        {
+            [otherHeaders appendFormat:@"%@: %@\n", key, headers[key]];
+        }
+    }
+
+    // Mocktail files are text: any body which is not UTF-8 text is written in base64
+    NSString* textBody = [self isTextualContentType:contentType] ? [[NSString alloc] initWithData:body encoding:NSUTF8StringEncoding] : nil;
+    if (!textBody)
+    {
+        textBody = [body base64EncodedStringWithOptions:NSDataBase64Encoding76CharacterLineLength | NSDataBase64EncodingEndLineWithLineFeed];
+        contentType = [contentType stringByAppendingString:@";base64"];
+    }
+
+    NSString* tail = [NSString stringWithFormat:@"^%@$\n^%@$\n%ld\n%@\n%@\n%@",
+                      [NSRegularExpression escapedPatternForString:method],
+                      [NSRegularExpression escapedPatternForString:url.absoluteString],
+                      (long)response.statusCode,
+                      contentType,
+                      otherHeaders,
+                      textBody];
+    return [tail dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+-(BOOL)isTextualContentType:(NSString*)contentType
+{
+    NSString* type = contentType.lowercaseString;
+    return [type hasPrefix:@"text/"]
+        || [type containsString:@"json"]
+        || [type containsString:@"xml"]
+        || [type containsString:@"javascript"]
+        || [type containsString:@"x-www-form-urlencoded"];
+}
+
+@end
@@ -0,0 +1,161 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Imports
+
+#import <Foundation/Foundation.h>
+
+#import "Compatibility.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Types
+
+/**
+ *  The file format used to write the recorded responses
+ */
+typedef NS_ENUM(NSInteger, HTTPStubsRecordingFormat)
+{
+    /** Raw HTTP messages (`.response` files), as read by `+[HTTPStubsResponse responseWithHTTPMessageFileAtURL:]` */
+    HTTPStubsRecordingFormatHTTPMessage = 0,
+    /** Mocktail files (`.tail` files), as read by `+[HTTPStubs stubRequestsUsingMocktailsAtPath:inBundle:error:]` */
+    HTTPStubsRecordingFormatMocktail
+};
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Interface
+
+/**
+ *  Records the requests which are not matched by any stub.
+ *
+ *  While a recorder is recording, the requests that no stub matches are forwarded to
+ *  the network instead of being left to the next `NSURLProtocol`. Their responses are
+ *  passed to the client as soon as they arrive, and a copy is kept on the side to be
+ *  written as a fixture file in `directoryURL` on a background queue, and registered
+ *  as a stub so that the next identical requests are served from memory.
+ *
+ *  Writing the fixtures never delays the responses: when the bodies waiting to be
+ *  written go over `maxPendingBytes`, the new recordings are dropped instead.
+ *
+ *  The recorder is plugged in as the `+[HTTPStubs unmatchedRequestHandler]` while it is
+ *  recording, replacing any other handler.
+ *
+ *  @note HTTPStubs must be enabled (which is the default) for the requests to be
+ *        intercepted. Only one recorder can be recording at a time.
+ */
+@interface HTTPStubsRecorder : NSObject
+
+/**
+ *  The folder where the fixture files are written
+ */
+@property(nonatomic, strong, readonly) NSURL* directoryURL;
+
+/**
+ *  The format of the fixture files
+ */
+@property(nonatomic, assign, readonly) HTTPStubsRecordingFormat format;
+
+/**
+ *  The maximum size of a recorded body, in bytes. Responses with a larger body
+ *  are still forwarded to the client, but are not recorded.
+ *
+ *  Defaults to 16 MB.
+ */
+@property(atomic, assign) NSUInteger maxBodySize;
+
+/**
+ *  The maximum total size of the bodies waiting to be written, in bytes.
+ *
+ *  Defaults to 64 MB.
+ */
+@property(atomic, assign) unsigned long long maxPendingBytes;
+
+/**
+ *  Whether each recorded response is also registered as a stub, so that the
+ *  requests with the same method and URL are not forwarded again.
+ *
+ *  Defaults to `YES`.
+ */
+@property(atomic, assign) BOOL registersStubs;
+
+/**
+ *  The configuration of the session forwarding the requests to the network. HTTPStubs is
+ *  always disabled for it, and its cache and cookie storage are dropped, as the client's own
+ *  session already handles them for the original requests.
+ *
+ *  This is only read the first time the recorder starts recording.
+ *  Defaults to an ephemeral session configuration.
+ */
+@property(nonatomic, copy) NSURLSessionConfiguration* forwardingSessionConfiguration;
+
+/**
+ *  The number of fixture files written so far.
+ */
+@property(atomic, assign, readonly) NSUInteger recordedCount;
+
+/**
+ *  The number of responses which were not recorded, because their body was over
+ *  `maxBodySize` or because too many bytes were waiting to be written.
+ */
+@property(atomic, assign, readonly) NSUInteger droppedCount;
+
+/**
+ *  The recorder currently recording, if any.
+ */
++(nullable instancetype)activeRecorder;
+
+/**
+ *  Create a new recorder.
+ *
+ *  @param directoryURL The folder where the fixture files will be written. It is
+ *                      created if it does not exist.
+ *  @param format       The format of the fixture files.
+ *
+ *  @return A new recorder, not recording yet.
+ */
+-(instancetype)initWithDirectoryURL:(NSURL*)directoryURL format:(HTTPStubsRecordingFormat)format NS_DESIGNATED_INITIALIZER;
+
+-(instancetype)init NS_UNAVAILABLE;
+
+/**
+ *  Start forwarding and recording the requests which are not matched by any stub.
+ *  This replaces the `activeRecorder`, if any.
+ */
+-(void)startRecording;
+
+/**
+ *  Stop recording. The requests already forwarded are still completed and recorded.
+ */
+-(void)stopRecording;
+
+/**
+ *  Block until all the recorded responses have been written to disk.
+ */
+-(void)waitUntilAllWritten;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -26,8 +26,16 @@
 #import "NSURLRequest+HTTPBodyTesting.h"
 #import "HTTPStubs.h"
 #import "HTTPStubsResponse.h"
+#import "HTTPStubsFileMetadata.h"
+#import "HTTPStubsFixtureCache.h"
 #import "HTTPStubsResponse+JSON.h"
+#import "HTTPStubsResponse+EventStream.h"
+#import "HTTPStubsResponseTemplate.h"
 #import "HTTPStubsResponse+HTTPMessage.h"
 #import "HTTPStubs+Mocktail.h"
+#import "HTTPStubsBase64.h"
+#import "HTTPStubs+HAR.h"
+#import "HTTPStubsHARReplay.h"
+#import "HTTPStubsRecorder.h"
 #import "HTTPStubsPathHelpers.h"
 
@@ -30,6 +30,7 @@
 #if OHHTTPSTUBS_USE_STATIC_LIBRARY || SWIFT_PACKAGE
 #import "HTTPStubs.h"
 #import "HTTPStubs+Mocktail.h"
+#import "HTTPStubsBase64.h"
 #import "HTTPStubsResponse+JSON.h"
 #else
 @import OHHTTPStubs;
@@ -76,6 +77,359 @@
     [self runGetCards];
 }
 
+- (void)testMocktailsAtFolderAreRegisteredTogether
+{
+    NSError *error = nil;
+    NSBundle *bundle = [NSBundle bundleForClass:self.class];
+    NSArray *descriptors = [HTTPStubs stubRequestsUsingMocktailsAtPath:@"MocktailFolder" inBundle:bundle error:&error];
+    XCTAssertNil(error, @"Error while stubbing Mocktails at folder 'MocktailFolder': %@", [error localizedDescription]);
+    XCTAssertEqual(descriptors.count, (NSUInteger)1, @"A folder should be stubbed with a single routing stub");
+    XCTAssertEqualObjects([HTTPStubs allStubs], descriptors);
+    XCTAssertEqualObjects([descriptors.firstObject name], @"MocktailFolder");
+}
+
+- (void)testMocktailsAtFolderRouting
+{
+    NSString *rootPath = [NSTemporaryDirectory() stringByAppendingPathComponent:NSUUID.UUID.UUIDString];
+    NSString *folderPath = [rootPath stringByAppendingPathComponent:@"tails"];
+    [NSFileManager.defaultManager createDirectoryAtPath:folderPath withIntermediateDirectories:YES attributes:nil error:NULL];
+    NSDictionary<NSString *, NSString *> *tails = @{
+        @"user.tail": @"GET\n^http://api\\.example\\.com/users/[0-9]+$\n200\ntext/plain\n\nuser",
+        @"users.tail": @"GET|POST\n^HTTP://API\\.EXAMPLE\\.COM/users$\n200\ntext/plain\n\nusers",
+        @"delete.tail": @"^DELETE$\n.*/users/[0-9]+$\n204\ntext/plain\n\n",
+        @"any.tail": @"[A-Z]+\n^http://other\\.example\\.com/\n200\ntext/plain\n\nother",
+    };
+    [tails enumerateKeysAndObjectsUsingBlock:^(NSString *fileName, NSString *content, BOOL *stop) {
+        [content writeToFile:[folderPath stringByAppendingPathComponent:fileName] atomically:YES encoding:NSUTF8StringEncoding error:NULL];
+    }];
+
+    NSError *error = nil;
+    [HTTPStubs stubRequestsUsingMocktailsAtPath:@"tails" inBundle:[NSBundle bundleWithPath:rootPath] error:&error];
+    XCTAssertNil(error, @"Error while stubbing Mocktails at folder 'tails': %@", [error localizedDescription]);
+
+    NSArray<NSArray *> *expectations = @[
+        @[@"GET", @"http://api.example.com/users/42", @200, @"user"],
+        @[@"POST", @"http://api.example.com/users", @200, @"users"],
+        @[@"DELETE", @"http://api.example.com/users/42", @204, @""],
+        @[@"PATCH", @"http://other.example.com/anything", @200, @"other"],
+    ];
+    for (NSArray *expected in expectations)
+    {
+        NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:expected[1]]];
+        request.HTTPMethod = expected[0];
+
+        XCTestExpectation* expectation = [self expectationWithDescription:[expected componentsJoinedByString:@" "]];
+        [[self.session dataTaskWithRequest:request completionHandler:^(NSData *data, NSURLResponse *response, NSError *taskError) {
+            XCTAssertNil(taskError, @"%@ %@", expected[0], expected[1]);
+            XCTAssertEqual(((NSHTTPURLResponse *)response).statusCode, [expected[2] integerValue], @"%@ %@", expected[0], expected[1]);
+            XCTAssertEqualObjects([[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding], expected[3], @"%@ %@", expected[0], expected[1]);
+            [expectation fulfill];
+        }] resume];
+        [self waitForExpectationsWithTimeout:10 handler:nil];
+    }
+
+    [NSFileManager.defaultManager removeItemAtPath:rootPath error:NULL];
+}
+
+- (void)testMocktailsAtFolderRoutingUnanchoredPatterns
+{
+    NSURL *folderURL = [self temporaryFolderWithFiles:@{
+        @"tails/a_fallback.tail": @"GET\n.*\n200\ntext/plain\n\nfallback",
+        @"tails/b_alternatives.tail": @"GET\n/orders$|/invoices$\n200\ntext/plain\n\nalternatives",
+        @"tails/c_users.tail": @"GET\n.*/users\n200\ntext/plain\n\nusers",
+        @"tails/d_user.tail": @"GET\n.*/USERS/[0-9]+$\n200\ntext/plain\n\nuser",
+        @"tails/e_logo.tail": @"GET\nlogos?/(ebay|paypal)\\.png\n200\ntext/plain\n\nlogo",
+        @"tails/f_version.tail": @"GET\n/v[0-9]{2}/status\n200\ntext/plain\n\nstatus",
+    }];
+
+    NSError *error = nil;
+    NSArray *descriptors = [HTTPStubs stubRequestsUsingMocktailsAtPath:@"tails" inBundle:[NSBundle bundleWithURL:folderURL] error:&error];
+    XCTAssertEqual(descriptors.count, (NSUInteger)1, @"Error while stubbing Mocktails: %@", [error localizedDescription]);
+
+    // Files are listed in alphabetical order, and the last one matching a request wins
+    XCTAssertEqualObjects([self bodyOfRequestToURL:@"http://api.example.com/users"], @"users");
+    XCTAssertEqualObjects([self bodyOfRequestToURL:@"http://api.example.com/Users/42"], @"user");
+    XCTAssertEqualObjects([self bodyOfRequestToURL:@"http://cdn.example.com/logo/paypal.png"], @"logo");
+    XCTAssertEqualObjects([self bodyOfRequestToURL:@"http://cdn.example.com/logos/ebay.png"], @"logo");
+    XCTAssertEqualObjects([self bodyOfRequestToURL:@"http://api.example.com/v12/status"], @"status");
+    XCTAssertEqualObjects([self bodyOfRequestToURL:@"http://api.example.com/invoices"], @"alternatives");
+    XCTAssertEqualObjects([self bodyOfRequestToURL:@"http://api.example.com/v1/status"], @"fallback");
+    XCTAssertEqualObjects([self bodyOfRequestToURL:@"http://api.example.com/logos/ebay_png"], @"fallback");
+
+    [NSFileManager.defaultManager removeItemAtURL:folderURL error:NULL];
+}
+
+- (NSString *)bodyOfRequestToURL:(NSString *)urlString
+{
+    __block NSString *body = nil;
+    XCTestExpectation* expectation = [self expectationWithDescription:urlString];
+    [[self.session dataTaskWithURL:[NSURL URLWithString:urlString] completionHandler:^(NSData *data, NSURLResponse *response, NSError *taskError) {
+        body = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+        [expectation fulfill];
+    }] resume];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    return body;
+}
+
+- (void)testMocktailsWatchingFolder
+{
+    NSURL *folderURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:NSUUID.UUID.UUIDString] isDirectory:YES];
+    [NSFileManager.defaultManager createDirectoryAtURL:folderURL withIntermediateDirectories:YES attributes:nil error:NULL];
+    NSURL *tailURL = [folderURL URLByAppendingPathComponent:@"user.tail"];
+    [@"GET\n^http://api\\.example\\.com/user$\n200\ntext/plain\n\nbefore" writeToURL:tailURL atomically:YES encoding:NSUTF8StringEncoding error:NULL];
+
+    NSError *error = nil;
+    id<HTTPStubsDescriptor> descriptor = [HTTPStubs stubRequestsUsingMocktailsWatchingFolderAtURL:folderURL error:&error];
+    XCTAssertNotNil(descriptor, @"Error while watching the Mocktail folder: %@", [error localizedDescription]);
+    XCTAssertEqualObjects([self bodyOfRequestToURL:@"http://api.example.com/user"], @"before");
+
+    // Changed file
+    [@"GET\n^http://api\\.example\\.com/user$\n200\ntext/plain\n\nafter" writeToURL:tailURL atomically:YES encoding:NSUTF8StringEncoding error:NULL];
+    // Added file
+    [@"GET\n^http://api\\.example\\.com/cards$\n200\ntext/plain\n\ncards" writeToURL:[folderURL URLByAppendingPathComponent:@"cards.tail"] atomically:YES encoding:NSUTF8StringEncoding error:NULL];
+
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:10];
+    while (![[self bodyOfRequestToURL:@"http://api.example.com/user"] isEqualToString:@"after"] && timeout.timeIntervalSinceNow > 0)
+    {
+        [NSThread sleepForTimeInterval:0.1];
+    }
+    XCTAssertEqualObjects([self bodyOfRequestToURL:@"http://api.example.com/user"], @"after");
+    XCTAssertEqualObjects([self bodyOfRequestToURL:@"http://api.example.com/cards"], @"cards");
+
+    [HTTPStubs removeStub:descriptor];
+    [NSFileManager.defaultManager removeItemAtURL:folderURL error:NULL];
+}
+
+- (NSURL *)temporaryFolderWithFiles:(NSDictionary<NSString *, NSString *> *)files
+{
+    NSURL *folderURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:NSUUID.UUID.UUIDString] isDirectory:YES];
+    [files enumerateKeysAndObjectsUsingBlock:^(NSString *path, NSString *content, BOOL *stop) {
+        NSURL *fileURL = [folderURL URLByAppendingPathComponent:path];
+        [NSFileManager.defaultManager createDirectoryAtURL:fileURL.URLByDeletingLastPathComponent withIntermediateDirectories:YES attributes:nil error:NULL];
+        [content writeToURL:fileURL atomically:YES encoding:NSUTF8StringEncoding error:NULL];
+    }];
+    return folderURL;
+}
+
+- (void)testMocktailsRecursively
+{
+    NSURL *folderURL = [self temporaryFolderWithFiles:@{
+        @"root.tail": @"GET\n^http://api\\.example\\.com/root$\n200\ntext/plain\n\nroot",
+        @"users/list.tail": @"GET\n^http://api\\.example\\.com/users$\n200\ntext/plain\n\nusers",
+        @"users/admins/list.tail": @"GET\n^http://api\\.example\\.com/users/admins$\n200\ntext/plain\n\nadmins",
+    }];
+
+    NSError *error = nil;
+    id<HTTPStubsDescriptor> descriptor = [HTTPStubs stubRequestsUsingMocktailsRecursivelyAtURL:folderURL error:&error];
+    XCTAssertNotNil(descriptor, @"Error while stubbing the Mocktail folder: %@", [error localizedDescription]);
+
+    XCTAssertEqualObjects([self bodyOfRequestToURL:@"http://api.example.com/root"], @"root");
+    XCTAssertEqualObjects([self bodyOfRequestToURL:@"http://api.example.com/users"], @"users");
+    XCTAssertEqualObjects([self bodyOfRequestToURL:@"http://api.example.com/users/admins"], @"admins");
+
+    [NSFileManager.defaultManager removeItemAtURL:folderURL error:NULL];
+}
+
+- (void)testMocktailContentLengthExcludesHeader
+{
+    NSURL *folderURL = [self temporaryFolderWithFiles:@{
+        @"users.tail": @"GET\n^http://api\\.example\\.com/users$\n200\ntext/plain\n\nusers",
+    }];
+    NSError *error = nil;
+    [HTTPStubs stubRequestsUsingMocktail:[folderURL URLByAppendingPathComponent:@"users.tail"] error:&error];
+    XCTAssertNil(error, @"Error while stubbing the Mocktail: %@", [error localizedDescription]);
+
+    XCTestExpectation* expectation = [self expectationWithDescription:@"users"];
+    [[self.session dataTaskWithURL:[NSURL URLWithString:@"http://api.example.com/users"] completionHandler:^(NSData *data, NSURLResponse *response, NSError *taskError) {
+        XCTAssertEqualObjects([[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding], @"users");
+        XCTAssertEqualObjects(((NSHTTPURLResponse *)response).allHeaderFields[@"Content-Length"], @"5");
+        [expectation fulfill];
+    }] resume];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+
+    [NSFileManager.defaultManager removeItemAtURL:folderURL error:NULL];
+}
+
+- (void)testMocktailsWithManifest
+{
+    NSURL *folderURL = [self temporaryFolderWithFiles:@{
+        MocktailManifestFileName: @"["
+            "{\"method\": \"GET\", \"url\": \"^http://api\\\\.example\\\\.com/users$\", \"file\": \"users/list.tail\"},"
+            "{\"method\": \"GET\", \"url\": \"^http://api\\\\.example\\\\.com/broken$\", \"file\": \"broken.tail\"}"
+        "]",
+        @"users/list.tail": @"GET\n.*\n200\ntext/plain\n\nusers",
+        @"broken.tail": @"GET\n.*",
+        @"unlisted.tail": @"GET\n.*\n200\ntext/plain\n\nunlisted",
+    }];
+
+    NSError *error = nil;
+    id<HTTPStubsDescriptor> descriptor = [HTTPStubs stubRequestsUsingMocktailsRecursivelyAtURL:folderURL error:&error];
+    XCTAssertNotNil(descriptor, @"Error while stubbing the Mocktail folder: %@", [error localizedDescription]);
+
+    // Files are matched with the patterns of the manifest, and only parsed once matched
+    XCTAssertEqualObjects([self bodyOfRequestToURL:@"http://api.example.com/users"], @"users");
+
+    XCTestExpectation* expectation = [self expectationWithDescription:@"broken"];
+    [[self.session dataTaskWithURL:[NSURL URLWithString:@"http://api.example.com/broken"] completionHandler:^(NSData *data, NSURLResponse *response, NSError *taskError) {
+        XCTAssertEqualObjects(taskError.domain, MocktailErrorDomain);
+        XCTAssertEqual(taskError.code, OHHTTPStubsMocktailErrorInvalidFileFormat);
+        [expectation fulfill];
+    }] resume];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+
+    [NSFileManager.defaultManager removeItemAtURL:folderURL error:NULL];
+}
+
+- (void)testMocktailsWithInvalidManifestPattern
+{
+    NSURL *folderURL = [self temporaryFolderWithFiles:@{
+        MocktailManifestFileName: @"[{\"method\": \"GET\", \"url\": \"^http://api\\\\.example\\\\.com/(users$\", \"file\": \"users.tail\"}]",
+        @"users.tail": @"GET\n.*\n200\ntext/plain\n\nusers",
+    }];
+
+    NSError *error = nil;
+    id<HTTPStubsDescriptor> descriptor = [HTTPStubs stubRequestsUsingMocktailsRecursivelyAtURL:folderURL error:&error];
+    XCTAssertNil(descriptor);
+    XCTAssertEqualObjects(error.domain, MocktailErrorDomain);
+    XCTAssertEqual(error.code, OHHTTPStubsMocktailErrorInvalidManifest);
+
+    [NSFileManager.defaultManager removeItemAtURL:folderURL error:NULL];
+}
+
+- (void)testMocktailsWithEmptyManifest
+{
+    NSURL *folderURL = [self temporaryFolderWithFiles:@{
+        MocktailManifestFileName: @"[]",
+    }];
+
+    NSError *error = nil;
+    id<HTTPStubsDescriptor> descriptor = [HTTPStubs stubRequestsUsingMocktailsRecursivelyAtURL:folderURL error:&error];
+    XCTAssertNotNil(descriptor, @"Error while stubbing the Mocktail folder: %@", [error localizedDescription]);
+    XCTAssertNil(error);
+    XCTAssertTrue([HTTPStubs removeStub:descriptor]);
+
+    [NSFileManager.defaultManager removeItemAtURL:folderURL error:NULL];
+}
+
+- (void)testMocktailPack
+{
+    NSError *error = nil;
+    NSBundle *bundle = [NSBundle bundleForClass:self.class];
+    NSURL *packURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:@"MocktailFolder.mocktailpack"]];
+    BOOL written = [HTTPStubs writeMocktailPackWithMocktailsAtURL:[bundle URLForResource:@"MocktailFolder" withExtension:nil] toURL:packURL error:&error];
+    XCTAssertTrue(written, @"Error while writing the Mocktail pack: %@", [error localizedDescription]);
+
+    id<HTTPStubsDescriptor> descriptor = [HTTPStubs stubRequestsUsingMocktailPack:packURL error:&error];
+    XCTAssertNotNil(descriptor, @"Error while stubbing the Mocktail pack: %@", [error localizedDescription]);
+    XCTAssertEqualObjects(descriptor.name, @"MocktailFolder.mocktailpack");
+
+    [self runLogin];
+    [self runGetCards];
+    [self runGetLogo];
+
+    [NSFileManager.defaultManager removeItemAtURL:packURL error:NULL];
+}
+
+- (void)testMocktailPackRouting
+{
+    NSURL *folderURL = [self temporaryFolderWithFiles:@{
+        @"a_fallback.tail": @"GET\n.*\n200\ntext/plain\n\nfallback",
+        @"b_users.tail": @"GET\n.*/users\n200\ntext/plain\n\nusers",
+        @"c_user.tail": @"GET|DELETE\n^http://api\\.example\\.com/users/[0-9]+$\n200\ntext/plain\n\nuser",
+        @"d_logo.tail": @"GET\nlogos?/(ebay|paypal)\\.png\n200\ntext/plain\n\nlogo",
+    }];
+    NSURL *packURL = [folderURL URLByAppendingPathComponent:@"routing.mocktailpack"];
+    NSError *error = nil;
+    XCTAssertTrue([HTTPStubs writeMocktailPackWithMocktailsAtURL:folderURL toURL:packURL error:&error], @"%@", error);
+    XCTAssertNotNil([HTTPStubs stubRequestsUsingMocktailPack:packURL error:&error], @"%@", error);
+
+    // Same routing as the folder itself: the last entry matching a request wins
+    XCTAssertEqualObjects([self bodyOfRequestToURL:@"http://api.example.com/users"], @"users");
+    XCTAssertEqualObjects([self bodyOfRequestToURL:@"http://API.example.com/users/42"], @"user");
+    XCTAssertEqualObjects([self bodyOfRequestToURL:@"http://cdn.example.com/logo/ebay.png"], @"logo");
+    XCTAssertEqualObjects([self bodyOfRequestToURL:@"http://api.example.com/cards"], @"fallback");
+
+    [NSFileManager.defaultManager removeItemAtURL:folderURL error:NULL];
+}
+
+- (void)testInvalidMocktailPack
+{
+    NSError *error = nil;
+    NSBundle *bundle = [NSBundle bundleForClass:self.class];
+    id<HTTPStubsDescriptor> descriptor = [HTTPStubs stubRequestsUsingMocktailPack:[bundle URLForResource:@"login" withExtension:@"tail"] error:&error];
+    XCTAssertNil(descriptor);
+    XCTAssertEqualObjects(error.domain, MocktailErrorDomain);
+    XCTAssertEqual(error.code, OHHTTPStubsMocktailErrorInvalidPackFile);
+}
+
+- (void)testMocktailBodyOffsetWithByteOrderMark
+{
+    NSURL *tailURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:@"bom.tail"]];
+    NSMutableData *tail = [NSMutableData dataWithBytes:"\xEF\xBB\xBF" length:3];
+    [tail appendData:[@"GET\n.*/bom\n200\ntext/plain;base64\n\naGVsbG8=" dataUsingEncoding:NSUTF8StringEncoding]];
+    [tail writeToURL:tailURL atomically:YES];
+
+    NSError *error = nil;
+    [HTTPStubs stubRequestsUsingMocktail:tailURL error:&error];
+    XCTAssertNil(error, @"Error while stubbing 'bom.tail':%@", [error localizedDescription]);
+
+    XCTestExpectation* expectation = [self expectationWithDescription:@"NSURLSessionDataTask completed"];
+    [[self.session dataTaskWithURL:[NSURL URLWithString:@"http://happywebservice.com/bom"] completionHandler:^(NSData *data, NSURLResponse *response, NSError *taskError) {
+        XCTAssertNil(taskError);
+        XCTAssertEqualObjects([[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding], @"hello");
+        [expectation fulfill];
+    }] resume];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+
+    [NSFileManager.defaultManager removeItemAtURL:tailURL error:NULL];
+}
+
+- (void)testMocktailHeaderWithUTF16ByteOrderMark
+{
+    NSURL *tailURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:@"utf16.tail"]];
+    NSMutableData *tail = [NSMutableData dataWithBytes:"\xFF\xFE" length:2];
+    [tail appendData:[@"GET\n.*/utf16\n200\ntext/plain;base64\nX-Encoding: utf-16\n\n" dataUsingEncoding:NSUTF16LittleEndianStringEncoding]];
+    // The body is kept as is: the base64 decoder skips the zero bytes of its UTF-16 characters
+    [tail appendData:[@"aGVsbG8=" dataUsingEncoding:NSUTF16LittleEndianStringEncoding]];
+    [tail writeToURL:tailURL atomically:YES];
+
+    NSError *error = nil;
+    [HTTPStubs stubRequestsUsingMocktail:tailURL error:&error];
+    XCTAssertNil(error, @"Error while stubbing 'utf16.tail':%@", [error localizedDescription]);
+
+    XCTestExpectation* expectation = [self expectationWithDescription:@"NSURLSessionDataTask completed"];
+    [[self.session dataTaskWithURL:[NSURL URLWithString:@"http://happywebservice.com/utf16"] completionHandler:^(NSData *data, NSURLResponse *response, NSError *taskError) {
+        XCTAssertNil(taskError);
+        XCTAssertEqual(((NSHTTPURLResponse *)response).statusCode, 200);
+        XCTAssertEqualObjects(((NSHTTPURLResponse *)response).allHeaderFields[@"X-Encoding"], @"utf-16");
+        XCTAssertEqualObjects([[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding], @"hello");
+        [expectation fulfill];
+    }] resume];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+
+    [NSFileManager.defaultManager removeItemAtURL:tailURL error:NULL];
+}
+
+- (void)testMocktailBodyOffsetWithLeadingBlankLines
+{
+    NSURL *tailURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:@"blank-lines.tail"]];
+    [[@"\n\n  \nGET\n.*/blank-lines\n200\ntext/plain\n\nhello" dataUsingEncoding:NSUTF8StringEncoding] writeToURL:tailURL atomically:YES];
+
+    NSError *error = nil;
+    [HTTPStubs stubRequestsUsingMocktail:tailURL error:&error];
+    XCTAssertNil(error, @"Error while stubbing 'blank-lines.tail':%@", [error localizedDescription]);
+
+    XCTestExpectation* expectation = [self expectationWithDescription:@"NSURLSessionDataTask completed"];
+    [[self.session dataTaskWithURL:[NSURL URLWithString:@"http://happywebservice.com/blank-lines"] completionHandler:^(NSData *data, NSURLResponse *response, NSError *taskError) {
+        XCTAssertNil(taskError);
+        XCTAssertEqualObjects([[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding], @"hello");
+        [expectation fulfill];
+    }] resume];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+
+    [NSFileManager.defaultManager removeItemAtURL:tailURL error:NULL];
+}
+
 - (void)testMocktailHeaders
 {
     NSError *error = nil;
@@ -105,6 +459,88 @@
     XCTAssertEqualObjects(response.allHeaderFields[@"Connection"], @"Close");
 }
 
+- (void)testMocktailBase64BodyOnRepeatedHits
+{
+    NSError *error = nil;
+    NSBundle *bundle = [NSBundle bundleForClass:self.class];
+    [HTTPStubs stubRequestsUsingMocktailsAtPath:@"MocktailFolder" inBundle:bundle error:&error];
+    XCTAssertNil(error, @"Error while stubbing Mocktails at folder 'MocktailFolder': %@", [error localizedDescription]);
+
+    NSData *firstLogo = [self runGetLogo];
+    NSData *secondLogo = [self runGetLogo];
+    XCTAssertEqualObjects(secondLogo, firstLogo, @"Every hit should return the same decoded body");
+}
+
+- (NSData *)randomPayloadOfLength:(NSUInteger)length
+{
+    NSMutableData *payload = [NSMutableData dataWithLength:length];
+    arc4random_buf(payload.mutableBytes, length);
+    return payload;
+}
+
+- (void)testBase64DecodingMatchesFoundation
+{
+    for (NSUInteger length = 0; length < 300; ++length)
+    {
+        NSData *payload = [self randomPayloadOfLength:length];
+        NSData *wrapped = [payload base64EncodedDataWithOptions:NSDataBase64Encoding76CharacterLineLength | NSDataBase64EncodingEndLineWithLineFeed];
+        NSData *unwrapped = [payload base64EncodedDataWithOptions:0];
+        XCTAssertEqualObjects(HTTPStubsBase64DecodedData(wrapped), payload, @"length %lu", (unsigned long)length);
+        XCTAssertEqualObjects(HTTPStubsBase64DecodedData(unwrapped), payload, @"length %lu", (unsigned long)length);
+    }
+
+    NSData *spaced = [@" SGVs\tbG8s\r\n IHdv cmxk\nIQ==\n" dataUsingEncoding:NSUTF8StringEncoding];
+    XCTAssertEqualObjects(HTTPStubsBase64DecodedData(spaced), [@"Hello, world!" dataUsingEncoding:NSUTF8StringEncoding]);
+    XCTAssertNil(HTTPStubsBase64DecodedData([@"SGVsb" dataUsingEncoding:NSUTF8StringEncoding]));
+}
+
+- (void)testBase64DecodingPerformance
+{
+    NSData *encoded = [[self randomPayloadOfLength:8 * 1024 * 1024] base64EncodedDataWithOptions:NSDataBase64Encoding76CharacterLineLength];
+    [self measureBlock:^{
+        @autoreleasepool {
+            XCTAssertEqual(HTTPStubsBase64DecodedData(encoded).length, (NSUInteger)8 * 1024 * 1024);
+        }
+    }];
+}
+
+- (void)testBase64DecodingPerformanceWithFoundation
+{
+    NSData *encoded = [[self randomPayloadOfLength:8 * 1024 * 1024] base64EncodedDataWithOptions:NSDataBase64Encoding76CharacterLineLength];
+    [self measureBlock:^{
+        @autoreleasepool {
+            NSData *decoded = [[NSData alloc] initWithBase64EncodedData:encoded options:NSDataBase64DecodingIgnoreUnknownCharacters];
+            XCTAssertEqual(decoded.length, (NSUInteger)8 * 1024 * 1024);
+        }
+    }];
+}
+
+- (NSData *)runGetLogo
+{
+    NSURL *url = [NSURL URLWithString:@"http://happywebservice.com/ebay.png"];
+
+    XCTestExpectation* expectation = [self expectationWithDescription:@"NSURLSessionDataTask completed"];
+
+    __block NSData *capturedData;
+    NSURLSessionDataTask *getDataTask = [self.session dataTaskWithURL:url completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+        XCTAssertNil(error, @"Error while getting logo.");
+        XCTAssertEqualObjects(response.MIMEType, @"image/png", @"The base64 marker should not be part of the Content-Type");
+
+        const uint8_t pngSignature[] = { 0x89, 'P', 'N', 'G' };
+        XCTAssertTrue(data.length > sizeof(pngSignature) && memcmp(data.bytes, pngSignature, sizeof(pngSignature)) == 0, @"The body is not a decoded PNG");
+        XCTAssertEqualObjects(((NSHTTPURLResponse *)response).allHeaderFields[@"Content-Length"], @(data.length).stringValue);
+        capturedData = data;
+
+        [expectation fulfill];
+    }];
+
+    [getDataTask resume];
+
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+
+    return capturedData;
+}
+
 - (NSHTTPURLResponse *)runLogin
 {
     NSURL *url = [NSURL URLWithString:@"http://happywebservice.com/users"];
@@ -459,6 +459,84 @@ class SwiftHelpersTests : XCTestCase {
   }
 
 #if swift(>=3.0)
+  func testHasBody() {
+    let body = "Hello world".data(using: .utf8)!
+    for (requestBody, expected) in [(body, true), ("Hello world!".data(using: .utf8)!, false), ("Hello World".data(using: .utf8)!, false)] {
+      var req = URLRequest(url: URL(string: "foo://bar")!)
+      req.httpBody = requestBody
+      XCTAssertEqual(hasBody(body)(req), expected)
+    }
+  }
+
+  func testStubBodies() {
+    let responses: [Data: HTTPStubsResponseBlock] = [
+      "q=cats".data(using: .utf8)!: { _ in HTTPStubsResponse(data: "cats".data(using: .utf8)!, statusCode: 200, headers: nil) },
+      "q=dogs".data(using: .utf8)!: { _ in HTTPStubsResponse(data: "dogs".data(using: .utf8)!, statusCode: 200, headers: nil) },
+    ]
+    let descriptor = stub(condition: isMethodPOST(), bodies: responses)
+    defer { HTTPStubs.removeStub(descriptor) }
+
+    for (query, expectedBody) in [("q=dogs", "dogs"), ("q=cats", "cats"), ("q=birds", nil)] {
+      var req = URLRequest(url: URL(string: "http://api.stub.invalid/search")!)
+      req.httpMethod = "POST"
+      req.httpBody = query.data(using: .utf8)
+      let expectation = self.expectation(description: query)
+      URLSession.shared.dataTask(with: req) { data, _, error in
+        if let expectedBody = expectedBody {
+          XCTAssertNil(error)
+          XCTAssertEqual(data, expectedBody.data(using: .utf8))
+        } else {
+          // Unknown bodies are not stubbed
+          XCTAssertNotNil(error)
+        }
+        expectation.fulfill()
+      }.resume()
+      waitForExpectations(timeout: 5, handler: nil)
+    }
+  }
+
+  func testStubRoute() {
+    func textResponse(_ text: String) -> HTTPStubsResponse {
+      return HTTPStubsResponse(data: text.data(using: .utf8)!, statusCode: 200, headers: nil)
+    }
+    let descriptors = [
+      stub(route: "/users/:id") { _, params in textResponse("user \(params["id"]!)") },
+      stub(route: "/users/:id/orders/:orderId", condition: isMethodGET()) { _, params in
+        textResponse("order \(params["orderId"]!) of user \(params["id"]!)")
+      },
+    ]
+    // Stubs are tested in the reverse order they were added, so this one takes precedence over "/users/:id"
+    let meDescriptor = stub(route: "/users/me") { _, params in textResponse("me \(params.count)") }
+    defer { (descriptors + [meDescriptor]).forEach { HTTPStubs.removeStub($0) } }
+
+    func assertResponse(_ path: String, method: String = "GET", _ expectedText: String?, file: StaticString = #file, line: UInt = #line) {
+      var req = URLRequest(url: URL(string: "http://api.stub.invalid" + path)!)
+      req.httpMethod = method
+      let expectation = self.expectation(description: path)
+      URLSession.shared.dataTask(with: req) { data, _, error in
+        if let expectedText = expectedText {
+          XCTAssertNil(error, file: file, line: line)
+          XCTAssertEqual(data.flatMap { String(data: $0, encoding: .utf8) }, expectedText, file: file, line: line)
+        } else {
+          // Paths matching no route are not stubbed
+          XCTAssertNotNil(error, file: file, line: line)
+        }
+        expectation.fulfill()
+      }.resume()
+      waitForExpectations(timeout: 5, handler: nil)
+    }
+
+    assertResponse("/users/42", "user 42")
+    assertResponse("/users/42/orders/7?expand=items", "order 7 of user 42")
+    assertResponse("/users/42/orders/7", method: "DELETE", nil)
+    assertResponse("/users/me", "me 0")
+    assertResponse("/users", nil)
+    assertResponse("/users/42/orders", nil)
+
+    HTTPStubs.removeStub(meDescriptor)
+    assertResponse("/users/me", "user me")
+  }
+
   func testHasJsonBodyIsTrue() {
     let jsonStringsAndObjects = [
       // Exact match
@@ -568,6 +646,37 @@ class SwiftHelpersTests : XCTestCase {
   }
 #endif
 
+#if swift(>=3.0)
+  func testParsedRequestIsSharedAcrossStubs() {
+    var parsedRequest: ParsedRequest?
+    var scans = 0, sharedScans = 0
+    // Stubs are tested in the reverse order they were added
+    let checkingStub = stub(condition: containsQueryParams(["page": "2"]) && { (req: URLRequest) -> Bool in
+      scans += 1
+      if ParsedRequest.parsed(req) === parsedRequest { sharedScans += 1 }
+      return false
+    }, response: { _ in HTTPStubsResponse() })
+    let recordingStub = stub(condition: isPath("/users") && { (req: URLRequest) -> Bool in
+      parsedRequest = ParsedRequest.parsed(req)
+      return false
+    }, response: { _ in HTTPStubsResponse() })
+    defer {
+      HTTPStubs.removeStub(recordingStub)
+      HTTPStubs.removeStub(checkingStub)
+    }
+
+    let expectation = self.expectation(description: "request")
+    URLSession.shared.dataTask(with: URL(string: "http://api.stub.invalid/users?page=2")!) { _, _, _ in
+      expectation.fulfill()
+    }.resume()
+    waitForExpectations(timeout: 5, handler: nil)
+
+    XCTAssertGreaterThan(scans, 0)
+    XCTAssertEqual(sharedScans, scans, "All the stubs should share the same parsed request")
+    XCTAssertNil(HTTPStubs.requestScanCache())
+  }
+#endif
+
   let sampleURLs = [
     // Absolute URLs
     "scheme:",
@@ -624,6 +733,81 @@ class SwiftHelpersTests : XCTestCase {
     }
   }
 
+#if swift(>=3.0)
+  func testOperatorsTestTheCheapestLibraryMatcherFirst() {
+    let req = URLRequest(url: URL(string: "foo://bar")!)
+    var expensiveMatcherCalls = 0
+    func expensiveMatcher(_ result: Bool) -> HTTPStubsTestBlock {
+      return tagged(.body) { _ in
+        expensiveMatcherCalls += 1
+        return result
+      }
+    }
+
+    let andMatcher = expensiveMatcher(true) && isHost("baz")
+    for _ in 0..<100 {
+      XCTAssertFalse(andMatcher(req))
+    }
+    XCTAssertEqual(expensiveMatcherCalls, 0, "isHost should be tested before the expensive matcher")
+
+    expensiveMatcherCalls = 0
+    let orMatcher = expensiveMatcher(false) || isHost("bar")
+    for _ in 0..<100 {
+      XCTAssertTrue(orMatcher(req))
+    }
+    XCTAssertEqual(expensiveMatcherCalls, 0, "isHost should be tested before the expensive matcher")
+
+    // Combinations and negations keep their cost too
+    expensiveMatcherCalls = 0
+    let nestedMatcher = (expensiveMatcher(true) && expensiveMatcher(true)) && !isScheme("foo")
+    for _ in 0..<100 {
+      XCTAssertFalse(nestedMatcher(req))
+    }
+    XCTAssertEqual(expensiveMatcherCalls, 0, "isScheme should be tested before the expensive matchers")
+  }
+
+  func testOperatorsReorderAnExpensiveMatcherWhichFails() {
+    var expensiveMatcherCalls = 0
+    let jsonBody = hasJsonBody(["foo": "bar"])
+    let expensiveMatcher = tagged(.body) { req -> Bool in
+      expensiveMatcherCalls += 1
+      return jsonBody(req)
+    }
+    // The body never matches, so the host is never tested when the matchers are tested in the written order
+    let matcher = expensiveMatcher && isHost("a")
+    for url in ["foo://a", "foo://b", "foo://c"] {
+      var req = URLRequest(url: URL(string: url)!)
+      req.httpMethod = "POST"
+      req.httpBody = "{}".data(using: .utf8)
+      for _ in 0..<10 {
+        XCTAssertFalse(matcher(req))
+      }
+    }
+    XCTAssertEqual(expensiveMatcherCalls, 10, "the body should only be tested for the requests to the host")
+  }
+
+  func testOperatorsKeepUnknownClosuresInPlace() {
+    var guardedClosureCalls = 0
+    // Would crash if tested before the host, on URLs with a shorter path
+    let guardedClosure: HTTPStubsTestBlock = { req in
+      guardedClosureCalls += 1
+      return req.url!.pathComponents[2] == "c"
+    }
+    let expensiveHostMatcher = tagged(.body) { $0.url?.host == "x" }
+    let andMatcher = expensiveHostMatcher && guardedClosure
+    let orMatcher = !isHost("x") || guardedClosure
+    for url in ["foo://y", "foo://y/a", "foo://x/a/c"] {
+      let req = URLRequest(url: URL(string: url)!)
+      for _ in 0..<20 {
+        XCTAssertEqual(andMatcher(req), url == "foo://x/a/c")
+        XCTAssertTrue(orMatcher(req))
+      }
+    }
+    XCTAssertEqual(guardedClosureCalls, 40, "the closure should only be tested for the requests to the host")
+  }
+
+#endif
+
   func testNotOperator() {
     for url in sampleURLs {
 #if swift(>=3.0)
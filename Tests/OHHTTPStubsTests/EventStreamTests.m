@@ -0,0 +1,158 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#import <XCTest/XCTest.h>
+
+#if OHHTTPSTUBS_USE_STATIC_LIBRARY || SWIFT_PACKAGE
+#import "HTTPStubs.h"
+#import "HTTPStubsResponse+EventStream.h"
+#else
+@import OHHTTPStubs;
+#endif
+
+// Records each chunk of data as it is received, with its arrival time
+@interface EventStreamTestDelegate : NSObject <NSURLSessionDataDelegate>
+@property(nonatomic, strong) NSMutableArray<NSString*>* chunks;
+@property(nonatomic, strong) NSMutableArray<NSDate*>* chunkDates;
+@property(nonatomic, strong) NSHTTPURLResponse* response;
+@property(nonatomic, strong) NSError* error;
+@property(nonatomic, strong) XCTestExpectation* expectation;
+@end
+
+@implementation EventStreamTestDelegate
+
+-(instancetype)init
+{
+    self = [super init];
+    if (self)
+    {
+        _chunks = [NSMutableArray new];
+        _chunkDates = [NSMutableArray new];
+    }
+    return self;
+}
+
+-(void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveResponse:(NSURLResponse *)response completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler
+{
+    self.response = (NSHTTPURLResponse*)response;
+    completionHandler(NSURLSessionResponseAllow);
+}
+
+-(void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data
+{
+    [self.chunks addObject:[[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding]];
+    [self.chunkDates addObject:[NSDate date]];
+}
+
+-(void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error
+{
+    self.error = error;
+    [self.expectation fulfill];
+}
+
+@end
+
+@interface EventStreamTests : XCTestCase @end
+
+@implementation EventStreamTests
+
+-(void)setUp
+{
+    [super setUp];
+    [HTTPStubs removeAllStubs];
+}
+
+-(EventStreamTestDelegate*)runRequestReturningResponse:(HTTPStubsResponse*(^)(void))responseBlock
+{
+    [HTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return YES;
+    } withStubResponse:^HTTPStubsResponse *(NSURLRequest *request) {
+        return responseBlock();
+    }];
+
+    EventStreamTestDelegate* delegate = [EventStreamTestDelegate new];
+    delegate.expectation = [self expectationWithDescription:@"Stream completed"];
+    NSURLSession* session = [NSURLSession sessionWithConfiguration:NSURLSessionConfiguration.defaultSessionConfiguration
+                                                          delegate:delegate
+                                                     delegateQueue:nil];
+    [[session dataTaskWithURL:[NSURL URLWithString:@"http://stream.example.com/events"]] resume];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    [session finishTasksAndInvalidate];
+    return delegate;
+}
+
+-(void)test_ServerSentEventsAreSentAsWholeFramesAfterTheirDelay
+{
+    static NSTimeInterval const kEventDelay = 0.3;
+    HTTPStubsServerSentEvent* named = [HTTPStubsServerSentEvent eventWithData:@"line1\nline2" delay:kEventDelay];
+    named.name = @"update";
+    named.identifier = @"42";
+    named.retry = 1.5;
+
+    NSDate* startDate = [NSDate date];
+    EventStreamTestDelegate* delegate = [self runRequestReturningResponse:^HTTPStubsResponse *{
+        return [HTTPStubsResponse responseWithServerSentEvents:@[[HTTPStubsServerSentEvent eventWithData:@"hello" delay:0], named]
+                                                    statusCode:200 headers:nil];
+    }];
+
+    XCTAssertEqualObjects(delegate.response.allHeaderFields[@"Content-Type"], @"text/event-stream");
+    XCTAssertNil(delegate.response.allHeaderFields[@"Content-Length"]);
+    XCTAssertEqualObjects(delegate.chunks, (@[@"data: hello\n\n",
+                                              @"id: 42\nevent: update\nretry: 1500\ndata: line1\ndata: line2\n\n"]));
+    XCTAssertGreaterThanOrEqual([delegate.chunkDates.lastObject timeIntervalSinceDate:startDate], kEventDelay);
+}
+
+-(void)test_JSONLinesProviderIsAskedOneLineAtATime
+{
+    static NSUInteger const kLineCount = 50;
+    __block NSUInteger providedLines = 0;
+    EventStreamTestDelegate* delegate = [self runRequestReturningResponse:^HTTPStubsResponse *{
+        return [HTTPStubsResponse responseWithJSONLineProvider:^id(NSUInteger index, NSTimeInterval *delay) {
+            providedLines++;
+            return index < kLineCount ? @{ @"index": @(index) } : nil;
+        } statusCode:200 headers:nil];
+    }];
+
+    XCTAssertEqualObjects(delegate.response.allHeaderFields[@"Content-Type"], @"application/x-ndjson");
+    XCTAssertEqual(providedLines, kLineCount + 1);
+    NSArray* lines = [[delegate.chunks componentsJoinedByString:@""] componentsSeparatedByString:@"\n"];
+    XCTAssertEqual(lines.count, kLineCount + 1); // Trailing newline
+    XCTAssertEqualObjects(lines.firstObject, @"{\"index\":0}");
+    XCTAssertEqualObjects(lines[kLineCount - 1], @"{\"index\":49}");
+}
+
+-(void)test_JSONLinesProviderReturningAnInvalidObjectFailsTheResponse
+{
+    EventStreamTestDelegate* delegate = [self runRequestReturningResponse:^HTTPStubsResponse *{
+        return [HTTPStubsResponse responseWithJSONLineProvider:^id(NSUInteger index, NSTimeInterval *delay) {
+            return index == 0 ? @{ @"index": @(index) } : @{ @"date": [NSDate date] };
+        } statusCode:200 headers:nil];
+    }];
+
+    XCTAssertEqualObjects(delegate.chunks, @[@"{\"index\":0}\n"]);
+    XCTAssertNotNil(delegate.error);
+}
+
+@end
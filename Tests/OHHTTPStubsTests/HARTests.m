@@ -0,0 +1,236 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+#if SWIFT_PACKAGE
+#warning "Skipping HAR tests, due to the HAR subspec not being available with Swift Package Manager."
+#else
+
+#import <XCTest/XCTest.h>
+
+#if OHHTTPSTUBS_USE_STATIC_LIBRARY
+#import "HTTPStubs.h"
+#import "HTTPStubs+HAR.h"
+#import "HTTPStubsHARReplay.h"
+#import "NSURLRequest+HTTPBodyTesting.h"
+#else
+@import OHHTTPStubs;
+#endif
+
+@interface HARTests : XCTestCase
+@property(nonatomic, strong) NSURL* harURL;
+@end
+
+@implementation HARTests
+
+-(void)setUp
+{
+    [super setUp];
+    [HTTPStubs removeAllStubs];
+
+    NSDictionary* (^entry)(NSString*, NSString*, NSString*, NSDictionary*) = ^NSDictionary*(NSString* method, NSString* url, NSString* postText, NSDictionary* content) {
+        NSMutableDictionary* request = [@{ @"method": method, @"url": url, @"headers": @[] } mutableCopy];
+        if (postText)
+        {
+            request[@"postData"] = @{ @"mimeType": @"text/plain", @"text": postText };
+        }
+        return @{
+            @"request": request,
+            @"response": @{
+                @"status": @200,
+                @"headers": @[ @{ @"name": @"Content-Type", @"value": @"text/plain" },
+                               @{ @"name": @"Content-Encoding", @"value": @"gzip" },
+                               @{ @"name": @"Set-Cookie", @"value": @"a=1" },
+                               @{ @"name": @"Set-Cookie", @"value": @"b=2" } ],
+                @"content": content,
+            },
+            @"timings": @{ @"send": @0, @"wait": @300, @"receive": @200 },
+        };
+    };
+    NSDictionary* har = @{ @"log": @{ @"version": @"1.2", @"entries": @[
+        entry(@"GET", @"http://api.example.com/users", nil, @{ @"text": @"first" }),
+        entry(@"GET", @"http://api.example.com/users", nil, @{ @"text": @"users" }),
+        entry(@"GET", @"http://api.example.com/logo", nil, @{ @"text": @"bG9nbw==", @"encoding": @"base64" }),
+        entry(@"POST", @"http://api.example.com/search", @"q=cats", @{ @"text": @"cats" }),
+        entry(@"POST", @"http://api.example.com/search", @"q=dogs", @{ @"text": @"dogs" }),
+    ]}};
+    self.harURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID.UUID.UUIDString stringByAppendingPathExtension:@"har"]]];
+    [[NSJSONSerialization dataWithJSONObject:har options:0 error:NULL] writeToURL:self.harURL atomically:YES];
+}
+
+-(void)tearDown
+{
+    [NSFileManager.defaultManager removeItemAtURL:self.harURL error:NULL];
+    [super tearDown];
+}
+
+-(NSHTTPURLResponse*)sendRequest:(NSURLRequest*)request expectingBody:(NSString*)expectedBody
+{
+    __block NSHTTPURLResponse* receivedResponse;
+    XCTestExpectation* expectation = [self expectationWithDescription:request.URL.absoluteString];
+    [[NSURLSession.sharedSession dataTaskWithRequest:request completionHandler:^(NSData* data, NSURLResponse* response, NSError* error) {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects([[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding], expectedBody);
+        receivedResponse = (NSHTTPURLResponse*)response;
+        [expectation fulfill];
+    }] resume];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    return receivedResponse;
+}
+
+-(void)test_HAREntriesAreReplayed
+{
+    NSError* error = nil;
+    id<HTTPStubsDescriptor> descriptor = [HTTPStubs stubRequestsUsingHARFileAtURL:self.harURL options:0 error:&error];
+    XCTAssertNotNil(descriptor, @"Error while stubbing the HAR file: %@", error);
+    XCTAssertEqualObjects(descriptor.name, self.harURL.lastPathComponent);
+    XCTAssertEqual(HTTPStubs.allStubs.count, (NSUInteger)1);
+
+    // The entries of the same request answer in their recorded order
+    NSURLRequest* usersRequest = [NSURLRequest requestWithURL:[NSURL URLWithString:@"http://api.example.com/users"]];
+    [self sendRequest:usersRequest expectingBody:@"first"];
+    NSHTTPURLResponse* response = [self sendRequest:usersRequest expectingBody:@"users"];
+    XCTAssertEqualObjects(response.allHeaderFields[@"Content-Type"], @"text/plain");
+    XCTAssertNil(response.allHeaderFields[@"Content-Encoding"]);
+    XCTAssertEqualObjects(response.allHeaderFields[@"Set-Cookie"], @"a=1, b=2");
+
+    [self sendRequest:[NSURLRequest requestWithURL:[NSURL URLWithString:@"http://api.example.com/logo#top"]] expectingBody:@"logo"];
+}
+
+-(void)test_HARLastEntryAnswersFurtherRequests
+{
+    NSError* error = nil;
+    XCTAssertNotNil([HTTPStubs stubRequestsUsingHARFileAtURL:self.harURL options:0 error:&error]);
+
+    NSURLRequest* usersRequest = [NSURLRequest requestWithURL:[NSURL URLWithString:@"http://api.example.com/users"]];
+    for (NSString* expectedBody in @[@"first", @"users", @"users", @"users"])
+    {
+        [self sendRequest:usersRequest expectingBody:expectedBody];
+    }
+}
+
+-(void)test_HARRequestBodyMatching
+{
+    NSError* error = nil;
+    [HTTPStubs stubRequestsUsingHARFileAtURL:self.harURL options:HTTPStubsHAROptionMatchRequestBody error:&error];
+    XCTAssertNil(error);
+
+    for (NSString* animal in @[@"cats", @"dogs"])
+    {
+        NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:@"http://api.example.com/search"]];
+        request.HTTPMethod = @"POST";
+        request.HTTPBody = [[@"q=" stringByAppendingString:animal] dataUsingEncoding:NSUTF8StringEncoding];
+        [self sendRequest:request expectingBody:animal];
+    }
+}
+
+-(void)test_HARRecordedTimings
+{
+    NSError* error = nil;
+    [HTTPStubs stubRequestsUsingHARFileAtURL:self.harURL options:HTTPStubsHAROptionUseRecordedTimings error:&error];
+    XCTAssertNil(error);
+
+    NSDate* start = [NSDate date];
+    [self sendRequest:[NSURLRequest requestWithURL:[NSURL URLWithString:@"http://api.example.com/users"]] expectingBody:@"first"];
+    XCTAssertGreaterThanOrEqual(-start.timeIntervalSinceNow, 0.5);
+}
+
+-(void)test_HARReplayIsTimeCompressed
+{
+    NSDictionary* (^entry)(NSString*, NSString*) = ^NSDictionary*(NSString* startedDateTime, NSString* url) {
+        return @{
+            @"startedDateTime": startedDateTime,
+            @"request": @{ @"method": @"GET", @"url": url, @"headers": @[ @{ @"name": @":authority", @"value": @"api.example.com" } ] },
+            @"response": @{ @"status": @200, @"headers": @[], @"content": @{ @"text": url } },
+        };
+    };
+    NSDictionary* har = @{ @"log": @{ @"version": @"1.2", @"entries": @[
+        entry(@"2020-01-01T10:00:01.5+01:00", @"http://api.example.com/second"),
+        entry(@"2020-01-01T09:00:00.250Z", @"http://api.example.com/first"),
+        entry(@"2020-01-01T09:00:03.250000Z", @"http://api.example.com/third"),
+    ]}};
+    [[NSJSONSerialization dataWithJSONObject:har options:0 error:NULL] writeToURL:self.harURL atomically:YES];
+
+    NSError* error = nil;
+    HTTPStubsHARReplay* replay = [[HTTPStubsHARReplay alloc] initWithHARFileAtURL:self.harURL options:0 error:&error];
+    XCTAssertNotNil(replay, @"Error while loading the HAR file: %@", error);
+    XCTAssertEqual(replay.requestCount, (NSUInteger)3);
+    XCTAssertEqualWithAccuracy(replay.recordedDuration, 3, 0.001);
+    // Loading the archive doesn't stub anything yet
+    XCTAssertEqual(HTTPStubs.allStubs.count, (NSUInteger)0);
+
+    replay.speedFactor = 10;
+    XCTestExpectation* expectation = [self expectationWithDescription:@"replay"];
+    __block HTTPStubsHARReplayReport* report = nil;
+    [replay replayWithSession:NSURLSession.sharedSession completion:^(HTTPStubsHARReplayReport* replayReport) {
+        report = replayReport;
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    XCTAssertEqual(report.requestCount, (NSUInteger)3);
+    XCTAssertEqual(report.failureCount, (NSUInteger)0);
+    XCTAssertGreaterThanOrEqual(report.duration, 0.3);
+    XCTAssertLessThan(report.duration, 3);
+    XCTAssertGreaterThan(report.throughput, 0);
+    XCTAssertLessThanOrEqual([report latencyAtPercentile:50], [report latencyAtPercentile:99]);
+    XCTAssertLessThanOrEqual([report latencyAtPercentile:99], [report latencyAtPercentile:100]);
+    // The stub is removed once the replay is done
+    XCTAssertEqual(HTTPStubs.allStubs.count, (NSUInteger)0);
+}
+
+-(void)test_HARReplayMatchesRequestBodies
+{
+    // The replay must enable the capture before building the recorded requests, or their bodies can't be matched
+    [NSURLRequest OHHTTPStubs_setHTTPBodyCaptureEnabled:NO];
+    NSError* error = nil;
+    HTTPStubsHARReplay* replay = [[HTTPStubsHARReplay alloc] initWithHARFileAtURL:self.harURL options:HTTPStubsHAROptionMatchRequestBody error:&error];
+    XCTAssertNotNil(replay, @"Error while loading the HAR file: %@", error);
+    XCTAssertTrue([NSURLRequest OHHTTPStubs_isHTTPBodyCaptureEnabled]);
+
+    replay.speedFactor = 0;
+    XCTestExpectation* expectation = [self expectationWithDescription:@"replay"];
+    __block HTTPStubsHARReplayReport* report = nil;
+    [replay replayWithSession:NSURLSession.sharedSession completion:^(HTTPStubsHARReplayReport* replayReport) {
+        report = replayReport;
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    // Both recorded searches only differ by their body, and both are stubbed
+    XCTAssertEqual(report.requestCount, (NSUInteger)5);
+    XCTAssertEqual(report.failureCount, (NSUInteger)0);
+}
+
+-(void)test_InvalidHARFile
+{
+    [[@"{\"log\": 42}" dataUsingEncoding:NSUTF8StringEncoding] writeToURL:self.harURL atomically:YES];
+    NSError* error = nil;
+    XCTAssertNil([HTTPStubs stubRequestsUsingHARFileAtURL:self.harURL options:0 error:&error]);
+    XCTAssertEqualObjects(error.domain, HARErrorDomain);
+    XCTAssertEqual(error.code, OHHTTPStubsHARErrorInvalidFileFormat);
+}
+
+@end
+
+#endif
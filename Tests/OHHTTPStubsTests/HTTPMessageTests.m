@@ -0,0 +1,119 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+#if SWIFT_PACKAGE
+#warning "Skipping HTTPMessage tests, due to the HTTPMessage subspec not being available with Swift Package Manager."
+#else
+
+#import <XCTest/XCTest.h>
+
+#if OHHTTPSTUBS_USE_STATIC_LIBRARY
+#import "HTTPStubsResponse+HTTPMessage.h"
+#else
+@import OHHTTPStubs;
+#endif
+
+@interface HTTPMessageTests : XCTestCase @end
+
+@implementation HTTPMessageTests
+
+-(NSData*)messageWithString:(NSString*)string
+{
+    return [[string stringByReplacingOccurrencesOfString:@"\n" withString:@"\r\n"] dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+-(NSArray<NSString*>*)framesOfResponse:(HTTPStubsResponse*)response
+{
+    NSMutableArray<NSString*>* frames = [NSMutableArray new];
+    NSTimeInterval delay = 0;
+    NSData* frame;
+    while ((frame = response.frameProvider(&delay)))
+    {
+        [frames addObject:[[NSString alloc] initWithData:frame encoding:NSUTF8StringEncoding]];
+    }
+    return frames;
+}
+
+-(void)test_PlainBody
+{
+    HTTPStubsResponse* response = [HTTPStubsResponse responseWithHTTPMessageData:[self messageWithString:@"HTTP/1.1 201 Created\nContent-Type: text/plain\n\nHello"]];
+    XCTAssertEqual(response.statusCode, 201);
+    XCTAssertEqualObjects(response.httpHeaders[@"Content-Type"], @"text/plain");
+    XCTAssertEqual(response.dataSize, 5ULL);
+    XCTAssertNil(response.frameProvider);
+}
+
+-(void)test_ChunkedBodyIsDecodedChunkByChunk
+{
+    NSData* message = [self messageWithString:@"HTTP/1.1 200 OK\nTransfer-Encoding: chunked\nContent-Type: text/plain\n\n5\nHello\n7;ext=1\n, world\n0\nX-Trailer: ignored\n\n"];
+    HTTPStubsResponse* response = [HTTPStubsResponse responseWithHTTPMessageData:message];
+    XCTAssertEqual(response.statusCode, 200);
+    XCTAssertNil(response.httpHeaders[@"Transfer-Encoding"]);
+    XCTAssertNil(response.httpHeaders[@"Content-Length"]);
+    XCTAssertEqualObjects(response.httpHeaders[@"Content-Type"], @"text/plain");
+    XCTAssertEqualObjects([self framesOfResponse:response], (@[@"Hello", @", world"]));
+}
+
+-(void)test_InterimResponsesAreSkipped
+{
+    NSData* message = [self messageWithString:@"HTTP/1.1 100 Continue\n\nHTTP/1.1 103 Early Hints\nLink: </style.css>; rel=preload\n\nHTTP/1.1 200 OK\nContent-Type: text/plain\n\nfinal"];
+    HTTPStubsResponse* response = [HTTPStubsResponse responseWithHTTPMessageData:message];
+    XCTAssertEqual(response.statusCode, 200);
+    XCTAssertNil(response.httpHeaders[@"Link"]);
+    XCTAssertEqual(response.dataSize, 5ULL);
+}
+
+-(void)test_MessageFileIsStreamedFromBodyOffset
+{
+    NSURL* fileURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID.UUID.UUIDString stringByAppendingPathExtension:@"response"]]];
+    [[self messageWithString:@"HTTP/1.1 100 Continue\n\nHTTP/1.1 404 Not Found\nContent-Type: text/plain\n\nnot found"] writeToURL:fileURL atomically:YES];
+
+    HTTPStubsResponse* response = [HTTPStubsResponse responseWithHTTPMessageFileAtURL:fileURL];
+    XCTAssertEqual(response.statusCode, 404);
+    XCTAssertEqual(response.dataSize, 9ULL);
+    XCTAssertEqualObjects(response.httpHeaders[@"Content-Length"], @"9");
+
+    [response.inputStream open];
+    uint8_t buffer[32];
+    NSInteger length = [response.inputStream read:buffer maxLength:sizeof(buffer)];
+    [response.inputStream close];
+    XCTAssertEqualObjects([[NSString alloc] initWithBytes:buffer length:(NSUInteger)MAX(length, 0) encoding:NSUTF8StringEncoding], @"not found");
+
+    [NSFileManager.defaultManager removeItemAtURL:fileURL error:NULL];
+}
+
+-(void)test_ChunkedMessageFile
+{
+    NSURL* fileURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID.UUID.UUIDString stringByAppendingPathExtension:@"response"]]];
+    [[self messageWithString:@"HTTP/1.1 200 OK\nTransfer-Encoding: chunked\n\n3\none\n3\ntwo\n0\n\n"] writeToURL:fileURL atomically:YES];
+
+    HTTPStubsResponse* response = [HTTPStubsResponse responseWithHTTPMessageFileAtURL:fileURL];
+    XCTAssertEqualObjects([self framesOfResponse:response], (@[@"one", @"two"]));
+
+    [NSFileManager.defaultManager removeItemAtURL:fileURL error:NULL];
+}
+
+@end
+
+#endif
@@ -46,6 +46,58 @@
 @property(readonly) NSError* receivedError;
 @end
 
+// Reads a stream scheduled in the current run loop, as CFNetwork reads the HTTPBodyStream of the requests it sends
+@interface NSURLSessionTestsScheduledReader : NSObject
+@property(nonatomic, strong) NSMutableData* data;
+@property(nonatomic, strong) NSMutableArray<NSNumber*>* events;
+@property(nonatomic, assign) BOOL finished;
+@end
+
+@implementation NSURLSessionTestsScheduledReader
+
+static void NSURLSessionTestsScheduledReaderCallback(CFReadStreamRef stream, CFStreamEventType type, void* info)
+{
+    NSURLSessionTestsScheduledReader* reader = (__bridge NSURLSessionTestsScheduledReader*)info;
+    [reader.events addObject:@(type)];
+    if (type == kCFStreamEventHasBytesAvailable)
+    {
+        uint8_t buffer[1000];
+        CFIndex count = CFReadStreamRead(stream, buffer, sizeof(buffer));
+        if (count > 0)
+        {
+            [reader.data appendBytes:buffer length:(NSUInteger)count];
+        }
+        reader.finished = (count <= 0);
+    }
+    else if (type == kCFStreamEventEndEncountered || type == kCFStreamEventErrorOccurred)
+    {
+        reader.finished = YES;
+    }
+}
+
+-(NSData*)readStream:(NSInputStream*)stream
+{
+    self.data = [NSMutableData new];
+    self.events = [NSMutableArray new];
+    CFReadStreamRef readStream = (__bridge CFReadStreamRef)stream;
+    CFStreamClientContext context = { 0, (__bridge void*)self, NULL, NULL, NULL };
+    CFReadStreamSetClient(readStream, kCFStreamEventOpenCompleted | kCFStreamEventHasBytesAvailable | kCFStreamEventEndEncountered | kCFStreamEventErrorOccurred,
+                          NSURLSessionTestsScheduledReaderCallback, &context);
+    CFReadStreamScheduleWithRunLoop(readStream, CFRunLoopGetCurrent(), kCFRunLoopDefaultMode);
+    CFReadStreamOpen(readStream);
+    NSDate* timeout = [NSDate dateWithTimeIntervalSinceNow:5];
+    while (!self.finished && timeout.timeIntervalSinceNow > 0)
+    {
+        [NSRunLoop.currentRunLoop runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+    }
+    CFReadStreamUnscheduleFromRunLoop(readStream, CFRunLoopGetCurrent(), kCFRunLoopDefaultMode);
+    CFReadStreamSetClient(readStream, kCFStreamEventNone, NULL, NULL);
+    CFReadStreamClose(readStream);
+    return self.data;
+}
+
+@end
+
 @interface NSURLSessionTests : XCTestCase @end
 
 @implementation NSURLSessionTests
@@ -54,6 +106,15 @@
 {
     [super setUp];
     [HTTPStubs removeAllStubs];
+    // Some tests check the HTTP body of the requests, which is only captured when asked for
+    [NSURLRequest OHHTTPStubs_setHTTPBodyCaptureEnabled:YES];
+}
+
+- (void)tearDown
+{
+    [NSURLRequest OHHTTPStubs_setHTTPBodyCaptureEnabled:NO];
+    [NSURLRequest OHHTTPStubs_setHTTPBodyCaptureLimit:1024 * 1024];
+    [super tearDown];
 }
 
 - (void)_test_NSURLSession:(NSURLSession*)session
@@ -553,6 +614,215 @@
     }
 }
 
+- (void)test_NSURLSessionHTTPBodyCaptureLimit
+{
+    if ([NSURLSessionConfiguration class] && [NSURLSession class])
+    {
+        __block NSURLRequest* stubbedRequest = nil;
+        [HTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+            stubbedRequest = request;
+            return YES;
+        } withStubResponse:^HTTPStubsResponse *(NSURLRequest *request) {
+            return [HTTPStubsResponse responseWithData:[NSData data] statusCode:200 headers:nil];
+        }];
+
+        NSURLSession* session = [NSURLSession sessionWithConfiguration:[NSURLSessionConfiguration defaultSessionConfiguration]];
+        NSData* body = [@"a body over the limit" dataUsingEncoding:NSUTF8StringEncoding];
+        void(^sendRequestWithBody)(void) = ^{
+            XCTestExpectation* expectation = [self expectationWithDescription:@"Request sent"];
+            NSMutableURLRequest* requestWithBody = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:@"stub://foo"]];
+            requestWithBody.HTTPMethod = @"POST";
+            requestWithBody.HTTPBody = body;
+            [[session dataTaskWithRequest:requestWithBody completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+                [expectation fulfill];
+            }] resume];
+            [self waitForExpectationsWithTimeout:5 handler:nil];
+        };
+
+        // Bodies over the limit are only kept as a digest
+        [NSURLRequest OHHTTPStubs_setHTTPBodyCaptureLimit:8];
+        sendRequestWithBody();
+        XCTAssertNil(stubbedRequest.OHHTTPStubs_HTTPBody);
+        XCTAssertEqual(stubbedRequest.OHHTTPStubs_HTTPBodyDigest.length, (NSUInteger)32);
+        XCTAssertTrue([stubbedRequest OHHTTPStubs_HTTPBodyIsEqualToData:body]);
+        XCTAssertFalse([stubbedRequest OHHTTPStubs_HTTPBodyIsEqualToData:[@"another body" dataUsingEncoding:NSUTF8StringEncoding]]);
+
+        // Nothing is kept while the capture is disabled
+        [NSURLRequest OHHTTPStubs_setHTTPBodyCaptureEnabled:NO];
+        sendRequestWithBody();
+        XCTAssertNil(stubbedRequest.OHHTTPStubs_HTTPBody);
+        XCTAssertNil(stubbedRequest.OHHTTPStubs_HTTPBodyDigest);
+        XCTAssertFalse([stubbedRequest OHHTTPStubs_HTTPBodyIsEqualToData:body]);
+
+        [session finishTasksAndInvalidate];
+    }
+    else
+    {
+        NSLog(@"/!\\ Test skipped because the NSURLSession class is not available on this OS version. Run the tests a target with a more recent OS.\n");
+    }
+}
+
+- (NSData*)readStream:(NSInputStream*)stream
+{
+    NSMutableData* data = [NSMutableData new];
+    uint8_t buffer[1000];
+    [stream open];
+    NSInteger count;
+    while ((count = [stream read:buffer maxLength:sizeof(buffer)]) > 0)
+    {
+        [data appendBytes:buffer length:(NSUInteger)count];
+    }
+    [stream close];
+    return data;
+}
+
+- (void)test_HTTPBodyStreamIsReadAheadWithoutBeingConsumed
+{
+    NSMutableData* body = [NSMutableData dataWithLength:10000];
+    for (NSUInteger i = 0; i < body.length; ++i)
+    {
+        ((uint8_t*)body.mutableBytes)[i] = (uint8_t)(i % 251);
+    }
+
+    // In memory
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:@"stub://foo"]];
+    request.HTTPBodyStream = [NSInputStream inputStreamWithData:body];
+    XCTAssertEqualObjects([request OHHTTPStubs_HTTPBodyPrefixOfLength:4], [body subdataWithRange:NSMakeRange(0, 4)]);
+    XCTAssertEqualObjects(request.OHHTTPStubs_HTTPBody, body);
+    XCTAssertEqualObjects(request.OHHTTPStubs_HTTPBodyFingerprint, [NSURLRequest OHHTTPStubs_fingerprintForData:body]);
+    XCTAssertEqualObjects([self readStream:request.HTTPBodyStream], body);
+
+    // Spilled to disk, past the capture limit
+    [NSURLRequest OHHTTPStubs_setHTTPBodyCaptureLimit:1024];
+    request.HTTPBodyStream = [NSInputStream inputStreamWithData:body];
+    XCTAssertEqualObjects([request OHHTTPStubs_HTTPBodyPrefixOfLength:2000], [body subdataWithRange:NSMakeRange(0, 2000)]);
+    XCTAssertNil(request.OHHTTPStubs_HTTPBody);
+    XCTAssertEqual(request.OHHTTPStubs_HTTPBodyDigest.length, (NSUInteger)32);
+    XCTAssertTrue([request OHHTTPStubs_HTTPBodyIsEqualToData:body]);
+    XCTAssertFalse([request OHHTTPStubs_HTTPBodyIsEqualToData:[body subdataWithRange:NSMakeRange(0, 9999)]]);
+    // Hashed while reading ahead, then kept
+    NSData* fingerprint = request.OHHTTPStubs_HTTPBodyFingerprint;
+    XCTAssertEqualObjects(fingerprint, [NSURLRequest OHHTTPStubs_fingerprintForData:body]);
+    XCTAssertEqual(request.OHHTTPStubs_HTTPBodyFingerprint, fingerprint);
+    XCTAssertEqualObjects([self readStream:request.HTTPBodyStream], body);
+}
+
+- (void)test_RequestScanCacheIsRestoredWhenATestBlockThrows
+{
+    [HTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        XCTAssertNotNil(HTTPStubs.requestScanCache);
+        [NSException raise:NSInternalInconsistencyException format:@"Failing test block"];
+        return NO;
+    } withStubResponse:^HTTPStubsResponse *(NSURLRequest *request) {
+        return [HTTPStubsResponse responseWithData:[NSData data] statusCode:200 headers:nil];
+    }];
+
+    // The lookup runs synchronously on this thread, as NSURLProtocol asks whether the request can be handled
+    Class protocolClass = NSClassFromString(@"HTTPStubsProtocol");
+    XCTAssertThrows([protocolClass canInitWithRequest:[NSURLRequest requestWithURL:[NSURL URLWithString:@"stub://throwing"]]]);
+    XCTAssertNil(HTTPStubs.requestScanCache);
+}
+
+- (void)test_HTTPBodyStreamSignalsScheduledReaders
+{
+    NSMutableData* body = [NSMutableData dataWithLength:10000];
+    for (NSUInteger i = 0; i < body.length; ++i)
+    {
+        ((uint8_t*)body.mutableBytes)[i] = (uint8_t)(i % 251);
+    }
+    NSURLSessionTestsScheduledReader* reader = [NSURLSessionTestsScheduledReader new];
+
+    // Partly read ahead: the events of the read-ahead bytes, then those of the wrapped stream
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:@"stub://foo"]];
+    request.HTTPBodyStream = [NSInputStream inputStreamWithData:body];
+    XCTAssertEqualObjects([request OHHTTPStubs_HTTPBodyPrefixOfLength:1500], [body subdataWithRange:NSMakeRange(0, 1500)]);
+    XCTAssertEqualObjects([reader readStream:request.HTTPBodyStream], body);
+    XCTAssertEqualObjects(reader.events.firstObject, @(kCFStreamEventOpenCompleted));
+
+    // Entirely read ahead: the end of the body is signalled once the read-ahead bytes are read
+    request.HTTPBodyStream = [NSInputStream inputStreamWithData:body];
+    XCTAssertEqualObjects(request.OHHTTPStubs_HTTPBody, body);
+    XCTAssertEqualObjects([reader readStream:request.HTTPBodyStream], body);
+    XCTAssertEqualObjects(reader.events.lastObject, @(kCFStreamEventEndEncountered));
+
+    // Not read ahead at all: only the events of the wrapped stream
+    request.HTTPBodyStream = [NSInputStream inputStreamWithData:body];
+    XCTAssertEqualObjects([reader readStream:request.HTTPBodyStream], body);
+}
+
+- (void)test_NSURLSessionUnstubbedHTTPBodyStreamUpload
+{
+    if ([NSURLSessionConfiguration class] && [NSURLSession class])
+    {
+        // Reads the beginning of the body ahead, but doesn't match, so the request goes to the network
+        [HTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+            return [[request OHHTTPStubs_HTTPBodyPrefixOfLength:5] isEqualToData:[@"%PDF-" dataUsingEncoding:NSUTF8StringEncoding]];
+        } withStubResponse:^HTTPStubsResponse *(NSURLRequest *request) {
+            return [HTTPStubsResponse responseWithData:[NSData data] statusCode:201 headers:nil];
+        }];
+
+        NSMutableString* bodyString = [NSMutableString new];
+        for (NSUInteger i = 0; i < 5000; ++i)
+        {
+            [bodyString appendFormat:@"%lu,", (unsigned long)i];
+        }
+        NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:@"https://httpbin.org/post"]];
+        request.HTTPMethod = @"POST";
+        [request setValue:@"text/plain" forHTTPHeaderField:@"Content-Type"];
+        request.HTTPBodyStream = [NSInputStream inputStreamWithData:[bodyString dataUsingEncoding:NSUTF8StringEncoding]];
+
+        XCTestExpectation* expectation = [self expectationWithDescription:@"Upload sent to the network"];
+        NSURLSession* session = [NSURLSession sessionWithConfiguration:[NSURLSessionConfiguration defaultSessionConfiguration]];
+        [[session dataTaskWithRequest:request completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+            XCTAssertNil(error, @"Unexpected network failure");
+            XCTAssertEqual(((NSHTTPURLResponse*)response).statusCode, 200);
+            NSDictionary* echo = data ? [NSJSONSerialization JSONObjectWithData:data options:0 error:NULL] : nil;
+            XCTAssertEqualObjects(echo[@"data"], bodyString);
+            [expectation fulfill];
+        }] resume];
+        // Allow a longer timeout as this test actually hits the network
+        [self waitForExpectationsWithTimeout:10 handler:nil];
+
+        [session finishTasksAndInvalidate];
+    }
+    else
+    {
+        NSLog(@"/!\\ Test skipped because the NSURLSession class is not available on this OS version. Run the tests a target with a more recent OS.\n");
+    }
+}
+
+- (void)test_NSURLSessionHTTPBodyStreamMatching
+{
+    if ([NSURLSessionConfiguration class] && [NSURLSession class])
+    {
+        [HTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+            return [[request OHHTTPStubs_HTTPBodyPrefixOfLength:5] isEqualToData:[@"%PDF-" dataUsingEncoding:NSUTF8StringEncoding]];
+        } withStubResponse:^HTTPStubsResponse *(NSURLRequest *request) {
+            return [HTTPStubsResponse responseWithData:[@"uploaded" dataUsingEncoding:NSUTF8StringEncoding] statusCode:201 headers:nil];
+        }];
+
+        NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:@"stub://upload"]];
+        request.HTTPMethod = @"POST";
+        request.HTTPBodyStream = [NSInputStream inputStreamWithData:[@"%PDF-1.7 and a lot more" dataUsingEncoding:NSUTF8StringEncoding]];
+
+        XCTestExpectation* expectation = [self expectationWithDescription:@"Upload stubbed"];
+        NSURLSession* session = [NSURLSession sessionWithConfiguration:[NSURLSessionConfiguration defaultSessionConfiguration]];
+        [[session dataTaskWithRequest:request completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+            XCTAssertNil(error);
+            XCTAssertEqual(((NSHTTPURLResponse*)response).statusCode, 201);
+            XCTAssertEqualObjects(data, [@"uploaded" dataUsingEncoding:NSUTF8StringEncoding]);
+            [expectation fulfill];
+        }] resume];
+        [self waitForExpectationsWithTimeout:5 handler:nil];
+
+        [session finishTasksAndInvalidate];
+    }
+    else
+    {
+        NSLog(@"/!\\ Test skipped because the NSURLSession class is not available on this OS version. Run the tests a target with a more recent OS.\n");
+    }
+}
+
 - (void)test_NSURLSessionNativeHTTPBody
 {
     if ([NSURLSessionConfiguration class] && [NSURLSession class])
@@ -588,6 +858,57 @@
     }
 }
 
+- (void)test_NSURLSessionBodilessResponses
+{
+    if ([NSURLSessionConfiguration class] && [NSURLSession class])
+    {
+        NSData* body = [NSStringFromSelector(_cmd) dataUsingEncoding:NSUTF8StringEncoding];
+        NSMutableArray<HTTPStubsResponse*>* responses = [NSMutableArray new];
+
+        [HTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+            return YES;
+        } withStubResponse:^HTTPStubsResponse *(NSURLRequest *request) {
+            int statusCode = [request.URL.lastPathComponent intValue];
+            HTTPStubsResponse* response = [[HTTPStubsResponse responseWithData:body statusCode:statusCode headers:nil]
+                                           responseTime:0.1];
+            @synchronized(responses)
+            {
+                [responses addObject:response];
+            }
+            return response;
+        }];
+
+        NSURLSession* session = [NSURLSession sessionWithConfiguration:[NSURLSessionConfiguration defaultSessionConfiguration]];
+        for (NSString* methodAndPath in @[@"HEAD /200", @"GET /204", @"GET /304"])
+        {
+            NSArray* parts = [methodAndPath componentsSeparatedByString:@" "];
+            NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:[@"stub://foo" stringByAppendingString:parts[1]]]];
+            request.HTTPMethod = parts[0];
+
+            XCTestExpectation* expectation = [self expectationWithDescription:methodAndPath];
+            [[session dataTaskWithRequest:request completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+                XCTAssertNil(error, @"%@", methodAndPath);
+                XCTAssertEqual(data.length, (NSUInteger)0, @"%@", methodAndPath);
+                XCTAssertEqualObjects(((NSHTTPURLResponse*)response).allHeaderFields[@"Content-Length"], @(body.length).stringValue, @"%@", methodAndPath);
+                [expectation fulfill];
+            }] resume];
+            [self waitForExpectationsWithTimeout:5 handler:nil];
+        }
+
+        XCTAssertEqual(responses.count, (NSUInteger)3);
+        for (HTTPStubsResponse* response in responses)
+        {
+            XCTAssertEqual(response.inputStream.streamStatus, NSStreamStatusNotOpen, @"The body should never have been opened");
+        }
+
+        [session finishTasksAndInvalidate];
+    }
+    else
+    {
+        NSLog(@"/!\\ Test skipped because the NSURLSession class is not available on this OS version. Run the tests a target with a more recent OS.\n");
+    }
+}
+
 @end
 
 
@@ -0,0 +1,268 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+#import <XCTest/XCTest.h>
+
+#if OHHTTPSTUBS_USE_STATIC_LIBRARY || SWIFT_PACKAGE
+#import "HTTPStubs.h"
+#import "HTTPStubsFileMetadata.h"
+#import "HTTPStubsFixtureCache.h"
+#else
+@import OHHTTPStubs;
+#endif
+
+static NSUInteger const kConstructionIterations = 10000;
+
+@interface PerformanceTests : XCTestCase
+@property(nonatomic, strong) NSURL* fixtureURL;
+@end
+
+@implementation PerformanceTests
+
+-(void)setUp
+{
+    [super setUp];
+    NSString* fileName = [NSString stringWithFormat:@"%@.json", NSUUID.UUID.UUIDString];
+    self.fixtureURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:fileName]];
+    [[@"{\"small\":\"fixture\"}" dataUsingEncoding:NSUTF8StringEncoding] writeToURL:self.fixtureURL atomically:YES];
+}
+
+-(void)tearDown
+{
+    [HTTPStubsFileMetadata invalidateAllMetadata];
+    [NSFileManager.defaultManager removeItemAtURL:self.fixtureURL error:NULL];
+    [super tearDown];
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+#pragma mark - File metadata cache
+///////////////////////////////////////////////////////////////////////////////////
+
+-(void)test_FileMetadataIsInvalidatedWhenFileChanges
+{
+    HTTPStubsResponse* response = [HTTPStubsResponse responseWithFileURL:self.fixtureURL statusCode:200 headers:nil];
+    XCTAssertEqual(response.dataSize, 19ULL);
+
+    [[@"{}" dataUsingEncoding:NSUTF8StringEncoding] writeToURL:self.fixtureURL atomically:NO];
+
+    // File system events are delivered asynchronously
+    NSDate* timeout = [NSDate dateWithTimeIntervalSinceNow:2.0];
+    while ([HTTPStubsFileMetadata metadataForFileURL:self.fixtureURL error:NULL].fileSize != 2 && timeout.timeIntervalSinceNow > 0)
+    {
+        [NSThread sleepForTimeInterval:0.01];
+    }
+
+    response = [HTTPStubsResponse responseWithFileURL:self.fixtureURL statusCode:200 headers:nil];
+    XCTAssertEqual(response.dataSize, 2ULL);
+    XCTAssertEqualObjects(response.httpHeaders[@"Content-Length"], @"2");
+}
+
+-(void)test_FileMetadataIsReusedWhileFileIsUnchanged
+{
+    HTTPStubsFileMetadata* metadata = [HTTPStubsFileMetadata metadataForFileURL:self.fixtureURL error:NULL];
+    XCTAssertNotNil(metadata);
+    XCTAssertEqual([HTTPStubsFileMetadata metadataForFileURL:self.fixtureURL error:NULL], metadata);
+
+    [HTTPStubsFileMetadata invalidateMetadataForFileURL:self.fixtureURL];
+    XCTAssertNotEqual([HTTPStubsFileMetadata metadataForFileURL:self.fixtureURL error:NULL], metadata);
+}
+
+-(void)test_FileMetadataOfMissingFile
+{
+    NSURL* missingURL = [self.fixtureURL URLByAppendingPathExtension:@"missing"];
+    NSError* error = nil;
+    XCTAssertNil([HTTPStubsFileMetadata metadataForFileURL:missingURL error:&error]);
+    XCTAssertEqualObjects(error.domain, NSPOSIXErrorDomain);
+    XCTAssertEqual(error.code, ENOENT);
+}
+
+-(void)test_FileResponseWithOffset
+{
+    HTTPStubsResponse* response = [HTTPStubsResponse responseWithFileURL:self.fixtureURL offset:10 statusCode:200 headers:nil];
+    XCTAssertEqual(response.dataSize, 9ULL);
+    XCTAssertEqualObjects(response.httpHeaders[@"Content-Length"], @"9");
+}
+
+-(void)test_FileResponseConstructionPerformance
+{
+    NSURL* fixtureURL = self.fixtureURL;
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < kConstructionIterations; ++i)
+        {
+            @autoreleasepool {
+                (void)[HTTPStubsResponse responseWithFileURL:fixtureURL statusCode:200 headers:nil];
+            }
+        }
+    }];
+}
+
+-(void)test_FileResponseConstructionPerformanceWithoutMetadataCache
+{
+    // What responseWithFileURL: used to do before the metadata cache: query the file size through NSURL every time
+    NSURL* fixtureURL = self.fixtureURL;
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < kConstructionIterations; ++i)
+        {
+            @autoreleasepool {
+                NSNumber* fileSize;
+                [fixtureURL removeCachedResourceValueForKey:NSURLFileSizeKey];
+                [fixtureURL getResourceValue:&fileSize forKey:NSURLFileSizeKey error:NULL];
+                (void)[[HTTPStubsResponse alloc] initWithInputStream:[NSInputStream inputStreamWithURL:fixtureURL]
+                                                            dataSize:fileSize.unsignedLongLongValue
+                                                          statusCode:200
+                                                             headers:nil];
+            }
+        }
+    }];
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Fixture cache
+///////////////////////////////////////////////////////////////////////////////////
+
+-(NSData*)payloadOfLength:(NSUInteger)length filledWith:(uint8_t)byte
+{
+    NSMutableData* payload = [NSMutableData dataWithLength:length];
+    memset(payload.mutableBytes, byte, length);
+    return payload;
+}
+
+-(void)test_FixtureCacheSharesIdenticalBodies
+{
+    HTTPStubsFixtureCache* cache = [[HTTPStubsFixtureCache alloc] initWithByteBudget:1024 * 1024];
+    NSData* first = [cache cachedDataForData:[self payloadOfLength:4096 filledWith:'a']];
+    NSData* second = [cache cachedDataForData:[self payloadOfLength:4096 filledWith:'a']];
+    NSData* other = [cache cachedDataForData:[self payloadOfLength:4096 filledWith:'b']];
+
+    XCTAssertEqual(first, second, @"Identical bodies should be stored only once");
+    XCTAssertNotEqual(first, other);
+    XCTAssertEqual(cache.totalBytes, 8192ULL);
+    XCTAssertEqual(cache.hitCount, (NSUInteger)1);
+    XCTAssertEqual(cache.missCount, (NSUInteger)2);
+    XCTAssertEqualWithAccuracy(cache.hitRate, 1.0 / 3.0, 0.001);
+}
+
+-(void)test_FixtureCacheEvictsLeastRecentlyUsedBodies
+{
+    HTTPStubsFixtureCache* cache = [[HTTPStubsFixtureCache alloc] initWithByteBudget:10000];
+    NSData* a = [cache cachedDataForData:[self payloadOfLength:4000 filledWith:'a']];
+    (void)[cache cachedDataForData:[self payloadOfLength:4000 filledWith:'b']];
+    (void)[cache cachedDataForData:[self payloadOfLength:4000 filledWith:'a']]; // 'a' is now the most recently used
+    (void)[cache cachedDataForData:[self payloadOfLength:4000 filledWith:'c']]; // evicts 'b'
+
+    XCTAssertEqual(cache.totalBytes, 8000ULL);
+    XCTAssertEqual(cache.evictionCount, (NSUInteger)1);
+    XCTAssertEqual([cache cachedDataForData:[self payloadOfLength:4000 filledWith:'a']], a);
+    XCTAssertEqual(cache.hitCount, (NSUInteger)2);
+}
+
+-(void)test_FixtureCacheIgnoresSmallBodies
+{
+    HTTPStubsFixtureCache* cache = [[HTTPStubsFixtureCache alloc] initWithByteBudget:10000];
+    NSData* small = [self payloadOfLength:16 filledWith:'a'];
+    XCTAssertEqual([cache cachedDataForData:small], small);
+    XCTAssertEqual(cache.totalBytes, 0ULL);
+    XCTAssertEqual(cache.missCount, (NSUInteger)0);
+}
+
+-(void)test_FixtureCacheReadsFilesOnce
+{
+    [[self payloadOfLength:4096 filledWith:'f'] writeToURL:self.fixtureURL atomically:YES];
+    [HTTPStubsFileMetadata invalidateMetadataForFileURL:self.fixtureURL];
+
+    HTTPStubsFixtureCache* cache = [[HTTPStubsFixtureCache alloc] initWithByteBudget:1024 * 1024];
+    NSData* first = [cache dataWithContentsOfFileURL:self.fixtureURL error:NULL];
+    NSData* second = [cache dataWithContentsOfFileURL:self.fixtureURL error:NULL];
+    XCTAssertEqual(first.length, (NSUInteger)4096);
+    XCTAssertEqual(first, second);
+    XCTAssertEqual(cache.hitCount, (NSUInteger)1);
+}
+
+-(void)test_FileResponsesReadTheirBodyThroughTheSharedCache
+{
+    [[self payloadOfLength:4096 filledWith:'s'] writeToURL:self.fixtureURL atomically:YES];
+    [HTTPStubsFileMetadata invalidateMetadataForFileURL:self.fixtureURL];
+
+    HTTPStubsFixtureCache* cache = HTTPStubsFixtureCache.sharedCache;
+    cache.enabled = YES;
+    [cache removeAllData];
+    [cache resetStatistics];
+
+    HTTPStubsResponse* first = [HTTPStubsResponse responseWithFileURL:self.fixtureURL statusCode:200 headers:nil];
+    HTTPStubsResponse* second = [HTTPStubsResponse responseWithFileURL:self.fixtureURL statusCode:200 headers:nil];
+    XCTAssertEqual(first.dataSize, 4096ULL);
+    XCTAssertEqual(second.dataSize, 4096ULL);
+    XCTAssertEqual(cache.missCount, (NSUInteger)1);
+    XCTAssertEqual(cache.hitCount, (NSUInteger)1);
+
+    // Evicted bodies are not pinned by the responses: the next one reads the file again
+    [cache removeAllData];
+    HTTPStubsResponse* third = [HTTPStubsResponse responseWithFileURL:self.fixtureURL statusCode:200 headers:nil];
+    XCTAssertEqual(third.dataSize, 4096ULL);
+    XCTAssertEqual(cache.missCount, (NSUInteger)2);
+    XCTAssertEqual(cache.totalBytes, 4096ULL);
+
+    cache.enabled = NO;
+    [cache removeAllData];
+    [cache resetStatistics];
+}
+
+-(void)test_FixtureCacheCachesDecodedFileRegions
+{
+    NSMutableData* file = [[@"header\n\n" dataUsingEncoding:NSUTF8StringEncoding] mutableCopy];
+    [file appendData:[self payloadOfLength:4096 filledWith:'r']];
+    [file writeToURL:self.fixtureURL atomically:YES];
+    [HTTPStubsFileMetadata invalidateMetadataForFileURL:self.fixtureURL];
+
+    HTTPStubsFixtureCache* cache = [[HTTPStubsFixtureCache alloc] initWithByteBudget:1024 * 1024];
+    __block NSUInteger decodeCount = 0;
+    HTTPStubsFixtureDecoder decoder = ^NSData*(NSData* fileData) {
+        decodeCount += 1;
+        return [fileData subdataWithRange:NSMakeRange(0, 2048)];
+    };
+    NSData* first = [cache dataWithContentsOfFileURL:self.fixtureURL offset:8 decoder:decoder error:NULL];
+    NSData* second = [cache dataWithContentsOfFileURL:self.fixtureURL offset:8 decoder:decoder error:NULL];
+    NSData* raw = [cache dataWithContentsOfFileURL:self.fixtureURL offset:8 decoder:nil error:NULL];
+
+    XCTAssertEqualObjects(first, [self payloadOfLength:2048 filledWith:'r']);
+    XCTAssertEqual(first, second);
+    XCTAssertEqual(decodeCount, (NSUInteger)1);
+    XCTAssertEqualObjects(raw, [self payloadOfLength:4096 filledWith:'r']);
+}
+
+-(void)test_FixtureCacheRereadsRewrittenFiles
+{
+    [[self payloadOfLength:4096 filledWith:'f'] writeToURL:self.fixtureURL atomically:YES];
+
+    HTTPStubsFixtureCache* cache = [[HTTPStubsFixtureCache alloc] initWithByteBudget:1024 * 1024];
+    (void)[cache dataWithContentsOfFileURL:self.fixtureURL error:NULL];
+    [[self payloadOfLength:4096 filledWith:'g'] writeToURL:self.fixtureURL atomically:NO];
+    [HTTPStubsFileMetadata invalidateMetadataForFileURL:self.fixtureURL]; // don't wait for the file system event
+    NSData* rewritten = [cache dataWithContentsOfFileURL:self.fixtureURL error:NULL];
+
+    XCTAssertEqualObjects(rewritten, [self payloadOfLength:4096 filledWith:'g']);
+    XCTAssertEqual(cache.hitCount, (NSUInteger)0);
+}
+
+@end
@@ -0,0 +1,230 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+#if SWIFT_PACKAGE
+#warning "Skipping Recorder tests, due to the Recorder subspec not being available with Swift Package Manager."
+#else
+
+#import <XCTest/XCTest.h>
+
+#if OHHTTPSTUBS_USE_STATIC_LIBRARY
+#import "HTTPStubs.h"
+#import "HTTPStubsResponse.h"
+#import "HTTPStubsRecorder.h"
+#else
+@import OHHTTPStubs;
+#endif
+
+// A loader standing for the network, answering every request to the "recorder.local" host
+@interface RecorderTestsLocalLoader : NSURLProtocol
+@end
+
+static NSUInteger sLocalLoaderRequestCount;
+
+@implementation RecorderTestsLocalLoader
+
++(BOOL)canInitWithRequest:(NSURLRequest*)request
+{
+    return [request.URL.host isEqualToString:@"recorder.local"];
+}
+
++(NSURLRequest*)canonicalRequestForRequest:(NSURLRequest*)request
+{
+    return request;
+}
+
+-(void)startLoading
+{
+    @synchronized(RecorderTestsLocalLoader.class)
+    {
+        sLocalLoaderRequestCount++;
+    }
+    NSData* body = [[NSString stringWithFormat:@"{\"path\":\"%@\"}", self.request.URL.path] dataUsingEncoding:NSUTF8StringEncoding];
+    NSHTTPURLResponse* response = [[NSHTTPURLResponse alloc] initWithURL:self.request.URL statusCode:200 HTTPVersion:@"HTTP/1.1"
+                                                            headerFields:@{@"Content-Type": @"application/json", @"X-Loader": @"local"}];
+    [self.client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+    [self.client URLProtocol:self didLoadData:body];
+    [self.client URLProtocolDidFinishLoading:self];
+}
+
+-(void)stopLoading
+{
+}
+
+@end
+
+@interface RecorderTests : XCTestCase
+@property(nonatomic, strong) NSURL* folderURL;
+@property(nonatomic, strong) NSURLSession* session;
+@end
+
+@implementation RecorderTests
+
+-(void)setUp
+{
+    [super setUp];
+    [HTTPStubs removeAllStubs];
+    self.folderURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:NSUUID.UUID.UUIDString] isDirectory:YES];
+    self.session = [NSURLSession sessionWithConfiguration:NSURLSessionConfiguration.defaultSessionConfiguration];
+}
+
+-(void)tearDown
+{
+    [HTTPStubsRecorder.activeRecorder stopRecording];
+    [HTTPStubs removeAllStubs];
+    [NSFileManager.defaultManager removeItemAtURL:self.folderURL error:NULL];
+    [super tearDown];
+}
+
+-(NSData*)bodyOfRequestToURL:(NSURL*)url
+{
+    XCTestExpectation* expectation = [self expectationWithDescription:url.absoluteString];
+    __block NSData* body = nil;
+    [[self.session dataTaskWithURL:url completionHandler:^(NSData* data, NSURLResponse* response, NSError* error) {
+        XCTAssertNil(error, @"Unexpected network failure");
+        body = data;
+        [expectation fulfill];
+    }] resume];
+    // Allow a longer timeout as this test actually hits the network
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    return body;
+}
+
+-(NSArray<NSURL*>*)recordedFiles
+{
+    return [NSFileManager.defaultManager contentsOfDirectoryAtURL:self.folderURL includingPropertiesForKeys:nil options:0 error:NULL];
+}
+
+-(void)testRecordingForwardsToLocalLoader
+{
+    HTTPStubsRecorder* recorder = [[HTTPStubsRecorder alloc] initWithDirectoryURL:self.folderURL format:HTTPStubsRecordingFormatHTTPMessage];
+    NSURLSessionConfiguration* configuration = [NSURLSessionConfiguration ephemeralSessionConfiguration];
+    configuration.protocolClasses = [@[RecorderTestsLocalLoader.class] arrayByAddingObjectsFromArray:configuration.protocolClasses];
+    recorder.forwardingSessionConfiguration = configuration;
+    @synchronized(RecorderTestsLocalLoader.class)
+    {
+        sLocalLoaderRequestCount = 0;
+    }
+
+    // Nothing is plugged in for the unmatched requests until the recording starts
+    XCTAssertNil(HTTPStubs.unmatchedRequestHandler);
+    [recorder startRecording];
+    XCTAssertEqualObjects(HTTPStubs.unmatchedRequestHandler, recorder);
+
+    NSURL* url = [NSURL URLWithString:@"http://recorder.local/users"];
+    NSData* body = [self bodyOfRequestToURL:url];
+    XCTAssertEqualObjects([[NSString alloc] initWithData:body encoding:NSUTF8StringEncoding], @"{\"path\":\"/users\"}");
+    XCTAssertEqual(sLocalLoaderRequestCount, 1);
+
+    [recorder waitUntilAllWritten];
+    XCTAssertEqual(recorder.recordedCount, 1);
+    NSArray<NSURL*>* files = [self recordedFiles];
+    XCTAssertEqual(files.count, 1);
+    NSString* message = [NSString stringWithContentsOfURL:files.firstObject encoding:NSUTF8StringEncoding error:NULL];
+    XCTAssertTrue([message hasPrefix:@"HTTP/1.1 200 "]);
+    XCTAssertTrue([message containsString:@"X-Loader: local\r\n"]);
+
+    // The next identical request is served by the recorded stub, without reaching the loader
+    XCTAssertEqualObjects([self bodyOfRequestToURL:url], body);
+    XCTAssertEqual(sLocalLoaderRequestCount, 1);
+
+    [recorder stopRecording];
+    XCTAssertNil(HTTPStubs.unmatchedRequestHandler);
+}
+
+-(void)testRecordingWritesHTTPMessageAndRegistersStub
+{
+    NSURL* url = [NSURL URLWithString:@"https://httpbin.org/get?recorder=1"];
+    HTTPStubsRecorder* recorder = [[HTTPStubsRecorder alloc] initWithDirectoryURL:self.folderURL format:HTTPStubsRecordingFormatHTTPMessage];
+    [recorder startRecording];
+    XCTAssertEqual(HTTPStubsRecorder.activeRecorder, recorder);
+
+    NSData* body = [self bodyOfRequestToURL:url];
+    XCTAssertGreaterThan(body.length, 0);
+
+    [recorder waitUntilAllWritten];
+    XCTAssertEqual(recorder.recordedCount, 1);
+    XCTAssertEqual(recorder.droppedCount, 0);
+
+    NSArray<NSURL*>* files = [self recordedFiles];
+    XCTAssertEqual(files.count, 1);
+    XCTAssertEqualObjects(files.firstObject.pathExtension, @"response");
+    NSString* message = [NSString stringWithContentsOfURL:files.firstObject encoding:NSUTF8StringEncoding error:NULL];
+    XCTAssertTrue([message hasPrefix:@"HTTP/1.1 200 "]);
+    XCTAssertTrue([message hasSuffix:[[NSString alloc] initWithData:body encoding:NSUTF8StringEncoding]]);
+
+    // The next identical request is served by the recorded stub, without being recorded again
+    [recorder stopRecording];
+    XCTAssertNil(HTTPStubsRecorder.activeRecorder);
+    __block id<HTTPStubsDescriptor> activatedStub = nil;
+    [HTTPStubs onStubActivation:^(NSURLRequest* request, id<HTTPStubsDescriptor> stub, HTTPStubsResponse* responseStub) {
+        activatedStub = stub;
+    }];
+    XCTAssertEqualObjects([self bodyOfRequestToURL:url], body);
+    XCTAssertEqualObjects(activatedStub.name, @"Recorded GET https://httpbin.org/get?recorder=1");
+    [HTTPStubs onStubActivation:nil];
+}
+
+-(void)testRecordingWritesMocktail
+{
+    HTTPStubsRecorder* recorder = [[HTTPStubsRecorder alloc] initWithDirectoryURL:self.folderURL format:HTTPStubsRecordingFormatMocktail];
+    recorder.registersStubs = NO;
+    [recorder startRecording];
+
+    NSData* body = [self bodyOfRequestToURL:[NSURL URLWithString:@"https://httpbin.org/json"]];
+    [recorder waitUntilAllWritten];
+    XCTAssertEqual(recorder.recordedCount, 1);
+    XCTAssertEqual(HTTPStubs.allStubs.count, 0);
+
+    NSArray<NSURL*>* files = [self recordedFiles];
+    XCTAssertEqualObjects(files.firstObject.pathExtension, @"tail");
+    NSString* tail = [NSString stringWithContentsOfURL:files.firstObject encoding:NSUTF8StringEncoding error:NULL];
+    NSArray<NSString*>* lines = [tail componentsSeparatedByString:@"\n"];
+    XCTAssertEqualObjects(lines[0], @"^GET$");
+    XCTAssertEqualObjects(lines[1], @"^https://httpbin\\.org/json$");
+    XCTAssertEqualObjects(lines[2], @"200");
+    XCTAssertEqualObjects(lines[3], @"application/json");
+    XCTAssertTrue([tail hasSuffix:[[NSString alloc] initWithData:body encoding:NSUTF8StringEncoding]]);
+}
+
+-(void)testRecordingDropsOversizedBodies
+{
+    HTTPStubsRecorder* recorder = [[HTTPStubsRecorder alloc] initWithDirectoryURL:self.folderURL format:HTTPStubsRecordingFormatHTTPMessage];
+    recorder.maxBodySize = 16;
+    [recorder startRecording];
+
+    // The response is still relayed in full to the client
+    NSData* body = [self bodyOfRequestToURL:[NSURL URLWithString:@"https://httpbin.org/bytes/1024"]];
+    XCTAssertEqual(body.length, 1024);
+
+    [recorder waitUntilAllWritten];
+    XCTAssertEqual(recorder.recordedCount, 0);
+    XCTAssertEqual(recorder.droppedCount, 1);
+    XCTAssertEqual([self recordedFiles].count, 0);
+    XCTAssertEqual(HTTPStubs.allStubs.count, 0);
+}
+
+@end
+
+#endif
@@ -0,0 +1,240 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#import <XCTest/XCTest.h>
+
+#if OHHTTPSTUBS_USE_STATIC_LIBRARY || SWIFT_PACKAGE
+#import "HTTPStubs.h"
+#import "HTTPStubsResponseTemplate.h"
+#else
+@import OHHTTPStubs;
+#endif
+
+@interface ResponseTemplateTests : XCTestCase @end
+
+// Serves a buffer of zeros, recording the largest read asked by the delivery loop
+@interface MaxReadRecordingInputStream : NSInputStream
+-(instancetype)initWithLength:(NSUInteger)length;
+@property(nonatomic, assign) NSUInteger largestRead;
+@end
+
+@implementation MaxReadRecordingInputStream
+{
+    NSUInteger _length;
+    NSUInteger _offset;
+    NSStreamStatus _status;
+}
+
+-(instancetype)initWithLength:(NSUInteger)length
+{
+    self = [super init];
+    if (self)
+    {
+        _length = length;
+        _status = NSStreamStatusNotOpen;
+    }
+    return self;
+}
+
+-(void)open { _status = NSStreamStatusOpen; }
+-(void)close { _status = NSStreamStatusClosed; }
+-(NSStreamStatus)streamStatus { return _status; }
+-(NSError*)streamError { return nil; }
+-(BOOL)hasBytesAvailable { return _status == NSStreamStatusOpen; }
+-(BOOL)getBuffer:(uint8_t**)buffer length:(NSUInteger*)len { return NO; }
+
+-(NSInteger)read:(uint8_t*)buffer maxLength:(NSUInteger)len
+{
+    self.largestRead = MAX(self.largestRead, len);
+    NSUInteger bytesRead = MIN(len, _length - _offset);
+    memset(buffer, 0, bytesRead);
+    _offset += bytesRead;
+    if (_offset == _length)
+    {
+        _status = NSStreamStatusAtEnd;
+    }
+    return (NSInteger)bytesRead;
+}
+@end
+
+@implementation ResponseTemplateTests
+
+-(void)setUp
+{
+    [super setUp];
+    [HTTPStubs removeAllStubs];
+}
+
+-(HTTPStubsResponseTemplate*)templateWithString:(NSString*)string
+{
+    return [HTTPStubsResponseTemplate templateWithData:[string dataUsingEncoding:NSUTF8StringEncoding]];
+}
+
+// Reads the body in small chunks, to exercise reads spanning several segments
+-(NSString*)bodyOfResponse:(HTTPStubsResponse*)response
+{
+    NSMutableData* body = [NSMutableData new];
+    uint8_t buffer[3];
+    [response.inputStream open];
+    while (response.inputStream.hasBytesAvailable)
+    {
+        NSInteger bytesRead = [response.inputStream read:buffer maxLength:sizeof(buffer)];
+        if (bytesRead <= 0) break;
+        [body appendBytes:buffer length:(NSUInteger)bytesRead];
+    }
+    [response.inputStream close];
+    return [[NSString alloc] initWithData:body encoding:NSUTF8StringEncoding];
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Parsing & substitution
+///////////////////////////////////////////////////////////////////////////////////
+
+-(void)test_Placeholders
+{
+    HTTPStubsResponseTemplate* template = [self templateWithString:@"{{a}}-{{ b }}-{{a}}-{{}}-{{unterminated"];
+    XCTAssertEqualObjects(template.placeholders, (@[@"a", @"b"]));
+}
+
+-(void)test_ValuesAndRequestPlaceholders
+{
+    HTTPStubsResponseTemplate* template = [self templateWithString:@"{\"id\":\"{{request.path.1}}\",\"q\":\"{{request.query.q}}\","
+                                           "\"h\":\"{{request.header.X-Token}}\",\"name\":\"{{name}}\",\"none\":\"{{missing}}\"}"];
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:@"http://api.example.com/users/42?q=hello"]];
+    [request setValue:@"t0k3n" forHTTPHeaderField:@"X-Token"];
+
+    HTTPStubsResponse* response = [template responseForRequest:request values:@{ @"name": @"Zoë" } statusCode:200 headers:nil];
+    NSString* expected = @"{\"id\":\"42\",\"q\":\"hello\",\"h\":\"t0k3n\",\"name\":\"Zoë\",\"none\":\"\"}";
+
+    XCTAssertEqualObjects([self bodyOfResponse:response], expected);
+    XCTAssertEqual(response.dataSize, (unsigned long long)[expected lengthOfBytesUsingEncoding:NSUTF8StringEncoding]);
+    XCTAssertEqualObjects(response.httpHeaders[@"Content-Length"], @([expected lengthOfBytesUsingEncoding:NSUTF8StringEncoding]).stringValue);
+}
+
+-(void)test_ValueBlockIsCalledLazilyForEachOccurrence
+{
+    HTTPStubsResponseTemplate* template = [self templateWithString:@"[{{n}},{{n}},{{n}}] {{request.method}}"];
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:@"http://api.example.com"]];
+    request.HTTPMethod = @"POST";
+
+    __block NSUInteger counter = 0;
+    HTTPStubsResponse* response = [template responseForRequest:request valueBlock:^NSString*(NSString* placeholder, NSURLRequest* req) {
+        return [placeholder isEqualToString:@"n"] ? @(++counter).stringValue : nil;
+    } statusCode:200 headers:nil];
+
+    XCTAssertEqual(counter, (NSUInteger)0);
+    XCTAssertEqual(response.dataSize, OHHTTPStubsUnknownDataSize);
+    XCTAssertNil(response.httpHeaders[@"Content-Length"]);
+    // Polling the stream must not resolve any placeholder
+    [response.inputStream open];
+    XCTAssertTrue(response.inputStream.hasBytesAvailable);
+    XCTAssertTrue(response.inputStream.hasBytesAvailable);
+    XCTAssertEqual(counter, (NSUInteger)0);
+    XCTAssertEqualObjects([self bodyOfResponse:response], @"[1,2,3] POST");
+    XCTAssertEqual(counter, (NSUInteger)3);
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Stubbing
+///////////////////////////////////////////////////////////////////////////////////
+
+-(void)test_StubWithUnknownSizeBody
+{
+    HTTPStubsResponseTemplate* template = [self templateWithString:@"Hello {{request.query.who}}, {{suffix}}"];
+    [HTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return YES;
+    } withStubResponse:^HTTPStubsResponse *(NSURLRequest *request) {
+        return [template responseForRequest:request valueBlock:^NSString*(NSString* placeholder, NSURLRequest* req) {
+            return [placeholder isEqualToString:@"suffix"] ? [@"" stringByPaddingToLength:40000 withString:@"!" startingAtIndex:0] : nil;
+        } statusCode:200 headers:nil];
+    }];
+
+    XCTestExpectation* expectation = [self expectationWithDescription:@"Templated response received"];
+    NSURLSession* session = [NSURLSession sessionWithConfiguration:NSURLSessionConfiguration.defaultSessionConfiguration];
+    [[session dataTaskWithURL:[NSURL URLWithString:@"http://api.example.com/greet?who=you"]
+            completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+        NSString* body = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+        XCTAssertNil(error);
+        XCTAssertEqual(data.length, (NSUInteger)40011);
+        XCTAssertTrue([body hasPrefix:@"Hello you, !!!"]);
+        XCTAssertTrue([body hasSuffix:@"!!!"]);
+        [expectation fulfill];
+    }] resume];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    [session finishTasksAndInvalidate];
+}
+
+-(void)test_UnknownSizeBodyHonorsResponseTime
+{
+    HTTPStubsResponseTemplate* template = [self templateWithString:@"Hello {{request.query.who}}"];
+    [HTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return YES;
+    } withStubResponse:^HTTPStubsResponse *(NSURLRequest *request) {
+        return [[template responseForRequest:request valueBlock:^NSString*(NSString* placeholder, NSURLRequest* req) {
+            return nil;
+        } statusCode:200 headers:nil] responseTime:0.5];
+    }];
+
+    XCTestExpectation* expectation = [self expectationWithDescription:@"Templated response received"];
+    NSDate* startDate = [NSDate date];
+    NSURLSession* session = [NSURLSession sessionWithConfiguration:NSURLSessionConfiguration.defaultSessionConfiguration];
+    [[session dataTaskWithURL:[NSURL URLWithString:@"http://api.example.com/greet?who=you"]
+            completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects([[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding], @"Hello you");
+        XCTAssertGreaterThanOrEqual(-startDate.timeIntervalSinceNow, 0.5);
+        [expectation fulfill];
+    }] resume];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    [session finishTasksAndInvalidate];
+}
+
+-(void)test_KnownSizeBodyIsSentInBoundedChunks
+{
+    NSUInteger const length = 1024 * 1024;
+    MaxReadRecordingInputStream* inputStream = [[MaxReadRecordingInputStream alloc] initWithLength:length];
+    [HTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return YES;
+    } withStubResponse:^HTTPStubsResponse *(NSURLRequest *request) {
+        // responseTime defaults to 0, which used to read the whole body at once
+        return [[HTTPStubsResponse alloc] initWithInputStream:inputStream dataSize:length statusCode:200 headers:nil];
+    }];
+
+    XCTestExpectation* expectation = [self expectationWithDescription:@"Response received"];
+    NSURLSession* session = [NSURLSession sessionWithConfiguration:NSURLSessionConfiguration.defaultSessionConfiguration];
+    [[session dataTaskWithURL:[NSURL URLWithString:@"http://api.example.com/large"]
+            completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+        XCTAssertNil(error);
+        XCTAssertEqual(data.length, length);
+        [expectation fulfill];
+    }] resume];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    [session finishTasksAndInvalidate];
+
+    XCTAssertGreaterThan(inputStream.largestRead, (NSUInteger)0);
+    XCTAssertLessThanOrEqual(inputStream.largestRead, (NSUInteger)16 * 1024);
+}
+
+@end
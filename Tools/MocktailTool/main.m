@@ -0,0 +1,329 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2012 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#if ! __has_feature(objc_arc)
+#error This file is expected to be compiled with ARC turned ON
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Imports
+
+#import <Foundation/Foundation.h>
+
+#import "HTTPStubs+Mocktail.h"
+#import "HTTPStubsMocktail.h"
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Commands
+
+static void PrintUsage(void)
+{
+    fprintf(stderr, "usage: mocktail-tool pack <mocktail folder> <output.mocktailpack>\n");
+    fprintf(stderr, "       mocktail-tool check <mocktail folder>\n");
+}
+
+static int Pack(NSString *folderPath, NSString *packPath)
+{
+    NSError *error = nil;
+    NSDate *start = [NSDate date];
+    if (![HTTPStubs writeMocktailPackWithMocktailsAtURL:[NSURL fileURLWithPath:folderPath isDirectory:YES]
+                                                 toURL:[NSURL fileURLWithPath:packPath]
+                                                 error:&error])
+    {
+        fprintf(stderr, "error: %s\n", error.localizedDescription.UTF8String);
+        return 1;
+    }
+    NSNumber *packSize = nil;
+    [[NSURL fileURLWithPath:packPath] getResourceValue:&packSize forKey:NSURLFileSizeKey error:NULL];
+    printf("Wrote %s (%llu bytes) in %.3fs\n", packPath.UTF8String, packSize.unsignedLongLongValue, -start.timeIntervalSinceNow);
+    return 0;
+}
+
+// Above these, a file is reported as slow
+static double const kSlowParseMilliseconds = 5.0;
+static double const kSlowMatchMicroseconds = 100.0;
+static unsigned long long const kLargeBodySize = 1024 * 1024;
+// Lengths of the probes used to measure how matching time grows with the length of the URL
+static NSUInteger const kShortProbeLength = 12;
+static NSUInteger const kLongProbeLength = 18;
+
+static double MillisecondsSince(NSDate *start)
+{
+    return -start.timeIntervalSinceNow * 1000.0;
+}
+
+// Whether a group containing an unbounded quantifier is itself repeated without bound, like "(a+)+" or "(.*/)*",
+// which makes the regular expression engine backtrack exponentially on URLs that almost match.
+static BOOL HasNestedQuantifier(NSString *pattern)
+{
+    NSMutableArray<NSNumber *> *groupHasQuantifier = [NSMutableArray new];
+    BOOL lastGroupHasQuantifier = NO;
+    BOOL afterGroup = NO;
+    BOOL inClass = NO;
+    for (NSUInteger idx = 0; idx < pattern.length; ++idx)
+    {
+        unichar character = [pattern characterAtIndex:idx];
+        BOOL unboundedQuantifier = (character == '*' || character == '+');
+        if (character == '{')
+        {
+            NSRange closing = [pattern rangeOfString:@"}" options:0 range:NSMakeRange(idx, pattern.length - idx)];
+            unboundedQuantifier = closing.location != NSNotFound && [pattern characterAtIndex:closing.location - 1] == ',';
+        }
+
+        if (character == '\\')
+        {
+            idx++;
+            afterGroup = NO;
+        }
+        else if (inClass)
+        {
+            inClass = (character != ']');
+        }
+        else if (character == '[')
+        {
+            inClass = YES;
+            afterGroup = NO;
+        }
+        else if (character == '(')
+        {
+            [groupHasQuantifier addObject:@NO];
+            afterGroup = NO;
+        }
+        else if (character == ')' && groupHasQuantifier.count > 0)
+        {
+            lastGroupHasQuantifier = groupHasQuantifier.lastObject.boolValue;
+            [groupHasQuantifier removeLastObject];
+            // The enclosing group contains whatever this one contains
+            if (lastGroupHasQuantifier && groupHasQuantifier.count > 0)
+            {
+                groupHasQuantifier[groupHasQuantifier.count - 1] = @YES;
+            }
+            afterGroup = YES;
+        }
+        else if (unboundedQuantifier)
+        {
+            if (afterGroup && lastGroupHasQuantifier)
+            {
+                return YES;
+            }
+            if (groupHasQuantifier.count > 0)
+            {
+                groupHasQuantifier[groupHasQuantifier.count - 1] = @YES;
+            }
+            afterGroup = NO;
+        }
+        else if (character != '?')
+        {
+            afterGroup = NO;
+        }
+    }
+    return NO;
+}
+
+// The literal characters an anchored pattern starts with, so that probes get past the anchor
+static NSString *LiteralPrefix(NSString *pattern)
+{
+    NSMutableString *prefix = [NSMutableString new];
+    if (![pattern hasPrefix:@"^"])
+    {
+        return prefix;
+    }
+    NSCharacterSet *metaCharacters = [NSCharacterSet characterSetWithCharactersInString:@".[]()*+?{}|^$"];
+    for (NSUInteger idx = 1; idx < pattern.length; ++idx)
+    {
+        unichar character = [pattern characterAtIndex:idx];
+        if (character == '\\' && idx + 1 < pattern.length && !isalnum([pattern characterAtIndex:idx + 1]))
+        {
+            character = [pattern characterAtIndex:++idx];
+        }
+        else if (character == '\\' || [metaCharacters characterIsMember:character])
+        {
+            break;
+        }
+        [prefix appendFormat:@"%C", character];
+    }
+    return prefix;
+}
+
+// The slowest time to evaluate the regular expression against URLs made of a repeated character,
+// which the pattern may almost match, and ending with a character making it fail.
+static double WorstMatchMicroseconds(NSRegularExpression *regex, NSString *prefix, NSUInteger length)
+{
+    double worst = 0;
+    for (NSString *character in @[@"a", @"0", @"/", @".", @"-", @"%"])
+    {
+        NSString *probe = [[prefix stringByPaddingToLength:prefix.length + length withString:character startingAtIndex:0] stringByAppendingString:@"\u2603"];
+        NSDate *start = [NSDate date];
+        (void)[regex numberOfMatchesInString:probe options:0 range:NSMakeRange(0, probe.length)];
+        worst = MAX(worst, MillisecondsSince(start) * 1000.0);
+    }
+    return worst;
+}
+
+// The size of the body once decoded, only counting the characters of the base64 alphabet: line breaks and padding don't
+// make it into the decoded body. Maps the file rather than reading it.
+static unsigned long long DecodedBase64BodySize(NSURL *fileURL, NSUInteger bodyOffset)
+{
+    NSData *content = [NSData dataWithContentsOfURL:fileURL options:NSDataReadingMappedIfSafe error:NULL];
+    const uint8_t *bytes = content.bytes;
+    unsigned long long alphabetCount = 0;
+    for (NSUInteger idx = bodyOffset; idx < content.length; ++idx)
+    {
+        uint8_t byte = bytes[idx];
+        alphabetCount += (isalnum(byte) || byte == '+' || byte == '/' || byte == '-' || byte == '_') ? 1 : 0;
+    }
+    return alphabetCount * 3 / 4;
+}
+
+static NSArray<NSURL *> *MocktailFilesInFolder(NSURL *folderURL)
+{
+    NSMutableArray<NSURL *> *fileURLs = [NSMutableArray new];
+    for (NSURL *fileURL in [NSFileManager.defaultManager enumeratorAtURL:folderURL includingPropertiesForKeys:nil options:0 errorHandler:nil])
+    {
+        if ([fileURL.pathExtension isEqualToString:@"tail"])
+        {
+            [fileURLs addObject:fileURL];
+        }
+    }
+    return [fileURLs sortedArrayUsingComparator:^NSComparisonResult(NSURL *lhs, NSURL *rhs) {
+        return [lhs.path compare:rhs.path];
+    }];
+}
+
+// Parses every Mocktail file of a folder tree and reports what makes loading or matching them slow.
+// Returns a failure if any file is invalid or has a pattern that backtracks pathologically.
+static int Check(NSString *folderPath)
+{
+    NSURL *folderURL = [NSURL fileURLWithPath:folderPath isDirectory:YES];
+    NSArray<NSURL *> *fileURLs = MocktailFilesInFolder(folderURL);
+    if (fileURLs.count == 0)
+    {
+        fprintf(stderr, "error: no Mocktail file in %s\n", folderPath.UTF8String);
+        return 1;
+    }
+
+    printf("%-40s %10s %10s %12s %10s  %s\n", "FILE", "PARSE ms", "REGEX ms", "BODY bytes", "MATCH us", "NOTES");
+    NSUInteger errorCount = 0, warningCount = 0;
+    double totalParse = 0;
+    unsigned long long totalBody = 0;
+    for (NSURL *fileURL in fileURLs)
+    {
+        NSString *relativePath = [fileURL.path substringFromIndex:MIN(folderURL.path.length + 1, fileURL.path.length)];
+        NSMutableArray<NSString *> *notes = [NSMutableArray new];
+
+        // Parsing, with the parser used when stubbing, including the compilation of the regular expressions,
+        // but without registering any stub
+        NSError *error = nil;
+        NSDate *start = [NSDate date];
+        HTTPStubsMocktail *mocktail = [HTTPStubs mocktailWithContentsOfURL:fileURL error:&error];
+        double parse = MillisecondsSince(start);
+        if (!mocktail)
+        {
+            printf("%-40s %10.3f %10s %12s %10s  error: %s\n", relativePath.UTF8String, parse, "-", "-", "-", error.localizedDescription.UTF8String);
+            errorCount++;
+            continue;
+        }
+
+        NSNumber *fileSize = nil;
+        [fileURL getResourceValue:&fileSize forKey:NSURLFileSizeKey error:NULL];
+        unsigned long long body = fileSize.unsignedLongLongValue > mocktail.bodyOffset ? fileSize.unsignedLongLongValue - mocktail.bodyOffset : 0;
+        if (mocktail.base64Body)
+        {
+            body = DecodedBase64BodySize(fileURL, mocktail.bodyOffset);
+            [notes addObject:@"base64"];
+        }
+
+        // The regular expressions alone
+        start = [NSDate date];
+        NSRegularExpression *methodRegex = [NSRegularExpression regularExpressionWithPattern:mocktail.methodPattern options:NSRegularExpressionCaseInsensitive error:NULL];
+        NSRegularExpression *urlRegex = [NSRegularExpression regularExpressionWithPattern:mocktail.absoluteURLPattern options:NSRegularExpressionCaseInsensitive error:NULL];
+        double regex = MillisecondsSince(start);
+
+        // Matching: the URL pattern is evaluated for every request reaching this file
+        NSString *prefix = LiteralPrefix(mocktail.absoluteURLPattern);
+        double shortMatch = WorstMatchMicroseconds(urlRegex, prefix, kShortProbeLength);
+        double longMatch = WorstMatchMicroseconds(urlRegex, prefix, kLongProbeLength);
+        double match = longMatch + WorstMatchMicroseconds(methodRegex, @"", kShortProbeLength);
+
+        BOOL pathological = NO;
+        BOOL slow = NO;
+        if (HasNestedQuantifier(mocktail.absoluteURLPattern) || HasNestedQuantifier(mocktail.methodPattern))
+        {
+            [notes addObject:@"nested quantifier"];
+            pathological = YES;
+        }
+        // Linear matching grows by 1.5x between the two probes, exponential backtracking by orders of magnitude
+        if (longMatch > kSlowMatchMicroseconds && longMatch > 10 * shortMatch)
+        {
+            [notes addObject:@"exponential backtracking"];
+            pathological = YES;
+        }
+        else if (match > kSlowMatchMicroseconds)
+        {
+            [notes addObject:@"slow match"];
+            slow = YES;
+        }
+        if (parse > kSlowParseMilliseconds)
+        {
+            [notes addObject:@"slow parse"];
+            slow = YES;
+        }
+        if (body > kLargeBodySize)
+        {
+            [notes addObject:@"large body"];
+            slow = YES;
+        }
+
+        errorCount += pathological ? 1 : 0;
+        warningCount += (!pathological && slow) ? 1 : 0;
+        totalParse += parse;
+        totalBody += body;
+        printf("%-40s %10.3f %10.3f %12llu %10.1f  %s\n", relativePath.UTF8String, parse, regex, body, match, [notes componentsJoinedByString:@", "].UTF8String);
+    }
+
+    printf("\n%lu files, %.3f ms to parse, %llu body bytes, %lu errors, %lu warnings\n",
+           (unsigned long)fileURLs.count, totalParse, totalBody, (unsigned long)errorCount, (unsigned long)warningCount);
+    return errorCount > 0 ? 1 : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Main
+
+int main(int argc, const char * argv[])
+{
+    @autoreleasepool
+    {
+        if (argc == 4 && strcmp(argv[1], "pack") == 0)
+        {
+            return Pack(@(argv[2]), @(argv[3]));
+        }
+        if (argc == 3 && strcmp(argv[1], "check") == 0)
+        {
+            return Check(@(argv[2]));
+        }
+        PrintUsage();
+        return 64; // EX_USAGE
+    }
+}